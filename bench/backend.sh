@@ -0,0 +1,42 @@
+#!/bin/bash
+# Compares stack and register compiler backends.
+# Builds the interpreter once and runs every workload from examples/ and bench/
+# REPEAT times with each backend, outputs of both backends must be identical.
+#
+# usage: bench/backend.sh [REPEAT]
+
+CC="gcc"
+DIR="src"
+FLAGS="-std=c99 -O2"
+REPEAT=${1:-5}
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+$CC $ROOT/$DIR/*.c -I$ROOT/$DIR -o "$TMP/seal" $FLAGS -ldl || exit 1
+
+run() {
+  local start end
+  start=$(date +%s%N)
+  for ((i = 0; i < REPEAT; i++)); do
+    "$TMP/seal" "$1" $2 < /dev/null > /dev/null 2>&1
+  done
+  end=$(date +%s%N)
+  echo $(( (end - start) / 1000000 ))
+}
+
+printf "%-28s %12s %12s %8s\n" "workload" "stack(ms)" "register(ms)" "speedup"
+for f in $ROOT/examples/*.seal $ROOT/bench/*.seal; do
+  # skip workloads that need input, missing modules or fail on purpose
+  (cd "$(dirname "$f")" && "$TMP/seal" "$f" < /dev/null > /dev/null 2>&1) || continue
+  cd "$(dirname "$f")"
+  if ! cmp -s <("$TMP/seal" "$f" < /dev/null 2>&1) <("$TMP/seal" "$f" -rb < /dev/null 2>&1); then
+    echo "$(basename "$f"): outputs of backends differ" >&2
+    continue
+  fi
+  st=$(run "$f")
+  rg=$(run "$f" -rb)
+  awk -v n="$(basename "$f")" -v a="$st" -v b="$rg" \
+    'BEGIN { printf "%-28s %12d %12d %7.2fx\n", n, a, b, b ? a / b : 0 }'
+done
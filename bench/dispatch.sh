@@ -0,0 +1,43 @@
+#!/bin/bash
+# Compares threaded (computed goto) and switch opcode dispatch.
+# Builds both interpreters and runs every workload from examples/ and bench/
+# REPEAT times with each of them.
+#
+# usage: bench/dispatch.sh [REPEAT]
+
+CC="gcc"
+DIR="src"
+FLAGS="-std=c99 -O2"
+REPEAT=${1:-5}
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+build() {
+  $CC $ROOT/$DIR/*.c -I$ROOT/$DIR -o "$TMP/$1" $FLAGS $2 -ldl || exit 1
+}
+
+build seal_threaded "-DSEAL_THREADED_DISPATCH=1"
+build seal_switch   "-DSEAL_THREADED_DISPATCH=0"
+
+run() {
+  local start end
+  start=$(date +%s%N)
+  for ((i = 0; i < REPEAT; i++)); do
+    "$TMP/$1" "$2" < /dev/null > /dev/null 2>&1
+  done
+  end=$(date +%s%N)
+  echo $(( (end - start) / 1000000 ))
+}
+
+printf "%-28s %12s %12s %8s\n" "workload" "switch(ms)" "threaded(ms)" "speedup"
+for f in $ROOT/examples/*.seal $ROOT/bench/*.seal; do
+  # skip workloads that need input, missing modules or fail on purpose
+  (cd "$(dirname "$f")" && "$TMP/seal_switch" "$f" < /dev/null > /dev/null 2>&1) || continue
+  cd "$(dirname "$f")"
+  sw=$(run seal_switch "$f")
+  th=$(run seal_threaded "$f")
+  awk -v n="$(basename "$f")" -v a="$sw" -v b="$th" \
+    'BEGIN { printf "%-28s %12d %12d %7.2fx\n", n, a, b, b ? a / b : 0 }'
+done
@@ -0,0 +1,43 @@
+#!/bin/bash
+# Measures field access through inline caches.
+# Builds the interpreter from the working tree (and from git revision REV if
+# given) with the math modules next to bench/fields.seal, runs it REPEAT
+# times with each build and prints the best run time, then prints hit and
+# miss counts of inline caches of the working tree.
+#
+# usage: bench/fields.sh [REV] [REPEAT]
+
+CC="gcc"
+DIR="src"
+FLAGS="-std=c99 -O2"
+REPEAT=${2:-5}
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+$CC $ROOT/$DIR/*.c -I$ROOT/$DIR -o "$TMP/seal_tree" $FLAGS -ldl -lm || exit 1
+if [ -n "$1" ]; then
+  mkdir "$TMP/rev"
+  git -C "$ROOT" archive "$1" $DIR | tar -x -C "$TMP/rev" || exit 1
+  $CC $TMP/rev/$DIR/*.c -I$TMP/rev/$DIR -o "$TMP/seal_rev" $FLAGS -ldl -lm || exit 1
+fi
+# modules are found in current directory first
+$CC -O2 -fPIC -shared -o "$TMP/sealmath.so" $ROOT/modules/sealmath.c $ROOT/$DIR/moddef.c \
+  -I$ROOT/modules -I$ROOT/$DIR -lm || exit 1
+cp "$ROOT/modules/math.seal" "$TMP/"
+cd "$TMP"
+
+printf "%-12s %14s\n" "build" "best(ms)"
+for b in seal_tree seal_rev; do
+  [ -x "$TMP/$b" ] || continue
+  best=
+  for ((i = 0; i < REPEAT; i++)); do
+    start=$(date +%s%N)
+    "$TMP/$b" "$ROOT/bench/fields.seal" -nc < /dev/null > /dev/null || exit 1
+    ms=$(( ($(date +%s%N) - start) / 1000000 ))
+    [ -z "$best" ] || [ $ms -lt $best ] && best=$ms
+  done
+  printf "%-12s %14d\n" "${b#seal_}" "$best"
+done
+"$TMP/seal_tree" "$ROOT/bench/fields.seal" -nc -pi < /dev/null | sed -n '/FIELD CACHES START/,$p'
@@ -0,0 +1,94 @@
+/*
+ * hashmap driver for bench/hashmap.sh, times insertion, lookup of present
+ * and missing keys and removal of N string keys and prints nanoseconds per
+ * operation of each phase (best of RUNS). insertion includes allocating
+ * table, as tables differ in when their pages are first touched. keys are
+ * looked up through copies, so every hit compares characters like names
+ * coming from source, and are visited in shuffled order so that sequential
+ * names do not give weak hash a locality advantage. shift-add hash of old
+ * revisions still packs sequential names into part of its table, which
+ * keeps more of it in cache at large N despite longer probes
+ */
+#define _POSIX_C_SOURCE 199309L
+#include "hashmap.h"
+#include <time.h>
+
+#define RUNS 5
+
+static double now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* same shuffle for every array of keys, so that copies[i] equals keys[i] */
+static char **make_keys(size_t n, const char *fmt)
+{
+  char **keys = SEAL_MALLOC(n * sizeof(char*));
+  for (size_t i = 0; i < n; i++) {
+    char buf[32];
+    sprintf(buf, fmt, i);
+    keys[i] = SEAL_MALLOC(strlen(buf) + 1);
+    strcpy(keys[i], buf);
+  }
+  uint64_t seed = 88172645463325252ULL;
+  for (size_t i = n - 1; i > 0; i--) {
+    seed ^= seed << 13, seed ^= seed >> 7, seed ^= seed << 17; /* xorshift */
+    size_t j = seed % (i + 1);
+    char *tmp = keys[i];
+    keys[i] = keys[j];
+    keys[j] = tmp;
+  }
+  return keys;
+}
+
+int main(int argc, char** argv)
+{
+  size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+  char **keys = make_keys(n, "field_%zu");
+  char **copies = make_keys(n, "field_%zu");
+  char **missing = make_keys(n, "absent_%zu");
+  double best[4] = { 0 };
+  long long sum = 0;
+
+  for (int run = 0; run < RUNS; run++) {
+    double t[5];
+    hashmap_t map;
+    t[0] = now();
+    /*
+     * tables of old revisions cannot grow and take number of slots, 2n
+     * keeps their load at half. swiss table takes number of keys and
+     * rounds slots up to power of two, n gives it about as many slots
+     */
+#ifdef HASHMAP_GROUP
+    hashmap_init(&map, n);
+#else
+    hashmap_init(&map, 2 * n);
+#endif
+    for (size_t i = 0; i < n; i++)
+      hashmap_insert(&map, keys[i], SEAL_VALUE_INT(i));
+    t[1] = now();
+    for (size_t i = 0; i < n; i++)
+      sum += hashmap_search(&map, copies[i])->val.as._int;
+    t[2] = now();
+    for (size_t i = 0; i < n; i++)
+      sum += hashmap_search(&map, missing[i])->key == NULL;
+    t[3] = now();
+    for (size_t i = 0; i < n; i++)
+      sum += hashmap_remove(&map, copies[i]);
+    t[4] = now();
+
+    for (int p = 0; p < 4; p++)
+      if (run == 0 || t[p + 1] - t[p] < best[p])
+        best[p] = t[p + 1] - t[p];
+#ifdef HASHMAP_GROUP
+    hashmap_free(&map);
+#else
+    SEAL_FREE(map.entries);
+#endif
+  }
+  printf("%.1f %.1f %.1f %.1f %lld\n", best[0] * 1e9 / n, best[1] * 1e9 / n,
+      best[2] * 1e9 / n, best[3] * 1e9 / n, sum);
+  return EXIT_SUCCESS;
+}
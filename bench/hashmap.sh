@@ -0,0 +1,38 @@
+#!/bin/bash
+# Compares hashmap of working tree with git revision REV (default is parent
+# of the commit that replaced the hashmaps with swiss table, the last
+# revision with the old ones).
+# Builds bench/hashmap.c against both, and reports nanoseconds per insert,
+# lookup of present key, lookup of missing key and remove for several
+# numbers of string keys.
+#
+# usage: bench/hashmap.sh [REV]
+
+CC="gcc"
+DIR="src"
+FLAGS="-std=c99 -O2"
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+REV=$1
+if [ -z "$REV" ]; then
+  REV=$(git -C "$ROOT" log --format=%H --grep='^\[user-021\]' | tail -n 1)
+  [ -n "$REV" ] || { echo "revision of old hashmap not found, give REV" >&2; exit 1; }
+  REV="$REV~1"
+fi
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+SRCS=$(ls $ROOT/$DIR/*.c | grep -v main.c)
+$CC $ROOT/bench/hashmap.c $SRCS -I$ROOT/$DIR -o "$TMP/hashmap_tree" $FLAGS -ldl -lm || exit 1
+mkdir "$TMP/rev"
+git -C "$ROOT" archive "$REV" $DIR | tar -x -C "$TMP/rev" || exit 1
+SRCS=$(ls $TMP/rev/$DIR/*.c | grep -v main.c)
+$CC $ROOT/bench/hashmap.c $SRCS -I$TMP/rev/$DIR -o "$TMP/hashmap_rev" $FLAGS -ldl -lm || exit 1
+
+printf "%-8s %-8s %10s %10s %10s %10s\n" "keys" "build" "insert" "hit" "miss" "remove"
+for n in 100 10000 1000000; do
+  for b in hashmap_rev hashmap_tree; do
+    "$TMP/$b" $n | awk -v k=$n -v n="${b#hashmap_}" \
+      '{ printf "%-8d %-8s %10.1f %10.1f %10.1f %10.1f\n", k, n, $1, $2, $3, $4 }'
+  done
+done
@@ -0,0 +1,49 @@
+#!/bin/bash
+# Compares startup time of eager and lazy (-lc) compilation of functions.
+# Builds the interpreter, generates a library module of FUNCS functions and a
+# script that includes it and calls one of them, then runs the script REPEAT
+# times with each mode. Bytecode cache is disabled so that every run compiles.
+#
+# usage: bench/lazy.sh [REPEAT]
+
+CC="gcc"
+DIR="src"
+FLAGS="-std=c99 -O2"
+REPEAT=${1:-10}
+FUNCS=4000
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+$CC $ROOT/$DIR/*.c -I$ROOT/$DIR -o "$TMP/seal" $FLAGS -ldl -lm || exit 1
+
+awk -v n=$FUNCS 'BEGIN {
+  for (i = 0; i < n; i++) {
+    printf "define f%d(s, n)\n", i
+    printf "    res = []\n"
+    printf "    for c in s\n"
+    printf "        if c == \" \" or n > %d\n", i
+    printf "            skip\n"
+    printf "        push(res, [c, n * %d, {k = c, v = %d.5}])\n", i, i
+    printf "    return len(res)\n\n"
+  }
+}' > "$TMP/biglib.seal"
+echo 'include biglib' > "$TMP/lazy.seal"
+echo 'print(biglib.f0("a b c", 0))' >> "$TMP/lazy.seal"
+
+run() {
+  local start end
+  start=$(date +%s%N)
+  for ((i = 0; i < REPEAT; i++)); do
+    (cd "$TMP" && ./seal lazy.seal -nc $1 > /dev/null) || exit 1
+  done
+  end=$(date +%s%N)
+  echo $(( (end - start) / REPEAT / 1000 ))
+}
+
+eager=$(run)
+lazy=$(run -lc)
+printf "%-12s %12s %12s %8s\n" "functions" "eager(us)" "lazy(us)" "speedup"
+awk -v n="$FUNCS" -v a="$eager" -v b="$lazy" \
+  'BEGIN { printf "%-12d %12d %12d %7.2fx\n", n, a, b, b ? a / b : 0 }'
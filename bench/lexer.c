@@ -0,0 +1,44 @@
+/*
+ * lexer throughput driver for bench/lexer.sh, lexes a file RUNS times
+ * and prints megabytes of source per second
+ */
+#define _POSIX_C_SOURCE 199309L
+#include "lexer.h"
+#include <time.h>
+
+#define RUNS 10
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    fprintf(stderr, "usage: lexer file\n");
+    return EXIT_FAILURE;
+  }
+  double best = 0;
+  size_t src_size = 0, tok_size = 0;
+
+  for (int i = 0; i < RUNS; i++) {
+#ifdef SEAL_ARENA_H
+    arena_t arena = { 0 };
+    front_arena = &arena;
+#endif
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    lexer_t lexer;
+    init_lexer(&lexer, argv[1]);
+    lexer_get_tokens(&lexer);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    if (best == 0 || secs < best)
+      best = secs;
+    src_size = lexer.src_size;
+    tok_size = lexer.tok_size;
+#ifdef SEAL_ARENA_H
+    arena_free(&arena);
+    front_arena = NULL;
+#endif
+  }
+  printf("%zu %zu %.1f\n", src_size, tok_size, src_size / best / (1 << 20));
+  return EXIT_SUCCESS;
+}
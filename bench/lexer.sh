@@ -0,0 +1,41 @@
+#!/bin/bash
+# Measures lexer throughput in megabytes of source per second.
+# Builds bench/lexer.c against the working tree (and against git revision REV
+# if given), generates a script of FUNCS functions mixing identifiers,
+# keywords, numbers and strings, and reports the best of several runs.
+#
+# usage: bench/lexer.sh [REV]
+
+CC="gcc"
+DIR="src"
+FLAGS="-std=c99 -O2"
+FUNCS=40000
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+SRCS=$(ls $ROOT/$DIR/*.c | grep -v main.c)
+$CC $ROOT/bench/lexer.c $SRCS -I$ROOT/$DIR -o "$TMP/lexer_tree" $FLAGS -ldl -lm || exit 1
+if [ -n "$1" ]; then
+  mkdir "$TMP/rev"
+  git -C "$ROOT" archive "$1" $DIR | tar -x -C "$TMP/rev" || exit 1
+  SRCS=$(ls $TMP/rev/$DIR/*.c | grep -v main.c)
+  $CC $ROOT/bench/lexer.c $SRCS -I$TMP/rev/$DIR -o "$TMP/lexer_rev" $FLAGS -ldl -lm || exit 1
+fi
+
+awk -v n=$FUNCS 'BEGIN {
+  for (i = 0; i < n; i++) {
+    printf "define function_%d(first, second)\n", i
+    printf "    total = first * %d + second / 3.25\n", i
+    printf "    if total > %d and not (second == null)\n", i * 7
+    printf "        print(\"value of function %d\", total, \"tab\\tseparated\")\n", i
+    printf "    return [total, first, second, true, false]\n\n"
+  }
+}' > "$TMP/lex.seal"
+
+printf "%-12s %10s %10s %10s\n" "build" "bytes" "tokens" "MB/s"
+for b in lexer_tree lexer_rev; do
+  [ -x "$TMP/$b" ] || continue
+  "$TMP/$b" "$TMP/lex.seal" | awk -v n="${b#lexer_}" '{ printf "%-12s %10d %10d %10.1f\n", n, $1, $2, $3 }'
+done
@@ -0,0 +1,59 @@
+#!/bin/bash
+# Measures memory per small map and time to build many of them.
+# Builds the interpreter from the working tree (and from git revision REV if
+# given), builds lists of SMALL and LARGE three-key maps with bench/maps.seal
+# and divides the difference of resident memory by the difference of maps,
+# then times building BUILD maps. A build whose maps would not fit in
+# available memory is not timed.
+#
+# usage: bench/maps.sh [REV]
+
+CC="gcc"
+DIR="src"
+FLAGS="-std=c99 -O2"
+SMALL=$((1 << 14))
+LARGE=$((1 << 16))
+BUILD=1000000
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+$CC $ROOT/$DIR/*.c -I$ROOT/$DIR -o "$TMP/seal_tree" $FLAGS -ldl -lm || exit 1
+if [ -n "$1" ]; then
+  mkdir "$TMP/rev"
+  git -C "$ROOT" archive "$1" $DIR | tar -x -C "$TMP/rev" || exit 1
+  $CC $TMP/rev/$DIR/*.c -I$TMP/rev/$DIR -o "$TMP/seal_rev" $FLAGS -ldl -lm || exit 1
+fi
+
+# prints resident memory (kB) of interpreter $1 holding $2 maps
+rss() {
+  local pid kb
+  rm -f "$TMP/fifo" "$TMP/out"
+  mkfifo "$TMP/fifo"
+  stdbuf -oL "$TMP/$1" "$ROOT/bench/maps.seal" "$2" -nc < "$TMP/fifo" > "$TMP/out" &
+  pid=$!
+  exec 3> "$TMP/fifo"
+  until grep -q ready "$TMP/out" 2> /dev/null; do sleep 0.01; done
+  kb=$(awk '/VmRSS/ { print $2 }' /proc/$pid/status)
+  echo >&3
+  exec 3>&-
+  wait $pid
+  echo $kb
+}
+
+avail=$(awk '/MemAvailable/ { print $2 }' /proc/meminfo)
+printf "%-12s %12s %12s %10s %14s\n" "build" "small(kB)" "large(kB)" "bytes/map" "$BUILD maps(ms)"
+for b in seal_tree seal_rev; do
+  [ -x "$TMP/$b" ] || continue
+  s=$(rss $b $SMALL)
+  l=$(rss $b $LARGE)
+  per=$(( (l - s) * 1024 / (LARGE - SMALL) ))
+  ms="-"
+  if [ $(( per * BUILD / 1024 )) -lt $(( avail / 2 )) ]; then
+    start=$(date +%s%N)
+    "$TMP/$b" "$ROOT/bench/maps.seal" $BUILD -nc < /dev/null > /dev/null
+    ms=$(( ($(date +%s%N) - start) / 1000000 ))
+  fi
+  printf "%-12s %12d %12d %10d %14s\n" "${b#seal_}" "$s" "$l" "$per" "$ms"
+done
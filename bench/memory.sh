@@ -0,0 +1,50 @@
+#!/bin/bash
+# Measures memory used per list element.
+# Builds the interpreter from the working tree (and from git revision REV if
+# given), builds lists of SMALL and LARGE integers with bench/memory.seal and
+# divides the difference of resident memory by the difference of elements.
+# Sizes are powers of two so that list capacity matches its size.
+#
+# usage: bench/memory.sh [REV]
+
+CC="gcc"
+DIR="src"
+FLAGS="-std=c99 -O2"
+SMALL=$((1 << 18))
+LARGE=$((1 << 21))
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+$CC $ROOT/$DIR/*.c -I$ROOT/$DIR -o "$TMP/seal_tree" $FLAGS -ldl || exit 1
+if [ -n "$1" ]; then
+  mkdir "$TMP/rev"
+  git -C "$ROOT" archive "$1" $DIR | tar -x -C "$TMP/rev" || exit 1
+  $CC $TMP/rev/$DIR/*.c -I$TMP/rev/$DIR -o "$TMP/seal_rev" $FLAGS -ldl || exit 1
+fi
+
+# prints resident memory (kB) of interpreter $1 holding a list of $2 elements
+rss() {
+  local pid kb
+  rm -f "$TMP/fifo" "$TMP/out"
+  mkfifo "$TMP/fifo"
+  stdbuf -oL "$TMP/$1" "$ROOT/bench/memory.seal" "$2" < "$TMP/fifo" > "$TMP/out" &
+  pid=$!
+  exec 3> "$TMP/fifo"
+  until grep -q ready "$TMP/out" 2> /dev/null; do sleep 0.01; done
+  kb=$(awk '/VmRSS/ { print $2 }' /proc/$pid/status)
+  echo >&3
+  exec 3>&-
+  wait $pid
+  echo $kb
+}
+
+printf "%-12s %12s %12s %14s\n" "build" "small(kB)" "large(kB)" "bytes/element"
+for b in seal_tree seal_rev; do
+  [ -x "$TMP/$b" ] || continue
+  s=$(rss $b $SMALL)
+  l=$(rss $b $LARGE)
+  awk -v n="${b#seal_}" -v s="$s" -v l="$l" -v d=$((LARGE - SMALL)) \
+    'BEGIN { printf "%-12s %12d %12d %14.1f\n", n, s, l, (l - s) * 1024 / d }'
+done
@@ -0,0 +1,54 @@
+#!/bin/bash
+# Compares compiler optimizations (constant folding and peephole pass) off
+# (-O0) and on (-O1).
+# Builds the interpreter and runs every workload from examples/ and bench/
+# with both levels on each backend, fails if their outputs differ, otherwise
+# prints run times over REPEAT runs. Bytecode cache is disabled so that every
+# run compiles with the requested level.
+#
+# usage: bench/opt.sh [REPEAT]
+
+CC="gcc"
+DIR="src"
+FLAGS="-std=c99 -O2"
+REPEAT=${1:-5}
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+$CC $ROOT/$DIR/*.c -I$ROOT/$DIR -o "$TMP/seal" $FLAGS -ldl -lm || exit 1
+
+run() {
+  local start end
+  start=$(date +%s%N)
+  for ((i = 0; i < REPEAT; i++)); do
+    "$TMP/seal" "$1" -nc $2 < /dev/null > /dev/null 2>&1
+  done
+  end=$(date +%s%N)
+  echo $(( (end - start) / 1000000 ))
+}
+
+status=0
+printf "%-28s %-8s %12s %12s %8s\n" "workload" "backend" "O0(ms)" "O1(ms)" "speedup"
+for f in $ROOT/examples/*.seal $ROOT/bench/*.seal; do
+  cd "$(dirname "$f")"
+  for backend in stack register; do
+    flags=""
+    [ $backend = register ] && flags="-rb"
+    out0=$("$TMP/seal" "$f" -nc -O0 $flags < /dev/null 2>&1)
+    out1=$("$TMP/seal" "$f" -nc -O1 $flags < /dev/null 2>&1)
+    if [ "$out0" != "$out1" ]; then
+      echo "$(basename "$f") ($backend): output differs between -O0 and -O1"
+      status=1
+      continue
+    fi
+    # workloads that need input, missing modules or fail on purpose are only compared
+    "$TMP/seal" "$f" -nc $flags < /dev/null > /dev/null 2>&1 || continue
+    a=$(run "$f" "-O0 $flags")
+    b=$(run "$f" "-O1 $flags")
+    awk -v n="$(basename "$f")" -v k="$backend" -v a="$a" -v b="$b" \
+      'BEGIN { printf "%-28s %-8s %12d %12d %7.2fx\n", n, k, a, b, b ? a / b : 0 }'
+  done
+done
+exit $status
@@ -0,0 +1,51 @@
+#!/bin/bash
+# Compares startup time with and without bytecode cache (.sealc).
+# Builds the interpreter, generates a script of FUNCS functions that includes
+# a generated module and only calls the last function, then runs it REPEAT
+# times cold (cache of script and module removed before each run) and warm.
+#
+# usage: bench/startup.sh [REPEAT]
+
+CC="gcc"
+DIR="src"
+FLAGS="-std=c99 -O2"
+REPEAT=${1:-10}
+FUNCS=2000
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+$CC $ROOT/$DIR/*.c -I$ROOT/$DIR -o "$TMP/seal" $FLAGS -ldl -lm || exit 1
+
+gen() {
+  awk -v n=$FUNCS -v p="$1" 'BEGIN {
+    for (i = 0; i < n; i++) {
+      printf "define %s%d(a, b)\n", p, i
+      printf "    if a > %d and b != null\n", i
+      printf "        return [a * %d + b / 2.5, \"%s %d\", {x = a, y = b}]\n", i, p, i
+      printf "    return null\n\n"
+    }
+  }'
+}
+
+gen mod_ > "$TMP/startmod.seal"
+{ echo "include startmod"; gen main_; echo "print(main_$((FUNCS - 1))($FUNCS, 1)[0] + startmod.mod_0(1, 2)[0])"; } > "$TMP/start.seal"
+
+run() {
+  local start end
+  start=$(date +%s%N)
+  for ((i = 0; i < REPEAT; i++)); do
+    [ "$1" = cold ] && rm -f "$TMP"/*.sealc
+    (cd "$TMP" && ./seal start.seal > /dev/null) || exit 1
+  done
+  end=$(date +%s%N)
+  echo $(( (end - start) / REPEAT / 1000 ))
+}
+
+run warm > /dev/null # writes cache
+cold=$(run cold)
+warm=$(run warm)
+printf "%-12s %12s %12s %8s\n" "script" "cold(us)" "warm(us)" "speedup"
+awk -v n="$(wc -c < "$TMP/start.seal")B" -v a="$cold" -v b="$warm" \
+  'BEGIN { printf "%-12s %12d %12d %7.2fx\n", n, a, b, b ? a / b : 0 }'
@@ -0,0 +1,36 @@
+#include "arena.h"
+
+arena_t *front_arena;
+
+void arena_new_chunk(arena_t *arena, size_t size)
+{
+  /* rest of current chunk is left unused */
+  size_t cap = size > ARENA_CHUNK ? size : ARENA_CHUNK;
+  struct arena_chunk *chunk = SEAL_CALLOC(1, sizeof(struct arena_chunk) + cap);
+  chunk->prev = arena->chunk;
+  arena->chunk = chunk;
+  arena->cur = (char*)(chunk + 1);
+  arena->end = arena->cur + cap;
+}
+
+/* capacity is doubled whenever previous size was power of two */
+void *arena_grow(arena_t *arena, void *ptr, size_t size, size_t elem_size)
+{
+  size_t old = size - 1;
+  if (ptr != NULL && (old & (old - 1)) != 0)
+    return ptr;
+  void *res = arena_alloc(arena, elem_size * (old ? old * 2 : 1));
+  if (old)
+    memcpy(res, ptr, elem_size * old);
+  return res;
+}
+
+void arena_free(arena_t *arena)
+{
+  while (arena->chunk) {
+    struct arena_chunk *prev = arena->chunk->prev;
+    SEAL_FREE(arena->chunk);
+    arena->chunk = prev;
+  }
+  arena->cur = arena->end = NULL;
+}
@@ -0,0 +1,39 @@
+#ifndef SEAL_ARENA_H
+#define SEAL_ARENA_H
+
+#include "sealconf.h"
+
+/*
+ * bump allocator for front-end: tokens, ast nodes and their arrays live
+ * only until file is compiled, then whole arena is dropped at once.
+ * memory is zeroed, there is no per-object free
+ */
+#define ARENA_CHUNK (1 << 20) /* large enough for libc to map it, so dropped arena is returned to system */
+#define ARENA_ALIGN sizeof(seal_int)
+
+struct arena_chunk {
+  struct arena_chunk *prev;
+};
+
+typedef struct arena {
+  struct arena_chunk *chunk;
+  char *cur, *end;
+} arena_t;
+
+extern arena_t *front_arena; /* arena of file being compiled */
+
+void arena_new_chunk(arena_t *arena, size_t size);
+void *arena_grow(arena_t *arena, void *ptr, size_t size, size_t elem_size); /* array that just grew to size elements */
+void arena_free(arena_t *arena);
+
+static inline void *arena_alloc(arena_t *arena, size_t size)
+{
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  if (arena->end - arena->cur < size)
+    arena_new_chunk(arena, size);
+  void *res = arena->cur;
+  arena->cur += size;
+  return res;
+}
+
+#endif /* SEAL_ARENA_H */
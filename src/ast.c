@@ -7,13 +7,22 @@ static ast_t* __ast_true  = NULL;
 static ast_t* __ast_false = NULL;
 
 
+/* shared by all files, so they are not allocated from front-end arena */
+static ast_t* create_const_ast(int type)
+{
+  ast_t* ast = (ast_t*)SEAL_CALLOC(1, sizeof(ast_t));
+  ast->type = type;
+  ast->line = -1;
+  return ast;
+}
+
 inline void create_const_asts()
 {
-  __ast_nop  = static_create_ast(AST_NOP, -1);
-  __ast_null = static_create_ast(AST_NULL, -1);
-  __ast_true = static_create_ast(AST_BOOL, -1);
+  __ast_nop  = create_const_ast(AST_NOP);
+  __ast_null = create_const_ast(AST_NULL);
+  __ast_true = create_const_ast(AST_BOOL);
   __ast_true->boolean.val = true;
-  __ast_false = static_create_ast(AST_BOOL, -1);
+  __ast_false = create_const_ast(AST_BOOL);
   __ast_false->boolean.val = false;
 }
 
@@ -42,6 +42,7 @@
 #define AST_LAST AST_INCLUDE
 
 #define ast_type(ast) ast->type
+#define IS_LITERAL(node) ((node)->type >= AST_NULL && (node)->type <= AST_BOOL)
 
 
 typedef struct ast {
@@ -229,7 +230,7 @@ static inline const char* hast_type_name(int type)
 
 static inline ast_t* create_ast(int type)
 {
-  ast_t* ast = (ast_t*)SEAL_CALLOC(1, sizeof(ast_t));
+  ast_t* ast = (ast_t*)SEAL_ARENA_ALLOC(sizeof(ast_t));
   
   ast->type = type;
   ast->line = 0;
@@ -1,6 +1,8 @@
 #include "builtins.h"
 #include "gc.h"
 #include "moddef.h"
+#include "shape.h"
+#include "vm.h"
 
 #define BUILTIN_ERROR(...) do { \
   fprintf(stderr, __VA_ARGS__); \
@@ -90,20 +92,21 @@ static void __print_single(svalue_t s)
     printf("]");
     break;
   case SEAL_MAP: {
-    int left = AS_MAP(s)->map->filled;
+    int left = map_size(AS_MAP(s));
     printf("{");
-    for (int i = 0; i < AS_MAP(s)->map->cap; i++) {
-      struct sh_entry e = AS_MAP(s)->map->entries[i];
-      if (e.key == NULL)
+    for (size_t i = 0; i < map_end(AS_MAP(s)); i++) {
+      const char *key;
+      svalue_t *val = map_at(AS_MAP(s), i, &key);
+      if (val == NULL)
         continue;
       left--;
-      printf("%s: ", e.key);
-      if (IS_STRING(e.val)) {
+      printf("%s: ", key);
+      if (IS_STRING(*val)) {
         printf("\'");
-        __print_string_no_escseq(AS_STRING(e.val));
+        __print_string_no_escseq(AS_STRING(*val));
         printf("\'");
       } else {
-        __print_single(e.val);
+        __print_single(*val);
       }
 
 
@@ -117,7 +120,7 @@ static void __print_single(svalue_t s)
     printf("module: %s (%p)", s.as.mod->name, s.as.mod->globals);
     break;
   case SEAL_PTR:
-    printf("%s: %p", s.as.ptr.name, s.as.ptr.ptr);
+    printf("%s: %p", AS_PTR(s).name, AS_PTR(s).ptr);
     break;
   default:
     printf("UNRECOGNIZED DATA TYPE TO PRINT ");
@@ -270,7 +273,7 @@ svalue_t __seal_bool(seal_byte argc, svalue_t* argv)
       IS_STRING(arg) ? arg.as.string->size > 0 :
       IS_BOOL(arg) ? AS_BOOL(arg) :
       IS_LIST(arg) ? AS_LIST(arg)->size > 0 :
-      IS_MAP(arg) ? AS_MAP(arg)->map->filled > 0 :
+      IS_MAP(arg) ? map_size(AS_MAP(arg)) > 0 :
       IS_FUNC(arg) ? true :
       IS_MOD(arg) ? true :
       IS_PTR(arg) ? AS_PTR(arg).ptr != NULL :
@@ -304,7 +307,7 @@ svalue_t __seal_pop(seal_byte argc, svalue_t* argv)
     BUILTIN_ERROR("cannot pop empty list");
 
   svalue_t popped = AS_LIST(list)->mems[--AS_LIST(list)->size];
-  gc_decref_nofree(popped);
+  gc_decref(popped);
   return popped;
 }
 
@@ -318,7 +321,8 @@ svalue_t __seal_insert(seal_byte argc, svalue_t *argv)
 
   struct seal_list *l = AS_LIST(list);
   if (l->size >= l->cap) {
-    l->mems = SEAL_REALLOC(l->mems, sizeof(svalue_t) * (l->cap *= 2));
+    l->mems = SEAL_POOL_REALLOC(l->mems, sizeof(svalue_t) * l->cap, sizeof(svalue_t) * l->cap * 2);
+    l->cap *= 2;
   }
 
   int clamped_idx = AS_INT(idx) < 0 ? 0 : (AS_INT(idx) > l->size ? l->size : AS_INT(idx));
@@ -353,7 +357,7 @@ svalue_t __seal_remove(seal_byte argc, svalue_t *argv)
 
   l->size--;
 
-  gc_decref_nofree(removed);
+  gc_decref(removed);
 
   return removed;
 }
@@ -441,3 +445,8 @@ svalue_t __seal_format(seal_byte argc, svalue_t *argv)
   svalue_t final = SEAL_VALUE_STRING(result);
   return final;
 }
+
+svalue_t __seal_gc(seal_byte argc, svalue_t *argv)
+{
+  return SEAL_VALUE_INT(vm_collect());
+}
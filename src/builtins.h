@@ -17,5 +17,6 @@ svalue_t __seal_pop(seal_byte argc, svalue_t* argv);
 svalue_t __seal_insert(seal_byte argc, svalue_t *argv);
 svalue_t __seal_remove(seal_byte argc, svalue_t *argv);
 svalue_t __seal_format(seal_byte argc, svalue_t *argv);
+svalue_t __seal_gc(seal_byte argc, svalue_t *argv);
 
 #endif /* SEAL_BUILTINS_H */
@@ -19,6 +19,7 @@ enum {
   OP_JTRUE      ,
   OP_JFALSE     ,
   OP_CALL       ,
+  OP_TAIL_CALL  , /* call reusing frame of caller, followed by OP_HALT */
   /* variable */
   OP_GET_GLOBAL ,
   OP_SET_GLOBAL ,
@@ -51,7 +52,7 @@ enum {
   OP_BNOT       ,
   /* list */
   OP_GEN_LIST   ,
-  /* iterable */
+  /* iterable, operand is index of inline cache of site */
   OP_GET_FIELD  ,
   OP_SET_FIELD  ,
   /* membership */
@@ -64,7 +65,88 @@ enum {
   /* for loop */
   OP_FOR_PREP,
   OP_FOR_NEXT,
-  OP_FOR_STOP
+  OP_FOR_STOP,
+  /* superinstructions */
+  OP_ADD_LL     ,  /* GET_LOCAL a; GET_LOCAL b; ADD */
+  OP_INC_LOCAL  ,  /* GET_LOCAL a; PUSH_INT k; ADD; SET_LOCAL a; POP */
+  OP_DEC_LOCAL  ,  /* GET_LOCAL a; PUSH_INT k; SUB; SET_LOCAL a; POP */
+  OP_JFALSE_LT_LI, /* GET_LOCAL a; PUSH_INT k; LT; JFALSE */
+  OP_JFALSE_LE_LI, /* GET_LOCAL a; PUSH_INT k; LE; JFALSE */
+  OP_JFALSE_GT_LI, /* GET_LOCAL a; PUSH_INT k; GT; JFALSE */
+  OP_JFALSE_GE_LI, /* GET_LOCAL a; PUSH_INT k; GE; JFALSE */
+  OP_JFALSE_EQ_LI, /* GET_LOCAL a; PUSH_INT k; EQ; JFALSE */
+  OP_JFALSE_NE_LI, /* GET_LOCAL a; PUSH_INT k; NE; JFALSE */
+  OP_JFALSE_OR_POP, /* DUP; JFALSE; POP */
+  OP_JTRUE_OR_POP,  /* DUP; JTRUE; POP */
+  /* register machine (operands are local slots) */
+  OP_R_MOVE     ,  /* d, s     : R(d) = R(s) */
+  OP_R_LOADI    ,  /* d, i16   : R(d) = i */
+  OP_R_LOADK    ,  /* d, k16   : R(d) = K(k) */
+  OP_R_PUSH     ,  /* s        : push R(s) */
+  OP_R_POP      ,  /* d        : R(d) = pop */
+  OP_R_CLEAR    ,  /* d, n     : R(d) .. R(d + n - 1) = null */
+  OP_R_ADD      ,  /* d, a, b  : R(d) = R(a) op R(b), same order as OP_ADD..OP_NE */
+  OP_R_SUB      ,
+  OP_R_MUL      ,
+  OP_R_DIV      ,
+  OP_R_MOD      ,
+  OP_R_AND      ,
+  OP_R_OR       ,
+  OP_R_XOR      ,
+  OP_R_SHL      ,
+  OP_R_SHR      ,
+  OP_R_GT       ,
+  OP_R_GE       ,
+  OP_R_LT       ,
+  OP_R_LE       ,
+  OP_R_EQ       ,
+  OP_R_NE       ,
+  OP_R_IN       ,
+  OP_R_NOT      ,  /* d, a     : R(d) = op R(a) */
+  OP_R_NEG      ,
+  OP_R_BNOT     ,
+  OP_R_TYPOF    ,
+  OP_R_JFALSE   ,  /* s, l16   : jump if R(s) is false */
+  OP_R_JTRUE    ,  /* s, l16   : jump if R(s) is true */
+  OP_R_JF_GT    ,  /* a, b, l16: jump if not R(a) op R(b), same order as OP_GT..OP_NE */
+  OP_R_JF_GE    ,
+  OP_R_JF_LT    ,
+  OP_R_JF_LE    ,
+  OP_R_JF_EQ    ,
+  OP_R_JF_NE    ,
+  /* short jumps */
+  OP_JUMP_S         ,
+  OP_JFALSE_S       ,
+  OP_JTRUE_S        ,
+  OP_FOR_PREP_S     ,
+  OP_FOR_NEXT_S     ,
+  OP_JFALSE_LT_LI_S ,
+  OP_JFALSE_LE_LI_S ,
+  OP_JFALSE_GT_LI_S ,
+  OP_JFALSE_GE_LI_S ,
+  OP_JFALSE_EQ_LI_S ,
+  OP_JFALSE_NE_LI_S ,
+  OP_JFALSE_OR_POP_S,
+  OP_JTRUE_OR_POP_S ,
+  OP_R_JFALSE_S     ,
+  OP_R_JTRUE_S      ,
+  OP_R_JF_GT_S      ,
+  OP_R_JF_GE_S      ,
+  OP_R_JF_LT_S      ,
+  OP_R_JF_LE_S      ,
+  OP_R_JF_EQ_S      ,
+  OP_R_JF_NE_S      ,
+  /* quickened, generic opcodes rewrite themselves into these at run time */
+  OP_ADD_II         ,
+  OP_ADD_FF         ,
+  OP_LT_II          ,
+  OP_EQ_STR         ,
+  OP_GET_FIELD_LIST_INT,
+  /* deoptimized, quickened site whose guard failed stays generic from then on */
+  OP_ADD_POLY       ,
+  OP_LT_POLY        ,
+  OP_EQ_POLY        ,
+  OP_GET_FIELD_POLY
 };
 
 #define PRINT_BYTE(bytecodes, size) for(int i = 0; i < size; i++) { \
@@ -90,6 +172,7 @@ static inline const char* op_name(int op)
   case OP_JTRUE     :  return "OP_JTRUE";
   case OP_JFALSE    :  return "OP_JFALSE";
   case OP_CALL      :  return "OP_CALL";
+  case OP_TAIL_CALL :  return "OP_TAIL_CALL";
   /* variable */
   case OP_GET_GLOBAL:  return "OP_GET_GLOBAL";
   case OP_SET_GLOBAL:  return "OP_SET_GLOBAL";
@@ -128,52 +211,254 @@ static inline const char* op_name(int op)
   case OP_FOR_PREP  :  return "OP_FOR_PREP";
   case OP_FOR_NEXT  :  return "OP_FOR_NEXT";
   case OP_FOR_STOP  :  return "OP_FOR_STOP";
+  /* superinstructions */
+  case OP_ADD_LL    :  return "OP_ADD_LL";
+  case OP_INC_LOCAL :  return "OP_INC_LOCAL";
+  case OP_DEC_LOCAL :  return "OP_DEC_LOCAL";
+  case OP_JFALSE_LT_LI:  return "OP_JFALSE_LT_LI";
+  case OP_JFALSE_LE_LI:  return "OP_JFALSE_LE_LI";
+  case OP_JFALSE_GT_LI:  return "OP_JFALSE_GT_LI";
+  case OP_JFALSE_GE_LI:  return "OP_JFALSE_GE_LI";
+  case OP_JFALSE_EQ_LI:  return "OP_JFALSE_EQ_LI";
+  case OP_JFALSE_NE_LI:  return "OP_JFALSE_NE_LI";
+  case OP_JFALSE_OR_POP: return "OP_JFALSE_OR_POP";
+  case OP_JTRUE_OR_POP:  return "OP_JTRUE_OR_POP";
+  /* register machine */
+  case OP_R_MOVE    :  return "OP_R_MOVE";
+  case OP_R_LOADI   :  return "OP_R_LOADI";
+  case OP_R_LOADK   :  return "OP_R_LOADK";
+  case OP_R_PUSH    :  return "OP_R_PUSH";
+  case OP_R_POP     :  return "OP_R_POP";
+  case OP_R_CLEAR   :  return "OP_R_CLEAR";
+  case OP_R_ADD     :  return "OP_R_ADD";
+  case OP_R_SUB     :  return "OP_R_SUB";
+  case OP_R_MUL     :  return "OP_R_MUL";
+  case OP_R_DIV     :  return "OP_R_DIV";
+  case OP_R_MOD     :  return "OP_R_MOD";
+  case OP_R_AND     :  return "OP_R_AND";
+  case OP_R_OR      :  return "OP_R_OR";
+  case OP_R_XOR     :  return "OP_R_XOR";
+  case OP_R_SHL     :  return "OP_R_SHL";
+  case OP_R_SHR     :  return "OP_R_SHR";
+  case OP_R_GT      :  return "OP_R_GT";
+  case OP_R_GE      :  return "OP_R_GE";
+  case OP_R_LT      :  return "OP_R_LT";
+  case OP_R_LE      :  return "OP_R_LE";
+  case OP_R_EQ      :  return "OP_R_EQ";
+  case OP_R_NE      :  return "OP_R_NE";
+  case OP_R_IN      :  return "OP_R_IN";
+  case OP_R_NOT     :  return "OP_R_NOT";
+  case OP_R_NEG     :  return "OP_R_NEG";
+  case OP_R_BNOT    :  return "OP_R_BNOT";
+  case OP_R_TYPOF   :  return "OP_R_TYPOF";
+  case OP_R_JFALSE  :  return "OP_R_JFALSE";
+  case OP_R_JTRUE   :  return "OP_R_JTRUE";
+  case OP_R_JF_GT   :  return "OP_R_JF_GT";
+  case OP_R_JF_GE   :  return "OP_R_JF_GE";
+  case OP_R_JF_LT   :  return "OP_R_JF_LT";
+  case OP_R_JF_LE   :  return "OP_R_JF_LE";
+  case OP_R_JF_EQ   :  return "OP_R_JF_EQ";
+  case OP_R_JF_NE   :  return "OP_R_JF_NE";
+  /* short jumps */
+  case OP_JUMP_S          :  return "OP_JUMP_S";
+  case OP_JFALSE_S        :  return "OP_JFALSE_S";
+  case OP_JTRUE_S         :  return "OP_JTRUE_S";
+  case OP_FOR_PREP_S      :  return "OP_FOR_PREP_S";
+  case OP_FOR_NEXT_S      :  return "OP_FOR_NEXT_S";
+  case OP_JFALSE_LT_LI_S  :  return "OP_JFALSE_LT_LI_S";
+  case OP_JFALSE_LE_LI_S  :  return "OP_JFALSE_LE_LI_S";
+  case OP_JFALSE_GT_LI_S  :  return "OP_JFALSE_GT_LI_S";
+  case OP_JFALSE_GE_LI_S  :  return "OP_JFALSE_GE_LI_S";
+  case OP_JFALSE_EQ_LI_S  :  return "OP_JFALSE_EQ_LI_S";
+  case OP_JFALSE_NE_LI_S  :  return "OP_JFALSE_NE_LI_S";
+  case OP_JFALSE_OR_POP_S :  return "OP_JFALSE_OR_POP_S";
+  case OP_JTRUE_OR_POP_S  :  return "OP_JTRUE_OR_POP_S";
+  case OP_R_JFALSE_S      :  return "OP_R_JFALSE_S";
+  case OP_R_JTRUE_S       :  return "OP_R_JTRUE_S";
+  case OP_R_JF_GT_S       :  return "OP_R_JF_GT_S";
+  case OP_R_JF_GE_S       :  return "OP_R_JF_GE_S";
+  case OP_R_JF_LT_S       :  return "OP_R_JF_LT_S";
+  case OP_R_JF_LE_S       :  return "OP_R_JF_LE_S";
+  case OP_R_JF_EQ_S       :  return "OP_R_JF_EQ_S";
+  case OP_R_JF_NE_S       :  return "OP_R_JF_NE_S";
+  /* quickened */
+  case OP_ADD_II          :  return "OP_ADD_II";
+  case OP_ADD_FF          :  return "OP_ADD_FF";
+  case OP_LT_II           :  return "OP_LT_II";
+  case OP_EQ_STR          :  return "OP_EQ_STR";
+  case OP_GET_FIELD_LIST_INT: return "OP_GET_FIELD_LIST_INT";
+  case OP_ADD_POLY        :  return "OP_ADD_POLY";
+  case OP_LT_POLY         :  return "OP_LT_POLY";
+  case OP_EQ_POLY         :  return "OP_EQ_POLY";
+  case OP_GET_FIELD_POLY  :  return "OP_GET_FIELD_POLY";
   default           :  return "OP NOT RECOGNIZED";
   }
 }
 
-static inline void print_op(seal_byte* bytes, size_t byte_size, seal_word* labels, size_t label_size)
+static inline int short_jump_op(int op) /* returns short variant of jump or -1 */
 {
-  for (int i = 0; i < byte_size;) {
-    for (int j = 0; j < label_size; j++) {
-      if (i == labels[j]) {
-        printf("LABEL%d: %d\n", j, labels[j]);
-      }
-    }
+  switch (op) {
+  case OP_JUMP: return OP_JUMP_S;
+  case OP_JFALSE: return OP_JFALSE_S;
+  case OP_JTRUE: return OP_JTRUE_S;
+  case OP_FOR_PREP: return OP_FOR_PREP_S;
+  case OP_FOR_NEXT: return OP_FOR_NEXT_S;
+  case OP_JFALSE_LT_LI: return OP_JFALSE_LT_LI_S;
+  case OP_JFALSE_LE_LI: return OP_JFALSE_LE_LI_S;
+  case OP_JFALSE_GT_LI: return OP_JFALSE_GT_LI_S;
+  case OP_JFALSE_GE_LI: return OP_JFALSE_GE_LI_S;
+  case OP_JFALSE_EQ_LI: return OP_JFALSE_EQ_LI_S;
+  case OP_JFALSE_NE_LI: return OP_JFALSE_NE_LI_S;
+  case OP_JFALSE_OR_POP: return OP_JFALSE_OR_POP_S;
+  case OP_JTRUE_OR_POP: return OP_JTRUE_OR_POP_S;
+  case OP_R_JFALSE: return OP_R_JFALSE_S;
+  case OP_R_JTRUE: return OP_R_JTRUE_S;
+  case OP_R_JF_GT: return OP_R_JF_GT_S;
+  case OP_R_JF_GE: return OP_R_JF_GE_S;
+  case OP_R_JF_LT: return OP_R_JF_LT_S;
+  case OP_R_JF_LE: return OP_R_JF_LE_S;
+  case OP_R_JF_EQ: return OP_R_JF_EQ_S;
+  case OP_R_JF_NE: return OP_R_JF_NE_S;
+  default: return -1;
+  }
+}
+
+static inline int long_jump_op(int op) /* returns long variant of short jump or -1 */
+{
+  switch (op) {
+  case OP_JUMP_S: return OP_JUMP;
+  case OP_JFALSE_S: return OP_JFALSE;
+  case OP_JTRUE_S: return OP_JTRUE;
+  case OP_FOR_PREP_S: return OP_FOR_PREP;
+  case OP_FOR_NEXT_S: return OP_FOR_NEXT;
+  case OP_JFALSE_LT_LI_S: return OP_JFALSE_LT_LI;
+  case OP_JFALSE_LE_LI_S: return OP_JFALSE_LE_LI;
+  case OP_JFALSE_GT_LI_S: return OP_JFALSE_GT_LI;
+  case OP_JFALSE_GE_LI_S: return OP_JFALSE_GE_LI;
+  case OP_JFALSE_EQ_LI_S: return OP_JFALSE_EQ_LI;
+  case OP_JFALSE_NE_LI_S: return OP_JFALSE_NE_LI;
+  case OP_JFALSE_OR_POP_S: return OP_JFALSE_OR_POP;
+  case OP_JTRUE_OR_POP_S: return OP_JTRUE_OR_POP;
+  case OP_R_JFALSE_S: return OP_R_JFALSE;
+  case OP_R_JTRUE_S: return OP_R_JTRUE;
+  case OP_R_JF_GT_S: return OP_R_JF_GT;
+  case OP_R_JF_GE_S: return OP_R_JF_GE;
+  case OP_R_JF_LT_S: return OP_R_JF_LT;
+  case OP_R_JF_LE_S: return OP_R_JF_LE;
+  case OP_R_JF_EQ_S: return OP_R_JF_EQ;
+  case OP_R_JF_NE_S: return OP_R_JF_NE;
+  default: return -1;
+  }
+}
+
+#define IS_JUMP_OP(op)       (short_jump_op(op) >= 0) /* jump with 32-bit offset (label while compiling) */
+#define IS_SHORT_JUMP_OP(op) (long_jump_op(op) >= 0)  /* jump with 8-bit offset */
+#define SHORT_JUMP_OP(op)    ((seal_byte)short_jump_op(op))
+
+static inline int op_size(int op) /* size of instruction including its operands */
+{
+  switch (op) {
+  case OP_GET_LOCAL: case OP_SET_LOCAL: case OP_GEN_LIST: case OP_GEN_MAP: case OP_SWAP: case OP_COPY: case OP_INCLUDE_SYM:
+  case OP_CALL: case OP_TAIL_CALL: case OP_R_PUSH: case OP_R_POP:
+    return 2;
+  case OP_PUSH_CONST: case OP_PUSH_INT: case OP_GET_GLOBAL: case OP_SET_GLOBAL: case OP_ADD_LL:
+  case OP_GET_FIELD: case OP_SET_FIELD: case OP_GET_FIELD_LIST_INT: case OP_GET_FIELD_POLY:
+  case OP_R_MOVE: case OP_R_NOT: case OP_R_NEG: case OP_R_BNOT: case OP_R_TYPOF: case OP_R_CLEAR:
+    return 3;
+  case OP_INC_LOCAL: case OP_DEC_LOCAL: case OP_R_LOADI: case OP_R_LOADK:
+    return 4;
+  case OP_JUMP: case OP_JFALSE: case OP_JTRUE: case OP_FOR_PREP: case OP_JFALSE_OR_POP: case OP_JTRUE_OR_POP:
+    return 5;
+  case OP_FOR_NEXT: case OP_R_JFALSE: case OP_R_JTRUE:
+    return 6;
+  case OP_R_JF_GT: case OP_R_JF_GE: case OP_R_JF_LT: case OP_R_JF_LE: case OP_R_JF_EQ: case OP_R_JF_NE:
+    return 7;
+  case OP_JFALSE_LT_LI: case OP_JFALSE_LE_LI: case OP_JFALSE_GT_LI: case OP_JFALSE_GE_LI: case OP_JFALSE_EQ_LI: case OP_JFALSE_NE_LI:
+    return 8;
+  default:
+    if (op >= OP_R_ADD && op <= OP_R_IN)
+      return 4;
+    if (IS_SHORT_JUMP_OP(op))
+      return op_size(long_jump_op(op)) - 3;
+    return 1;
+  }
+}
+
+static inline size_t jump_target(seal_byte* bytes, size_t i) /* absolute target of jump at i */
+{
+  int size = op_size(bytes[i]);
+  seal_byte *offs = bytes + i + size;
+  if (IS_SHORT_JUMP_OP(bytes[i]))
+    return i + size + (int8_t)offs[-1];
+  return i + size + (int32_t)((uint32_t)offs[-4] << 24 | offs[-3] << 16 | offs[-2] << 8 | offs[-1]);
+}
+
+static inline void print_op(seal_byte* bytes, size_t byte_size)
+{
+  bool *is_target = SEAL_CALLOC(byte_size + 1, sizeof(bool));
+  for (size_t i = 0; i < byte_size; i += op_size(bytes[i]))
+    if (IS_JUMP_OP(bytes[i]) || IS_SHORT_JUMP_OP(bytes[i]))
+      is_target[jump_target(bytes, i)] = true;
+
+  for (size_t i = 0; i < byte_size;) {
+    if (is_target[i])
+      printf("LABEL: %zu\n", i);
+    size_t start = i;
     seal_byte op = bytes[i++];
     printf("%s ", op_name(op)); 
-    switch (op) { /* check if opcode requires byte(s) */
-    case OP_PUSH_CONST: case OP_PUSH_INT: {
-      seal_byte left  = bytes[i++];
-      seal_byte right = bytes[i++];
-      seal_word idx  = (left << 8) | right;
-      printf("%d", idx);
+    if (IS_JUMP_OP(op) || IS_SHORT_JUMP_OP(op)) {
+      switch (IS_SHORT_JUMP_OP(op) ? long_jump_op(op) : op) { /* operands before offset */
+      case OP_FOR_NEXT: case OP_R_JFALSE: case OP_R_JTRUE:
+        printf("%d, ", bytes[i]);
+        break;
+      case OP_R_JF_GT: case OP_R_JF_GE: case OP_R_JF_LT: case OP_R_JF_LE: case OP_R_JF_EQ: case OP_R_JF_NE:
+        printf("%d, %d, ", bytes[i], bytes[i + 1]);
+        break;
+      case OP_JFALSE_LT_LI: case OP_JFALSE_LE_LI: case OP_JFALSE_GT_LI: case OP_JFALSE_GE_LI: case OP_JFALSE_EQ_LI:
+      case OP_JFALSE_NE_LI:
+        printf("%d, %d, ", bytes[i], (bytes[i + 1] << 8) | bytes[i + 2]);
+        break;
+      }
+      size_t target = jump_target(bytes, start);
+      printf("%+ld (%zu)\n", (long)(target - (start + op_size(op))), target);
+      i = start + op_size(op);
+      continue;
     }
-    break;
-    case OP_JUMP: case OP_JFALSE: case OP_JTRUE: case OP_GET_GLOBAL: case OP_SET_GLOBAL: case OP_FOR_PREP: {
+    switch (op) { /* check if opcode requires byte(s) */
+    case OP_PUSH_CONST: case OP_PUSH_INT: case OP_GET_GLOBAL: case OP_SET_GLOBAL:
+    case OP_GET_FIELD: case OP_SET_FIELD: case OP_GET_FIELD_LIST_INT: case OP_GET_FIELD_POLY: {
       seal_byte left  = bytes[i++];
       seal_byte right = bytes[i++];
       seal_word idx  = (left << 8) | right;
       printf("%d", idx);
       break;
     }
-    case OP_GET_LOCAL: case OP_SET_LOCAL: case OP_GEN_LIST: case OP_GEN_MAP: case OP_SWAP: case OP_COPY: case OP_INCLUDE_SYM: {
-      seal_byte slot = bytes[i++];
-      printf("%d", slot);
+    case OP_GET_LOCAL: case OP_SET_LOCAL: case OP_GEN_LIST: case OP_GEN_MAP: case OP_SWAP: case OP_COPY: case OP_INCLUDE_SYM:
+    case OP_CALL: case OP_TAIL_CALL: case OP_R_PUSH: case OP_R_POP:
+      printf("%d", bytes[i++]);
       break;
-    }
-    case OP_CALL:
-      printf("%d", bytes[i++]);   
+    case OP_ADD_LL: case OP_R_MOVE: case OP_R_NOT: case OP_R_NEG: case OP_R_BNOT: case OP_R_TYPOF: case OP_R_CLEAR:
+      printf("%d, ", bytes[i++]);
+      printf("%d", bytes[i++]);
       break;
-    case OP_FOR_NEXT:
+    case OP_INC_LOCAL: case OP_DEC_LOCAL: case OP_R_LOADI: case OP_R_LOADK: {
       printf("%d, ", bytes[i++]);
       seal_byte left  = bytes[i++];
       seal_byte right = bytes[i++];
-      seal_word idx  = (left << 8) | right;
-      printf("%d", idx);
+      printf("%d", (left << 8) | right);
+      break;
+    }
+    case OP_R_ADD: case OP_R_SUB: case OP_R_MUL: case OP_R_DIV: case OP_R_MOD: case OP_R_AND: case OP_R_OR:
+    case OP_R_XOR: case OP_R_SHL: case OP_R_SHR: case OP_R_GT: case OP_R_GE: case OP_R_LT: case OP_R_LE:
+    case OP_R_EQ: case OP_R_NE: case OP_R_IN:
+      printf("%d, ", bytes[i++]);
+      printf("%d, ", bytes[i++]);
+      printf("%d", bytes[i++]);
+      break;
     }
     printf("\n");
   }
+  SEAL_FREE(is_target);
 }
 
 #endif /* SEAL_BYTECODE_H */
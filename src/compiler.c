@@ -1,11 +1,14 @@
 #include "compiler.h"
 #include "ast.h"
+#include "fold.h"
 #include "hashmap.h"
+#include "intern.h"
 #include "sealtypes.h"
 
 #define START_BYTECODE_CAP  8
 #define START_LINE_INFO_CAP 2
 #define START_POOL_CAP      8
+#define START_SYMTAB_CAP    64
 
 #define EMIT(bc, byte) do { \
     if ((bc)->size >= (bc)->cap) { \
@@ -24,16 +27,35 @@
     EMIT(bc, 0); \
   }
 
-#define REPLACE_16BITS_INDEX(addr, idx) do { \
-    *(addr) = (seal_byte)((idx) >> 8); \
-    *(addr + 1)   = (seal_byte)(idx); \
+#define REPLACE_LABEL(addr, idx) do { \
+    *(addr)     = (seal_byte)((idx) >> 24); \
+    *(addr + 1) = (seal_byte)((idx) >> 16); \
+    *(addr + 2) = (seal_byte)((idx) >> 8); \
+    *(addr + 3) = (seal_byte)(idx); \
   } while (0)
 
+#define GET_LABEL(addr) ((size_t)(addr)[0] << 24 | (size_t)(addr)[1] << 16 | (size_t)(addr)[2] << 8 | (addr)[3])
+
 #define SET_16BITS_INDEX(bc, idx) do { \
     EMIT(bc, (seal_word)(idx) >> 8); \
     EMIT(bc, (seal_word)(idx)); \
   } while (0)
 
+/* field access is followed by index of its inline cache */
+#define EMIT_FIELD_OP(s, op) do { \
+    if ((s)->cache_size > 0xFFFF) \
+      __compiler_error("maximum number of field accesses in a function is %d", 0xFFFF + 1); \
+    EMIT(&(s)->bc, op); \
+    SET_16BITS_INDEX(&(s)->bc, (s)->cache_size++); \
+  } while (0)
+
+#define SET_LABEL(bc, idx) do { \
+    EMIT(bc, (uint32_t)(idx) >> 24); \
+    EMIT(bc, (uint32_t)(idx) >> 16); \
+    EMIT(bc, (uint32_t)(idx) >> 8); \
+    EMIT(bc, (uint32_t)(idx)); \
+  } while (0)
+
 #define CUR_IDX(bc) ((bc)->size) /* returns index of current empty byte */
 #define LAST_OPCODE(bc) ((bc)->bytecodes[(bc)->size - 1]) /* returns last pushed opcode */
 #define CUR_ADDR(bc) (&((bc)->bytecodes[CUR_IDX(bc)])) /* returns address of current empty byte */
@@ -52,12 +74,12 @@
 #define PUSH_LABEL(pool, addr) do { \
     /* check bounds */ \
     if ((pool)->size >= (pool)->cap) { \
-      (pool)->addrs = SEAL_REALLOC((pool)->addrs, sizeof(seal_word) * ((pool)->cap *= 2)); \
+      (pool)->addrs = SEAL_REALLOC((pool)->addrs, sizeof(size_t) * ((pool)->cap *= 2)); \
     } \
     (pool)->addrs[(pool)->size++] = (addr); \
 } while (0)
 
-#define LABEL_IDX(pool) ((seal_word)((pool)->size - 1)) /* WARNING!! only use this after pushing label */
+#define LABEL_IDX(pool) ((pool)->size - 1) /* WARNING!! only use this after pushing label */
 
 #define __compiler_error(...) do { \
     fprintf(stderr, __VA_ARGS__); \
@@ -78,6 +100,74 @@
   (type) == TOK_SHR_ASSIGN ? OP_SHR : \
   -1)
 
+#define BINARY_OP_TYPE(type) ( \
+  (type) == TOK_PLUS  ? OP_ADD : \
+  (type) == TOK_MINUS ? OP_SUB : \
+  (type) == TOK_MUL   ? OP_MUL : \
+  (type) == TOK_DIV   ? OP_DIV : \
+  (type) == TOK_MOD   ? OP_MOD : \
+  (type) == TOK_BAND  ? OP_AND : \
+  (type) == TOK_BOR   ? OP_OR  : \
+  (type) == TOK_XOR   ? OP_XOR : \
+  (type) == TOK_SHL   ? OP_SHL : \
+  (type) == TOK_SHR   ? OP_SHR : \
+  (type) == TOK_EQ    ? OP_EQ  : \
+  (type) == TOK_NE    ? OP_NE  : \
+  (type) == TOK_GT    ? OP_GT  : \
+  (type) == TOK_GE    ? OP_GE  : \
+  (type) == TOK_LT    ? OP_LT  : \
+  (type) == TOK_LE    ? OP_LE  : \
+  (type) == TOK_IN    ? OP_IN  : \
+  -1)
+
+/* stack binary opcode to register one */
+#define REG_OP_TYPE(op) ((op) == OP_IN ? OP_R_IN : OP_R_ADD + ((op) - OP_ADD))
+
+/* call in return statement ends with 'OP_CALL argc', turn it into tail call */
+#define MARK_TAIL_CALL(expr, s) do { \
+    if ((expr)->type == AST_FUNC_CALL) \
+      (s)->bc.bytecodes[(s)->bc.size - 2] = OP_TAIL_CALL; \
+  } while (0)
+
+#define REG_NONE -1 /* no destination register is requested */
+#define SCOPE_LOCAL_SIZE(s) ((s)->temp_end > (s)->loctable.filled ? (s)->temp_end : (s)->loctable.filled)
+
+static int backend = BACKEND_STACK;
+static int opt_level = 1;
+static bool lazy = false;
+
+void compiler_set_backend(int b)
+{
+  backend = b;
+}
+
+int compiler_backend(void)
+{
+  return backend;
+}
+
+void compiler_set_opt_level(int level)
+{
+  opt_level = level;
+}
+
+int compiler_opt_level(void)
+{
+  return opt_level;
+}
+
+void compiler_set_lazy(bool enable)
+{
+  lazy = enable;
+}
+
+void compile_lazy(struct seal_func *func)
+{
+  struct lazy_def *def = func->as.userdef.lazy;
+  compile_func_body(def->cout, def->node, func);
+  func->as.userdef.lazy = NULL;
+  SEAL_FREE(def);
+}
 
 void compile(cout_t* cout, ast_t* node, const char *file_name)
 {
@@ -98,7 +188,7 @@ void compile(cout_t* cout, ast_t* node, const char *file_name)
     .lp = {
       .cap = START_POOL_CAP,
       .size = 0,
-      .addrs = SEAL_CALLOC(START_POOL_CAP, sizeof(seal_word))
+      .addrs = SEAL_CALLOC(START_POOL_CAP, sizeof(size_t))
     },
   };
   ///* constant values' pool */
@@ -112,6 +202,10 @@ void compile(cout_t* cout, ast_t* node, const char *file_name)
   ///* skip address offset stack */
   
   cout->file_name = file_name;
+  cout->is_lazy = lazy;
+
+  if (opt_level > 0)
+    fold_constants(node); /* ast of lazy functions is folded too */
 
   cout->skip_addr_offset_stack = SEAL_CALLOC(UNCOND_JMP_MAX_SIZE, sizeof(size_t));
 
@@ -120,20 +214,40 @@ void compile(cout_t* cout, ast_t* node, const char *file_name)
   cout->skip_size = 0;
   cout->stop_size = 0;
 
-  struct h_entry entries[LOCAL_MAX];
-  hashmap_init_static(&main_scope.loctable, entries, LOCAL_MAX);
+  hashmap_init(&cout->symtab, START_SYMTAB_CAP);
+
+  struct hashmap_static loctable;
+  hashmap_init_static(&main_scope.loctable, &loctable);
 
-  compile_node(cout, node, &main_scope);
+  compile_scope(cout, node, &main_scope);
 
-  cout->main_scope_local_size = main_scope.loctable.filled;
-  cout->labels = main_scope.lp.addrs;
+  cout->main_scope_local_size = SCOPE_LOCAL_SIZE(&main_scope);
   cout->const_pool = main_scope.cp.vals;
   cout->const_pool_size = main_scope.cp.size;
-  cout->label_pool_size = main_scope.lp.size;
+  cout->cache_size = main_scope.cache_size;
+  cout->caches = SEAL_CALLOC(main_scope.cache_size ? main_scope.cache_size : 1, sizeof(struct field_cache));
 
   EMIT(&main_scope.bc, OP_HALT); /* push halt opcode for termination */
+  select_superinstructions(&main_scope);
+  if (opt_level > 0)
+    peephole(&main_scope);
+  relax_jumps(&main_scope);
   cout->bc = main_scope.bc;
 }
+static seal_word global_slot(cout_t *cout, const char *name)
+{
+  hashmap_t *symtab = &cout->symtab;
+  struct h_entry *e = hashmap_search(symtab, name);
+  if (e->key != NULL)
+    return e->val.as._int;
+
+  if (symtab->filled >= GLOBAL_MAX)
+    __compiler_error("maximum number of globals is %d", GLOBAL_MAX);
+
+  /* table grows on its own, slots stay the same */
+  e = hashmap_insert_e(symtab, e, name, SEAL_VALUE_INT(symtab->filled));
+  return e->val.as._int;
+}
 static void compile_node(cout_t* cout, ast_t* node, struct scope *s)
 {
   switch (node->type) {
@@ -213,28 +327,28 @@ static void compile_if(cout_t* cout, ast_t* node, struct scope *s)
     temp_node = temp_node->_if._else;
     jmp_size++;
   }
-  size_t end_addr_offsets[jmp_size], *end_addr_offset = end_addr_offsets, next_addr_offset;
+  size_t end_addr_offsets[jmp_size ? jmp_size : 1], *end_addr_offset = end_addr_offsets, next_addr_offset;
 
   compile_node(cout, node->_if.cond, s);
 
   EMIT(&s->bc, OP_JFALSE);
   next_addr_offset = CUR_ADDR_OFFSET(&s->bc);
-  EMIT_DUMMY(&s->bc, 2); /* push 2 dummy values that will be changed later */
+  EMIT_DUMMY(&s->bc, 4); /* push 2 dummy values that will be changed later */
 
   compile_node(cout, node->_if.comp, s);
 
   if (jmp_size == 0) {
     PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
-    REPLACE_16BITS_INDEX(s->bc.bytecodes + next_addr_offset, LABEL_IDX(&s->lp));
+    REPLACE_LABEL(s->bc.bytecodes + next_addr_offset, LABEL_IDX(&s->lp));
     return;
   }
   
   EMIT(&s->bc, OP_JUMP);
   *end_addr_offset++ = CUR_ADDR_OFFSET(&s->bc);
-  EMIT_DUMMY(&s->bc, 2);
+  EMIT_DUMMY(&s->bc, 4);
 
   PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
-  REPLACE_16BITS_INDEX(s->bc.bytecodes + next_addr_offset, LABEL_IDX(&s->lp));
+  REPLACE_LABEL(s->bc.bytecodes + next_addr_offset, LABEL_IDX(&s->lp));
 
   do {
     node = node->_if._else;
@@ -244,7 +358,7 @@ static void compile_if(cout_t* cout, ast_t* node, struct scope *s)
 
       EMIT(&s->bc, OP_JFALSE);
       next_addr_offset = CUR_ADDR_OFFSET(&s->bc);
-      EMIT_DUMMY(&s->bc, 2);
+      EMIT_DUMMY(&s->bc, 4);
 
       compile_node(cout, node->_if.comp, s);
 
@@ -252,12 +366,12 @@ static void compile_if(cout_t* cout, ast_t* node, struct scope *s)
         if (node->_if.has_else) {
           EMIT(&s->bc, OP_JUMP);
           *end_addr_offset++ = CUR_ADDR_OFFSET(&s->bc);
-          EMIT_DUMMY(&s->bc, 2);
+          EMIT_DUMMY(&s->bc, 4);
         }
       }
 
       PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
-      REPLACE_16BITS_INDEX(s->bc.bytecodes + next_addr_offset, LABEL_IDX(&s->lp));
+      REPLACE_LABEL(s->bc.bytecodes + next_addr_offset, LABEL_IDX(&s->lp));
     } else {
       compile_node(cout, node->_else.comp, s);
     }
@@ -266,7 +380,7 @@ static void compile_if(cout_t* cout, ast_t* node, struct scope *s)
   PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
 
   for (int i = 0; i < jmp_size; i++) {
-    REPLACE_16BITS_INDEX(s->bc.bytecodes + end_addr_offsets[i], LABEL_IDX(&s->lp));
+    REPLACE_LABEL(s->bc.bytecodes + end_addr_offsets[i], LABEL_IDX(&s->lp));
   }
 }
 static void compile_while(cout_t* cout, ast_t* node, struct scope *s)
@@ -275,29 +389,29 @@ static void compile_while(cout_t* cout, ast_t* node, struct scope *s)
   size_t stop_start_size = cout->stop_size;
 
   PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
-  seal_word start = LABEL_IDX(&s->lp);
+  size_t start = LABEL_IDX(&s->lp);
   compile_node(cout, node->_while.cond, s);
 
   EMIT(&s->bc, OP_JFALSE);
   size_t end_addr_offs = CUR_ADDR_OFFSET(&s->bc);
-  EMIT_DUMMY(&s->bc, 2);
+  EMIT_DUMMY(&s->bc, 4);
 
   compile_node(cout, node->_while.comp, s);
 
   EMIT(&s->bc, OP_JUMP);
-  SET_16BITS_INDEX(&s->bc, start);
+  SET_LABEL(&s->bc, start);
   PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
-  REPLACE_16BITS_INDEX(s->bc.bytecodes + end_addr_offs, LABEL_IDX(&s->lp));
+  REPLACE_LABEL(s->bc.bytecodes + end_addr_offs, LABEL_IDX(&s->lp));
 
   if (skip_start_size < cout->skip_size) {
     for (int i = skip_start_size; i < cout->skip_size; i++) {
-      REPLACE_16BITS_INDEX(s->bc.bytecodes + cout->skip_addr_offset_stack[i], start);
+      REPLACE_LABEL(s->bc.bytecodes + cout->skip_addr_offset_stack[i], start);
     }
   }
   cout->skip_size = skip_start_size;
   if (stop_start_size < cout->stop_size) {
     for (int i = stop_start_size; i < cout->stop_size; i++) {
-      REPLACE_16BITS_INDEX(s->bc.bytecodes + cout->stop_addr_offset_stack[i], LABEL_IDX(&s->lp));
+      REPLACE_LABEL(s->bc.bytecodes + cout->stop_addr_offset_stack[i], LABEL_IDX(&s->lp));
     }
   }
   cout->stop_size = stop_start_size;
@@ -305,13 +419,13 @@ static void compile_while(cout_t* cout, ast_t* node, struct scope *s)
 static void compile_dowhile(cout_t* cout, ast_t* node, struct scope *s)
 {
   PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
-  seal_word start = LABEL_IDX(&s->lp);
+  size_t start = LABEL_IDX(&s->lp);
 
   compile_node(cout, node->_while.comp, s);
   compile_node(cout, node->_while.cond, s);
 
   EMIT(&s->bc, OP_JTRUE);
-  SET_16BITS_INDEX(&s->bc, start);
+  SET_LABEL(&s->bc, start);
 }
 static void compile_for(cout_t *cout, ast_t *node, struct scope *s)
 {
@@ -329,34 +443,34 @@ static void compile_for(cout_t *cout, ast_t *node, struct scope *s)
   if (e == NULL)
     __compiler_error("maximum number of locals is %d", LOCAL_MAX);
   if (e->key == NULL)
-    hashmap_insert_e(&s->loctable, e, it_name, SEAL_VALUE_INT((&s->loctable)->filled));
+    e = hashmap_insert_e(&s->loctable, e, it_name, SEAL_VALUE_INT((&s->loctable)->filled));
 
   EMIT(&s->bc, OP_FOR_PREP);
   size_t end_addr_offs = CUR_ADDR_OFFSET(&s->bc);
-  EMIT_DUMMY(&s->bc, 2);
+  EMIT_DUMMY(&s->bc, 4);
 
   PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
-  seal_word start_addr = LABEL_IDX(&s->lp);
+  size_t start_addr = LABEL_IDX(&s->lp);
   compile_node(cout, node->_for.comp, s);
 
   PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
-  REPLACE_16BITS_INDEX(s->bc.bytecodes + end_addr_offs, LABEL_IDX(&s->lp));
+  REPLACE_LABEL(s->bc.bytecodes + end_addr_offs, LABEL_IDX(&s->lp));
 
 
   EMIT(&s->bc, OP_FOR_NEXT);
   EMIT(&s->bc, e->val.as._int); /* push slot index of local table */
-  SET_16BITS_INDEX(&s->bc, start_addr);
+  SET_LABEL(&s->bc, start_addr);
 
   if (skip_start_size < cout->skip_size) {
     for (int i = skip_start_size; i < cout->skip_size; i++) {
-      REPLACE_16BITS_INDEX(s->bc.bytecodes + cout->skip_addr_offset_stack[i], LABEL_IDX(&s->lp));
+      REPLACE_LABEL(s->bc.bytecodes + cout->skip_addr_offset_stack[i], LABEL_IDX(&s->lp));
     }
   }
   cout->skip_size = skip_start_size;
   if (stop_start_size < cout->stop_size) {
     PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
     for (int i = stop_start_size; i < cout->stop_size; i++) {
-      REPLACE_16BITS_INDEX(s->bc.bytecodes + cout->stop_addr_offset_stack[i], LABEL_IDX(&s->lp));
+      REPLACE_LABEL(s->bc.bytecodes + cout->stop_addr_offset_stack[i], LABEL_IDX(&s->lp));
       if (LAST_OPCODE(&s->bc) != OP_FOR_STOP)
         EMIT(&s->bc, OP_FOR_STOP);
       /*
@@ -374,7 +488,7 @@ static inline void compile_skip(cout_t* cout, ast_t *node, struct scope *s)
     __compiler_error("maximum number of skip has exceeded");
   EMIT(&s->bc, OP_JUMP);
   cout->skip_addr_offset_stack[cout->skip_size++] = CUR_ADDR_OFFSET(&s->bc);
-  EMIT_DUMMY(&s->bc, 2);
+  EMIT_DUMMY(&s->bc, 4);
 }
 static inline void compile_stop(cout_t* cout, ast_t *node, struct scope *s)
 {
@@ -382,7 +496,7 @@ static inline void compile_stop(cout_t* cout, ast_t *node, struct scope *s)
     __compiler_error("maximum number of stop has exceeded");
   EMIT(&s->bc, OP_JUMP);
   cout->stop_addr_offset_stack[cout->stop_size++] = CUR_ADDR_OFFSET(&s->bc);
-  EMIT_DUMMY(&s->bc, 2);
+  EMIT_DUMMY(&s->bc, 4);
 }
 static void compile_unary(cout_t* cout, ast_t* node, struct scope *s)
 {
@@ -403,29 +517,8 @@ static void compile_binary(cout_t* cout, ast_t* node, struct scope *s)
 {
   compile_node(cout, node->binary.left, s);
   compile_node(cout, node->binary.right, s);
-  
-  seal_byte opcode;
-  switch (node->binary.op_type) {
-  case TOK_PLUS : opcode = OP_ADD; break;
-  case TOK_MINUS: opcode = OP_SUB; break;
-  case TOK_MUL  : opcode = OP_MUL; break;
-  case TOK_DIV  : opcode = OP_DIV; break;
-  case TOK_MOD  : opcode = OP_MOD; break;
-  case TOK_BAND : opcode = OP_AND; break;
-  case TOK_BOR  : opcode = OP_OR;  break;
-  case TOK_XOR  : opcode = OP_XOR; break;
-  case TOK_SHL  : opcode = OP_SHL; break;
-  case TOK_SHR  : opcode = OP_SHR; break;
-  case TOK_EQ   : opcode = OP_EQ;  break;
-  case TOK_NE   : opcode = OP_NE;  break;
-  case TOK_GT   : opcode = OP_GT;  break;
-  case TOK_GE   : opcode = OP_GE;  break;
-  case TOK_LT   : opcode = OP_LT;  break;
-  case TOK_LE   : opcode = OP_LE;  break;
-  case TOK_IN   : opcode = OP_IN;  break;
-  }
 
-  EMIT(&s->bc, opcode);
+  EMIT(&s->bc, BINARY_OP_TYPE(node->binary.op_type));
 }
 static void compile_logical_binary(cout_t* cout, ast_t* node, struct scope *s)
 {
@@ -439,13 +532,13 @@ static void compile_logical_binary(cout_t* cout, ast_t* node, struct scope *s)
     EMIT(&s->bc, OP_JTRUE);
   }
   size_t end_addr_offset = CUR_ADDR_OFFSET(&s->bc); /* store end address offset */
-  EMIT_DUMMY(&s->bc, 2); /* push zero bytes */
+  EMIT_DUMMY(&s->bc, 4); /* push zero bytes */
   EMIT(&s->bc, OP_POP); /* pop first value if no jump */
 
   compile_node(cout, node->binary.right, s); /* compile right side */
 
   PUSH_LABEL(&s->lp, CUR_IDX(&s->bc)); /* push end label */
-  REPLACE_16BITS_INDEX(s->bc.bytecodes + end_addr_offset, LABEL_IDX(&s->lp)); /* replace zero bytes with end label index */
+  REPLACE_LABEL(s->bc.bytecodes + end_addr_offset, LABEL_IDX(&s->lp)); /* replace zero bytes with end label index */
 }
 static void compile_val(cout_t* cout, ast_t* node, struct scope *s)
 {
@@ -458,7 +551,7 @@ static void compile_val(cout_t* cout, ast_t* node, struct scope *s)
     EMIT(&s->bc, OP_PUSH_NULL);
     return;
   case AST_INT:
-    if (node->integer.val <= 0xFFFF) {
+    if (node->integer.val >= 0 && node->integer.val <= 0xFFFF) {
       EMIT(&s->bc, OP_PUSH_INT);
       SET_16BITS_INDEX(&s->bc, node->integer.val);
       return;
@@ -469,7 +562,7 @@ static void compile_val(cout_t* cout, ast_t* node, struct scope *s)
     val = sval(SEAL_FLOAT, _float, node->floating.val);
     break;
   case AST_STRING:
-    val = SEAL_VALUE_STRING_STATIC(node->string.val);
+    val = SEAL_VALUE_STRING_INTERNED(node->string.val);
     break;
   }
 
@@ -498,9 +591,9 @@ static void compile_func_call(cout_t* cout, ast_t* node, struct scope *s)
   compile_node(cout, node->func_call.main->memacc.main, s);
   EMIT(&s->bc, OP_DUP);
   EMIT(&s->bc, OP_PUSH_CONST); /* push opcode */
-  PUSH_CONST(&s->cp, SEAL_VALUE_STRING_STATIC(node->func_call.main->memacc.mem->var_ref.name)); /* push constant into pool */
+  PUSH_CONST(&s->cp, SEAL_VALUE_STRING_INTERNED(node->func_call.main->memacc.mem->var_ref.name)); /* push constant into pool */
   SET_16BITS_INDEX(&s->bc, CONST_IDX(&s->cp));
-  EMIT(&s->bc, OP_GET_FIELD);
+  EMIT_FIELD_OP(s, OP_GET_FIELD);
   EMIT(&s->bc, OP_SWAP);
   EMIT(&s->bc, 2);
 
@@ -513,7 +606,6 @@ static void compile_func_call(cout_t* cout, ast_t* node, struct scope *s)
 static void compile_assign(cout_t* cout, ast_t* node, struct scope *s)
 {
   int lval_type = node->assign.var->type;
-  svalue_t sym;
   const char* name;
   struct h_entry* e;
 
@@ -524,9 +616,7 @@ static void compile_assign(cout_t* cout, ast_t* node, struct scope *s)
     case AST_VAR_REF:
       if (node->assign.var->var_ref.is_global) {
         EMIT(&s->bc, OP_SET_GLOBAL);
-        sym = SEAL_VALUE_STRING_STATIC(node->assign.var->var_ref.name);
-        PUSH_CONST(&s->cp, sym);
-        SET_16BITS_INDEX(&s->bc, CONST_IDX(&s->cp));
+        SET_16BITS_INDEX(&s->bc, global_slot(cout, node->assign.var->var_ref.name));
       } else {
         EMIT(&s->bc, OP_SET_LOCAL);
         name = node->assign.var->var_ref.name;
@@ -535,7 +625,7 @@ static void compile_assign(cout_t* cout, ast_t* node, struct scope *s)
           __compiler_error("maximum number of locals is %d", LOCAL_MAX);
 
         if (e->key == NULL)
-          hashmap_insert_e(&s->loctable, e, name, SEAL_VALUE_INT((&s->loctable)->filled));
+          e = hashmap_insert_e(&s->loctable, e, name, SEAL_VALUE_INT((&s->loctable)->filled));
 
         EMIT(&s->bc, e->val.as._int); /* push slot index of local table */
       }
@@ -543,14 +633,14 @@ static void compile_assign(cout_t* cout, ast_t* node, struct scope *s)
     case AST_SUBSCRIPT:
       compile_node(cout, node->assign.var->subscript.main, s);
       compile_node(cout, node->assign.var->subscript.index, s);
-      EMIT(&s->bc, OP_SET_FIELD);
+      EMIT_FIELD_OP(s, OP_SET_FIELD);
       break;
     case AST_MEMACC:
       compile_node(cout, node->assign.var->memacc.main, s);
       EMIT(&s->bc, OP_PUSH_CONST); /* push opcode */
-      PUSH_CONST(&s->cp, SEAL_VALUE_STRING_STATIC(node->assign.var->memacc.mem->var_ref.name)); /* push constant into pool */
+      PUSH_CONST(&s->cp, SEAL_VALUE_STRING_INTERNED(node->assign.var->memacc.mem->var_ref.name)); /* push constant into pool */
       SET_16BITS_INDEX(&s->bc, CONST_IDX(&s->cp));
-      EMIT(&s->bc, OP_SET_FIELD);
+      EMIT_FIELD_OP(s, OP_SET_FIELD);
       break;
     default:
       __compiler_error("assigning to %s is not implemented yet", hast_type_name(lval_type));
@@ -563,9 +653,7 @@ static void compile_assign(cout_t* cout, ast_t* node, struct scope *s)
     case AST_VAR_REF:
       if (node->assign.var->var_ref.is_global) {
         EMIT(&s->bc, OP_GET_GLOBAL);
-        sym = SEAL_VALUE_STRING_STATIC(node->assign.var->var_ref.name);
-        PUSH_CONST(&s->cp, sym);
-        sym_idx = CONST_IDX(&s->cp);
+        sym_idx = global_slot(cout, node->assign.var->var_ref.name);
         SET_16BITS_INDEX(&s->bc, sym_idx);
         compile_node(cout, node->assign.expr, s);
         EMIT(&s->bc, AUG_ASSIGN_OP_TYPE(aug_type));
@@ -592,24 +680,24 @@ static void compile_assign(cout_t* cout, ast_t* node, struct scope *s)
       EMIT(&s->bc, 2);
       EMIT(&s->bc, OP_COPY);
       EMIT(&s->bc, 2);
-      EMIT(&s->bc, OP_GET_FIELD);
+      EMIT_FIELD_OP(s, OP_GET_FIELD);
       compile_node(cout, node->assign.expr, s);
       EMIT(&s->bc, AUG_ASSIGN_OP_TYPE(aug_type));
       EMIT(&s->bc, OP_SWAP);
       EMIT(&s->bc, 3);
       EMIT(&s->bc, OP_SWAP);
       EMIT(&s->bc, 2);
-      EMIT(&s->bc, OP_SET_FIELD);
+      EMIT_FIELD_OP(s, OP_SET_FIELD);
       break;
     case AST_MEMACC:
       compile_node(cout, node->assign.var->memacc.main, s);
       EMIT(&s->bc, OP_DUP);
       EMIT(&s->bc, OP_PUSH_CONST); /* push opcode */
-      PUSH_CONST(&s->cp, SEAL_VALUE_STRING_STATIC(node->assign.var->memacc.mem->var_ref.name)); /* push constant into pool */
+      PUSH_CONST(&s->cp, SEAL_VALUE_STRING_INTERNED(node->assign.var->memacc.mem->var_ref.name)); /* push constant into pool */
       sym_idx = CONST_IDX(&s->cp);
       SET_16BITS_INDEX(&s->bc, sym_idx);
 
-      EMIT(&s->bc, OP_GET_FIELD);
+      EMIT_FIELD_OP(s, OP_GET_FIELD);
 
       compile_node(cout, node->assign.expr, s);
 
@@ -620,7 +708,7 @@ static void compile_assign(cout_t* cout, ast_t* node, struct scope *s)
 
       EMIT(&s->bc, OP_PUSH_CONST); /* push opcode */
       SET_16BITS_INDEX(&s->bc, sym_idx);
-      EMIT(&s->bc, OP_SET_FIELD);
+      EMIT_FIELD_OP(s, OP_SET_FIELD);
       break;
     default:
       __compiler_error("assigning to %s is not implemented yet", hast_type_name(lval_type));
@@ -640,11 +728,11 @@ static void compile_var_ref(cout_t* cout, ast_t* node, struct scope *s)
   } else {
 global:
     EMIT(&s->bc, OP_GET_GLOBAL);
-    PUSH_CONST(&s->cp, SEAL_VALUE_STRING_STATIC(node->var_ref.name));
-    SET_16BITS_INDEX(&s->bc, CONST_IDX(&s->cp));
+    SET_16BITS_INDEX(&s->bc, global_slot(cout, node->var_ref.name));
   }
 }
-static void compile_func_def(cout_t* cout, ast_t* node, struct scope *s)
+/* compiles body of function definition into function object */
+static void compile_func_body(cout_t* cout, ast_t* node, struct seal_func *func)
 {
   struct scope loc_scope = {
     .cp = {
@@ -663,38 +751,53 @@ static void compile_func_def(cout_t* cout, ast_t* node, struct scope *s)
     .lp = {
       .cap = START_POOL_CAP,
       .size = 0,
-      .addrs = SEAL_CALLOC(START_POOL_CAP, sizeof(seal_word))
+      .addrs = SEAL_CALLOC(START_POOL_CAP, sizeof(size_t))
     }
   };
-  struct h_entry entries[LOCAL_MAX];
-  hashmap_init_static(&loc_scope.loctable, entries, LOCAL_MAX);
+  struct hashmap_static loctable;
+  hashmap_init_static(&loc_scope.loctable, &loctable);
   for (int i = 0; i < node->func_def.param_size; i++) {
     hashmap_insert(&loc_scope.loctable, node->func_def.param_names[i], SEAL_VALUE_INT(i));
   }
 
-  svalue_t func_obj = {
-    .type = SEAL_FUNC,
-    .as.func = {
-      .type = FUNC_USERDEF,
-      .is_vararg = node->func_def.is_variadic,
-      .name = node->func_def.name,
-      .as.userdef = {
-        .argc = node->func_def.param_size - node->func_def.is_variadic,
-        .globals = NULL,
-        .file_name = cout->file_name,
-      }
-    }
-  };
-
-  compile_node(cout, node->func_def.comp, &loc_scope);
+  compile_scope(cout, node->func_def.comp, &loc_scope);
   EMIT(&loc_scope.bc, OP_PUSH_NULL);
   EMIT(&loc_scope.bc, OP_HALT);
-  func_obj.as.func.as.userdef.bytecode = loc_scope.bc.bytecodes;
-  func_obj.as.func.as.userdef.const_pool = loc_scope.cp.vals;
-  func_obj.as.func.as.userdef.label_pool = loc_scope.lp.addrs;
-  func_obj.as.func.as.userdef.local_size = loc_scope.loctable.filled; /* assign size of locals */
-  func_obj.as.func.as.userdef.linfo = loc_scope.bc.linfo; /* assign line info */
-  func_obj.as.func.as.userdef.linfo_size = loc_scope.bc.l_size; /* assign line info size */
+  select_superinstructions(&loc_scope);
+  if (opt_level > 0)
+    peephole(&loc_scope);
+  relax_jumps(&loc_scope);
+  func->as.userdef.bytecode = loc_scope.bc.bytecodes;
+  func->as.userdef.bytecode_size = loc_scope.bc.size;
+  func->as.userdef.const_pool = loc_scope.cp.vals;
+  func->as.userdef.const_pool_size = loc_scope.cp.size;
+  func->as.userdef.local_size = SCOPE_LOCAL_SIZE(&loc_scope); /* assign size of locals */
+  func->as.userdef.linfo = loc_scope.bc.linfo; /* assign line info */
+  func->as.userdef.linfo_size = loc_scope.bc.l_size; /* assign line info size */
+  func->as.userdef.cache_size = loc_scope.cache_size;
+  func->as.userdef.caches = SEAL_CALLOC(loc_scope.cache_size ? loc_scope.cache_size : 1, sizeof(struct field_cache));
+}
+static void compile_func_def(cout_t* cout, ast_t* node, struct scope *s)
+{
+  svalue_t func_obj = SEAL_VALUE_FUNC(((struct seal_func) {
+    .type = FUNC_USERDEF,
+    .is_vararg = node->func_def.is_variadic,
+    .name = node->func_def.name,
+    .as.userdef = {
+      .argc = node->func_def.param_size - node->func_def.is_variadic,
+      .globals = NULL,
+      .file_name = cout->file_name,
+    }
+  }));
+
+  if (cout->is_lazy) {
+    /* body is compiled on first call, its ast is kept until then */
+    struct lazy_def *def = SEAL_MALLOC(sizeof(struct lazy_def));
+    *def = (struct lazy_def) { .node = node, .cout = cout };
+    AS_FUNC(func_obj).as.userdef.lazy = def;
+  } else {
+    compile_func_body(cout, node, func_obj.as.func);
+  }
 
   EMIT(&s->bc, OP_PUSH_CONST); /* push function object to constant pool */
   PUSH_CONST(&s->cp, func_obj);
@@ -704,14 +807,14 @@ static void compile_func_def(cout_t* cout, ast_t* node, struct scope *s)
 
   if (!is_anonym) {
     EMIT(&s->bc, OP_SET_GLOBAL); /* set function object to global */
-    PUSH_CONST(&s->cp, SEAL_VALUE_STRING_STATIC(node->func_def.name));
-    SET_16BITS_INDEX(&s->bc, CONST_IDX(&s->cp));
+    SET_16BITS_INDEX(&s->bc, global_slot(cout, node->func_def.name));
     EMIT(&s->bc, OP_POP);
   }
 }
 static void compile_return(cout_t* cout, ast_t* node, struct scope *s)
 {
   compile_node(cout, node->_return.expr, s);
+  MARK_TAIL_CALL(node->_return.expr, s);
   EMIT(&s->bc, OP_HALT);
 }
 static void compile_list(cout_t* cout, ast_t* node, struct scope *s)
@@ -728,7 +831,7 @@ static void compile_subscript(cout_t* cout, ast_t* node, struct scope *s)
 {
   compile_node(cout, node->subscript.main, s);
   compile_node(cout, node->subscript.index, s);
-  EMIT(&s->bc, OP_GET_FIELD);
+  EMIT_FIELD_OP(s, OP_GET_FIELD);
 }
 static void compile_map(cout_t* cout, ast_t* node, struct scope *s)
 {
@@ -737,7 +840,7 @@ static void compile_map(cout_t* cout, ast_t* node, struct scope *s)
   for (int i = 0; i < node->map.field_size; i++) {
     compile_node(cout, node->map.field_vals[i], s);
     EMIT(&s->bc, OP_PUSH_CONST); /* push opcode */
-    PUSH_CONST(&s->cp, SEAL_VALUE_STRING_STATIC(node->map.field_names[i])); /* push constant into pool */
+    PUSH_CONST(&s->cp, SEAL_VALUE_STRING_INTERNED(node->map.field_names[i])); /* push constant into pool */
     SET_16BITS_INDEX(&s->bc, CONST_IDX(&s->cp));
   }
 
@@ -748,29 +851,28 @@ static void compile_memacc(cout_t* cout, ast_t* node, struct scope *s)
 {
   compile_node(cout, node->memacc.main, s);
   EMIT(&s->bc, OP_PUSH_CONST); /* push opcode */
-  PUSH_CONST(&s->cp, SEAL_VALUE_STRING_STATIC(node->memacc.mem->var_ref.name)); /* push constant into pool */
+  PUSH_CONST(&s->cp, SEAL_VALUE_STRING_INTERNED(node->memacc.mem->var_ref.name)); /* push constant into pool */
   SET_16BITS_INDEX(&s->bc, CONST_IDX(&s->cp));
-  EMIT(&s->bc, OP_GET_FIELD);
+  EMIT_FIELD_OP(s, OP_GET_FIELD);
 }
 static void compile_include(cout_t *cout, ast_t *node, struct scope *s)
 {
   EMIT(&s->bc, OP_PUSH_CONST); /* push opcode */
-  PUSH_CONST(&s->cp, SEAL_VALUE_STRING_STATIC(node->include.name)); /* push module name into pool */
+  PUSH_CONST(&s->cp, SEAL_VALUE_STRING_INTERNED(node->include.name)); /* push module name into pool */
   SET_16BITS_INDEX(&s->bc, CONST_IDX(&s->cp));
   EMIT(&s->bc, OP_INCLUDE); /* pushes module to stack */
 
   if (node->include.symbols_size == 0) {
     EMIT(&s->bc, OP_SET_GLOBAL);
-    if (node->include.alias)
-      PUSH_CONST(&s->cp, SEAL_VALUE_STRING_STATIC(node->include.alias)); /* push alias name into pool */
-
-    SET_16BITS_INDEX(&s->bc, CONST_IDX(&s->cp));
+    SET_16BITS_INDEX(&s->bc, global_slot(cout, node->include.alias ? node->include.alias : node->include.name));
     EMIT(&s->bc, OP_POP); /* pop module */
   } else {
     for (int i = 0; i < node->include.symbols_size; i++) {
       EMIT(&s->bc, OP_PUSH_CONST); /* push opcode */
-      PUSH_CONST(&s->cp, SEAL_VALUE_STRING_STATIC(node->include.symbols[i])); /* push symbol name into pool */
-      SET_16BITS_INDEX(&s->bc, CONST_IDX(&s->cp));     
+      PUSH_CONST(&s->cp, SEAL_VALUE_STRING_INTERNED(node->include.symbols[i])); /* push symbol name into pool */
+      SET_16BITS_INDEX(&s->bc, CONST_IDX(&s->cp));
+      EMIT(&s->bc, OP_PUSH_INT); /* push global slot of symbol */
+      SET_16BITS_INDEX(&s->bc, global_slot(cout, node->include.symbols[i]));
     }
     EMIT(&s->bc, OP_INCLUDE_SYM);
     EMIT(&s->bc, node->include.symbols_size);
@@ -783,19 +885,919 @@ static void compile_ternary(cout_t* cout, ast_t* node, struct scope *s)
 
   EMIT(&s->bc, OP_JFALSE); /* if false, jump to else (false) expression */
   size_t else_addr_offset = CUR_ADDR_OFFSET(&s->bc); /* store else address offset */
-  EMIT_DUMMY(&s->bc, 2); /* push zero bytes */
+  EMIT_DUMMY(&s->bc, 4); /* push zero bytes */
 
   compile_node(cout, node->ternary.expr_true, s);
 
   EMIT(&s->bc, OP_JUMP);
   size_t end_addr_offset = CUR_ADDR_OFFSET(&s->bc); /* store end address offset */
-  EMIT_DUMMY(&s->bc, 2); /* push zero bytes */
+  EMIT_DUMMY(&s->bc, 4); /* push zero bytes */
 
   PUSH_LABEL(&s->lp, CUR_IDX(&s->bc)); /* push else label */
-  REPLACE_16BITS_INDEX(s->bc.bytecodes + else_addr_offset, LABEL_IDX(&s->lp)); /* replace zero bytes with else label index */
+  REPLACE_LABEL(s->bc.bytecodes + else_addr_offset, LABEL_IDX(&s->lp)); /* replace zero bytes with else label index */
 
   compile_node(cout, node->ternary.expr_false, s);
 
   PUSH_LABEL(&s->lp, CUR_IDX(&s->bc)); /* push end label */
-  REPLACE_16BITS_INDEX(s->bc.bytecodes + end_addr_offset, LABEL_IDX(&s->lp)); /* replace zero bytes with end label index */
+  REPLACE_LABEL(s->bc.bytecodes + end_addr_offset, LABEL_IDX(&s->lp)); /* replace zero bytes with end label index */
+}
+/* compiles body of a scope with selected backend */
+static void compile_scope(cout_t* cout, ast_t* node, struct scope *s)
+{
+  if (backend != BACKEND_REGISTER) {
+    compile_node(cout, node, s);
+    return;
+  }
+  /* temporaries start after every name that can become local in scope */
+  struct hashmap_static storage;
+  hashmap_t names;
+  hashmap_init_static(&names, &storage);
+  for (int i = 0; i < s->loctable.cap; i++)
+    if (s->loctable.entries[i].key != NULL)
+      hashmap_insert(&names, s->loctable.entries[i].key, SEAL_VALUE_NULL);
+  count_locals(node, &names);
+
+  s->temp_base = s->temp_top = s->temp_end = names.filled;
+  compile_reg_node(cout, node, s);
+}
+static void count_locals(ast_t* node, hashmap_t* names)
+{
+  struct h_entry* e;
+  const char* name = NULL;
+
+  if (node == NULL)
+    return;
+  switch (node->type) {
+  case AST_COMP:
+    for (int i = 0; i < node->comp.stmt_size; i++)
+      count_locals(node->comp.stmts[i], names);
+    break;
+  case AST_IF:
+    count_locals(node->_if.cond, names);
+    count_locals(node->_if.comp, names);
+    if (node->_if.has_else)
+      count_locals(node->_if._else, names);
+    break;
+  case AST_ELSE:
+    count_locals(node->_else.comp, names);
+    break;
+  case AST_WHILE: case AST_DOWHILE:
+    count_locals(node->_while.cond, names);
+    count_locals(node->_while.comp, names);
+    break;
+  case AST_FOR:
+    name = node->_for.it_name;
+    count_locals(node->_for.ited, names);
+    count_locals(node->_for.comp, names);
+    break;
+  case AST_ASSIGN:
+    if (node->assign.var->type == AST_VAR_REF && !node->assign.var->var_ref.is_global)
+      name = node->assign.var->var_ref.name;
+    count_locals(node->assign.var, names);
+    count_locals(node->assign.expr, names);
+    break;
+  case AST_UNARY:
+    count_locals(node->unary.expr, names);
+    break;
+  case AST_BINARY: case AST_BINARY_BOOL:
+    count_locals(node->binary.left, names);
+    count_locals(node->binary.right, names);
+    break;
+  case AST_TERNARY:
+    count_locals(node->ternary.cond, names);
+    count_locals(node->ternary.expr_true, names);
+    count_locals(node->ternary.expr_false, names);
+    break;
+  case AST_FUNC_CALL:
+    count_locals(node->func_call.main, names);
+    for (int i = 0; i < node->func_call.arg_size; i++)
+      count_locals(node->func_call.args[i], names);
+    break;
+  case AST_SUBSCRIPT:
+    count_locals(node->subscript.main, names);
+    count_locals(node->subscript.index, names);
+    break;
+  case AST_MEMACC:
+    count_locals(node->memacc.main, names);
+    break;
+  case AST_LIST:
+    for (int i = 0; i < node->list.mem_size; i++)
+      count_locals(node->list.mems[i], names);
+    break;
+  case AST_MAP:
+    for (int i = 0; i < node->map.field_size; i++)
+      count_locals(node->map.field_vals[i], names);
+    break;
+  case AST_RETURN:
+    count_locals(node->_return.expr, names);
+    break;
+  default: /* function definitions have their own scope */
+    break;
+  }
+  if (name == NULL)
+    return;
+  e = hashmap_search(names, name);
+  if (e == NULL)
+    __compiler_error("maximum number of locals is %d", LOCAL_MAX);
+  if (e->key == NULL)
+    hashmap_insert_e(names, e, name, SEAL_VALUE_NULL);
+}
+static int alloc_temp(struct scope *s)
+{
+  if (s->temp_top >= LOCAL_MAX)
+    __compiler_error("maximum number of registers is %d", LOCAL_MAX);
+  if (s->temp_top + 1 > s->temp_end)
+    s->temp_end = s->temp_top + 1;
+  return s->temp_top++;
+}
+/* nulls temporaries that code emitted since start may have left holding objects */
+static void clear_temps(ast_t* node, struct scope *s, size_t start)
+{
+  seal_byte *code = s->bc.bytecodes;
+  int lo = LOCAL_MAX, hi = -1;
+
+  for (size_t i = start; i < s->bc.size; i += op_size(code[i])) {
+    seal_byte op = code[i];
+    if (op != OP_R_MOVE && op != OP_R_POP && (op < OP_R_ADD || op > OP_R_DIV))
+      continue; /* other ops leave ints, bools or interned constants */
+    if (code[i + 1] < s->temp_base)
+      continue;
+    if (code[i + 1] < lo) lo = code[i + 1];
+    if (code[i + 1] > hi) hi = code[i + 1];
+  }
+  if (hi < 0)
+    return;
+  EMIT(&s->bc, OP_R_CLEAR);
+  EMIT(&s->bc, lo);
+  EMIT(&s->bc, hi - lo + 1);
+}
+/* checks if node contains an assignment, which may change registers already read */
+static bool has_assign(ast_t* node)
+{
+  switch (node->type) {
+  case AST_ASSIGN:
+    return true;
+  case AST_UNARY:
+    return has_assign(node->unary.expr);
+  case AST_BINARY: case AST_BINARY_BOOL:
+    return has_assign(node->binary.left) || has_assign(node->binary.right);
+  case AST_TERNARY:
+    return has_assign(node->ternary.cond) || has_assign(node->ternary.expr_true) || has_assign(node->ternary.expr_false);
+  case AST_FUNC_CALL:
+    for (int i = 0; i < node->func_call.arg_size; i++)
+      if (has_assign(node->func_call.args[i]))
+        return true;
+    return has_assign(node->func_call.main);
+  case AST_SUBSCRIPT:
+    return has_assign(node->subscript.main) || has_assign(node->subscript.index);
+  case AST_MEMACC:
+    return has_assign(node->memacc.main);
+  case AST_LIST:
+    for (int i = 0; i < node->list.mem_size; i++)
+      if (has_assign(node->list.mems[i]))
+        return true;
+    return false;
+  case AST_MAP:
+    for (int i = 0; i < node->map.field_size; i++)
+      if (has_assign(node->map.field_vals[i]))
+        return true;
+    return false;
+  default:
+    return false;
+  }
+}
+static inline int local_slot(ast_t* var_ref, struct scope *s)
+{
+  if (var_ref->var_ref.is_global)
+    return REG_NONE;
+  struct h_entry* e = hashmap_search(&s->loctable, var_ref->var_ref.name);
+  if (e == NULL || e->key == NULL)
+    return REG_NONE;
+  return e->val.as._int;
+}
+static bool is_reg_expr(ast_t* node, struct scope *s)
+{
+  switch (node->type) {
+  case AST_NULL: case AST_INT: case AST_FLOAT: case AST_STRING: case AST_BOOL:
+  case AST_BINARY_BOOL: case AST_TERNARY:
+    return true;
+  case AST_VAR_REF:
+    return local_slot(node, s) != REG_NONE;
+  case AST_BINARY: /* operands from stack are cheaper to combine on stack */
+    return !has_assign(node->binary.right) && is_reg_expr(node->binary.left, s) && is_reg_expr(node->binary.right, s);
+  case AST_UNARY:
+    switch (node->unary.op_type) {
+    case TOK_NOT: case TOK_MINUS: case TOK_TYPEOF: case TOK_BNOT: case TOK_PLUS:
+      return true;
+    }
+    return false;
+  case AST_ASSIGN:
+    if (node->assign.var->type != AST_VAR_REF || node->assign.var->var_ref.is_global)
+      return false;
+    if (node->assign.op_type == TOK_ASSIGN)
+      return true;
+    return local_slot(node->assign.var, s) != REG_NONE && !has_assign(node->assign.expr);
+  default:
+    return false;
+  }
+}
+static void compile_reg_node(cout_t* cout, ast_t* node, struct scope *s)
+{
+  switch (node->type) {
+  case AST_COMP:
+    for (int i = 0; i < node->comp.stmt_size; i++) {
+      ast_t* stmt = node->comp.stmts[i];
+      size_t start = s->bc.size;
+      switch (stmt->type) {
+        case AST_NULL:
+        case AST_INT:
+        case AST_FLOAT:
+        case AST_STRING:
+        case AST_BOOL:
+          break;
+        case AST_FUNC_DEF:
+          compile_node(cout, stmt, s);
+          if (stmt->func_def.name == NULL)
+            EMIT(&s->bc, OP_POP);
+          break;
+        case AST_UNARY:
+        case AST_BINARY:
+        case AST_BINARY_BOOL:
+        case AST_TERNARY:
+        case AST_ASSIGN:
+        case AST_VAR_REF:
+          if (is_reg_expr(stmt, s)) {
+            compile_reg_expr(cout, stmt, s, REG_NONE);
+            break;
+          }
+          /* fall through */
+        case AST_FUNC_CALL:
+        case AST_LIST:
+        case AST_MAP:
+        case AST_SUBSCRIPT:
+        case AST_MEMACC:
+          compile_reg_push(cout, stmt, s);
+          EMIT(&s->bc, OP_POP);
+          break;
+        default:
+          compile_reg_node(cout, stmt, s);
+          break;
+      }
+      clear_temps(stmt, s, start); /* so they do not keep dropped objects alive */
+      s->temp_top = s->temp_base; /* temporaries do not live across statements */
+    }
+    break;
+  case AST_IF: compile_reg_if(cout, node, s); break;
+  case AST_WHILE: compile_reg_while(cout, node, s); break;
+  case AST_DOWHILE: compile_reg_dowhile(cout, node, s); break;
+  case AST_FOR: compile_reg_for(cout, node, s); break;
+  case AST_RETURN: compile_reg_return(cout, node, s); break;
+  default:
+    compile_node(cout, node, s);
+    break;
+  }
+}
+static int compile_reg_expr(cout_t* cout, ast_t* node, struct scope *s, int dst)
+{
+  int mark = s->temp_top, d, left, right, slot;
+  size_t end_addr_offset, else_addr_offset;
+  svalue_t val;
+
+  if (!is_reg_expr(node, s)) {
+    compile_reg_push(cout, node, s);
+    d = dst == REG_NONE ? alloc_temp(s) : dst;
+    EMIT(&s->bc, OP_R_POP);
+    EMIT(&s->bc, d);
+    return d;
+  }
+
+  switch (node->type) {
+  case AST_VAR_REF:
+    slot = local_slot(node, s);
+    if (dst == REG_NONE || dst == slot)
+      return slot;
+    EMIT(&s->bc, OP_R_MOVE);
+    EMIT(&s->bc, dst);
+    EMIT(&s->bc, slot);
+    return dst;
+  case AST_INT:
+    d = dst == REG_NONE ? alloc_temp(s) : dst;
+    if (node->integer.val >= 0 && node->integer.val <= 0xFFFF) {
+      EMIT(&s->bc, OP_R_LOADI);
+      EMIT(&s->bc, d);
+      SET_16BITS_INDEX(&s->bc, node->integer.val);
+      return d;
+    }
+    val = sval(SEAL_INT, _int, node->integer.val);
+    goto load_const;
+  case AST_FLOAT:
+    val = sval(SEAL_FLOAT, _float, node->floating.val);
+    goto load_temp_const;
+  case AST_STRING:
+    val = SEAL_VALUE_STRING_INTERNED(node->string.val);
+    goto load_temp_const;
+  case AST_BOOL:
+    val = SEAL_VALUE_BOOL(node->boolean.val);
+    goto load_temp_const;
+  case AST_NULL:
+    val = SEAL_VALUE_NULL;
+load_temp_const:
+    d = dst == REG_NONE ? alloc_temp(s) : dst;
+load_const:
+    EMIT(&s->bc, OP_R_LOADK);
+    EMIT(&s->bc, d);
+    PUSH_CONST(&s->cp, val);
+    SET_16BITS_INDEX(&s->bc, CONST_IDX(&s->cp));
+    return d;
+  case AST_BINARY:
+    left = compile_reg_expr(cout, node->binary.left, s, REG_NONE);
+    right = compile_reg_expr(cout, node->binary.right, s, REG_NONE);
+    s->temp_top = mark;
+    d = dst == REG_NONE ? alloc_temp(s) : dst;
+    EMIT(&s->bc, REG_OP_TYPE(BINARY_OP_TYPE(node->binary.op_type)));
+    EMIT(&s->bc, d);
+    EMIT(&s->bc, left);
+    EMIT(&s->bc, right);
+    return d;
+  case AST_UNARY:
+    if (node->unary.op_type == TOK_PLUS)
+      return compile_reg_expr(cout, node->unary.expr, s, dst);
+    left = compile_reg_expr(cout, node->unary.expr, s, REG_NONE);
+    s->temp_top = mark;
+    d = dst == REG_NONE ? alloc_temp(s) : dst;
+    switch (node->unary.op_type) {
+    case TOK_NOT   : EMIT(&s->bc, OP_R_NOT); break;
+    case TOK_MINUS : EMIT(&s->bc, OP_R_NEG); break;
+    case TOK_TYPEOF: EMIT(&s->bc, OP_R_TYPOF); break;
+    case TOK_BNOT  : EMIT(&s->bc, OP_R_BNOT); break;
+    }
+    EMIT(&s->bc, d);
+    EMIT(&s->bc, left);
+    return d;
+  case AST_BINARY_BOOL:
+    /* a named local may be read by right side, so result goes to a temporary */
+    d = dst == REG_NONE || dst < s->temp_base ? alloc_temp(s) : dst;
+    compile_reg_expr(cout, node->binary.left, s, d);
+    EMIT(&s->bc, node->binary.op_type == TOK_AND ? OP_R_JFALSE : OP_R_JTRUE);
+    EMIT(&s->bc, d);
+    end_addr_offset = CUR_ADDR_OFFSET(&s->bc);
+    EMIT_DUMMY(&s->bc, 4);
+    compile_reg_expr(cout, node->binary.right, s, d);
+    PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
+    REPLACE_LABEL(s->bc.bytecodes + end_addr_offset, LABEL_IDX(&s->lp));
+    goto move_result;
+  case AST_TERNARY:
+    d = dst == REG_NONE || dst < s->temp_base ? alloc_temp(s) : dst;
+    else_addr_offset = compile_reg_cond(cout, node->ternary.cond, s);
+    compile_reg_expr(cout, node->ternary.expr_true, s, d);
+    EMIT(&s->bc, OP_JUMP);
+    end_addr_offset = CUR_ADDR_OFFSET(&s->bc);
+    EMIT_DUMMY(&s->bc, 4);
+    PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
+    REPLACE_LABEL(s->bc.bytecodes + else_addr_offset, LABEL_IDX(&s->lp));
+    compile_reg_expr(cout, node->ternary.expr_false, s, d);
+    PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
+    REPLACE_LABEL(s->bc.bytecodes + end_addr_offset, LABEL_IDX(&s->lp));
+move_result:
+    s->temp_top = d >= s->temp_base ? d + 1 : mark;
+    if (dst == REG_NONE || dst == d)
+      return d;
+    EMIT(&s->bc, OP_R_MOVE);
+    EMIT(&s->bc, dst);
+    EMIT(&s->bc, d);
+    return dst;
+  case AST_ASSIGN:
+    slot = local_slot(node->assign.var, s);
+    if (node->assign.op_type == TOK_ASSIGN) {
+      if (slot == REG_NONE && IS_LITERAL(node->assign.expr)) {
+        /* constant initializer is loaded directly into new local */
+        const char* name = node->assign.var->var_ref.name;
+        struct h_entry* e = hashmap_search(&s->loctable, name);
+        if (e == NULL)
+          __compiler_error("maximum number of locals is %d", LOCAL_MAX);
+        e = hashmap_insert_e(&s->loctable, e, name, SEAL_VALUE_INT((&s->loctable)->filled));
+        slot = e->val.as._int;
+        compile_reg_expr(cout, node->assign.expr, s, slot);
+      } else if (slot == REG_NONE) {
+        /* new local is not visible to its own initializer */
+        const char* name = node->assign.var->var_ref.name;
+        right = compile_reg_expr(cout, node->assign.expr, s, REG_NONE);
+        struct h_entry* e = hashmap_search(&s->loctable, name);
+        if (e == NULL)
+          __compiler_error("maximum number of locals is %d", LOCAL_MAX);
+        e = hashmap_insert_e(&s->loctable, e, name, SEAL_VALUE_INT((&s->loctable)->filled));
+        slot = e->val.as._int;
+        EMIT(&s->bc, OP_R_MOVE);
+        EMIT(&s->bc, slot);
+        EMIT(&s->bc, right);
+      } else {
+        compile_reg_expr(cout, node->assign.expr, s, slot);
+      }
+    } else {
+      right = compile_reg_expr(cout, node->assign.expr, s, REG_NONE);
+      EMIT(&s->bc, REG_OP_TYPE(AUG_ASSIGN_OP_TYPE(node->assign.op_type)));
+      EMIT(&s->bc, slot);
+      EMIT(&s->bc, slot);
+      EMIT(&s->bc, right);
+    }
+    s->temp_top = mark;
+    if (dst == REG_NONE || dst == slot)
+      return slot;
+    EMIT(&s->bc, OP_R_MOVE);
+    EMIT(&s->bc, dst);
+    EMIT(&s->bc, slot);
+    return dst;
+  }
+  return REG_NONE;
+}
+static void compile_reg_push(cout_t* cout, ast_t* node, struct scope *s)
+{
+  int mark = s->temp_top;
+
+  if (is_reg_expr(node, s)) {
+    int r = compile_reg_expr(cout, node, s, REG_NONE);
+    EMIT(&s->bc, OP_R_PUSH);
+    EMIT(&s->bc, r);
+  } else if (node->type == AST_FUNC_CALL && !node->func_call.is_method) {
+    if (node->func_call.arg_size > 255)
+      __compiler_error("maximum number of arguments in a function call is 255");
+
+    compile_node(cout, node->func_call.main, s);
+
+    for (int i = 0; i < node->func_call.arg_size; i++)
+      compile_reg_push(cout, node->func_call.args[i], s);
+
+    EMIT(&s->bc, OP_CALL);
+    EMIT(&s->bc, node->func_call.arg_size);
+  } else {
+    compile_node(cout, node, s);
+  }
+  s->temp_top = mark;
+}
+static size_t compile_reg_cond(cout_t* cout, ast_t* node, struct scope *s)
+{
+  int mark = s->temp_top, op;
+  size_t addr_offset;
+
+  if (!is_reg_expr(node, s)) {
+    compile_reg_push(cout, node, s);
+    EMIT(&s->bc, OP_JFALSE);
+  } else if (node->type == AST_BINARY &&
+             (op = BINARY_OP_TYPE(node->binary.op_type)) >= OP_GT && op <= OP_NE) {
+    int left = compile_reg_expr(cout, node->binary.left, s, REG_NONE);
+    int right = compile_reg_expr(cout, node->binary.right, s, REG_NONE);
+    EMIT(&s->bc, OP_R_JF_GT + (op - OP_GT));
+    EMIT(&s->bc, left);
+    EMIT(&s->bc, right);
+  } else {
+    int r = compile_reg_expr(cout, node, s, REG_NONE);
+    EMIT(&s->bc, OP_R_JFALSE);
+    EMIT(&s->bc, r);
+  }
+  addr_offset = CUR_ADDR_OFFSET(&s->bc);
+  EMIT_DUMMY(&s->bc, 4);
+  s->temp_top = mark;
+  return addr_offset;
+}
+static void compile_reg_if(cout_t* cout, ast_t* node, struct scope *s)
+{
+  int jmp_size = 0;
+  ast_t* temp_node = node;
+  while (temp_node->type == AST_IF && temp_node->_if.has_else) {
+    temp_node = temp_node->_if._else;
+    jmp_size++;
+  }
+  size_t end_addr_offsets[jmp_size ? jmp_size : 1], *end_addr_offset = end_addr_offsets, next_addr_offset;
+
+  next_addr_offset = compile_reg_cond(cout, node->_if.cond, s);
+
+  compile_reg_node(cout, node->_if.comp, s);
+
+  if (jmp_size == 0) {
+    PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
+    REPLACE_LABEL(s->bc.bytecodes + next_addr_offset, LABEL_IDX(&s->lp));
+    return;
+  }
+
+  EMIT(&s->bc, OP_JUMP);
+  *end_addr_offset++ = CUR_ADDR_OFFSET(&s->bc);
+  EMIT_DUMMY(&s->bc, 4);
+
+  PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
+  REPLACE_LABEL(s->bc.bytecodes + next_addr_offset, LABEL_IDX(&s->lp));
+
+  do {
+    node = node->_if._else;
+
+    if (node->type == AST_IF) {
+      next_addr_offset = compile_reg_cond(cout, node->_if.cond, s);
+
+      compile_reg_node(cout, node->_if.comp, s);
+
+      if (end_addr_offset - end_addr_offsets != jmp_size) {
+        if (node->_if.has_else) {
+          EMIT(&s->bc, OP_JUMP);
+          *end_addr_offset++ = CUR_ADDR_OFFSET(&s->bc);
+          EMIT_DUMMY(&s->bc, 4);
+        }
+      }
+
+      PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
+      REPLACE_LABEL(s->bc.bytecodes + next_addr_offset, LABEL_IDX(&s->lp));
+    } else {
+      compile_reg_node(cout, node->_else.comp, s);
+    }
+  } while (node->_if.has_else);
+
+  PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
+
+  for (int i = 0; i < jmp_size; i++) {
+    REPLACE_LABEL(s->bc.bytecodes + end_addr_offsets[i], LABEL_IDX(&s->lp));
+  }
+}
+static void compile_reg_while(cout_t* cout, ast_t* node, struct scope *s)
+{
+  size_t skip_start_size = cout->skip_size;
+  size_t stop_start_size = cout->stop_size;
+
+  PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
+  size_t start = LABEL_IDX(&s->lp);
+  size_t end_addr_offs = compile_reg_cond(cout, node->_while.cond, s);
+
+  compile_reg_node(cout, node->_while.comp, s);
+
+  EMIT(&s->bc, OP_JUMP);
+  SET_LABEL(&s->bc, start);
+  PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
+  REPLACE_LABEL(s->bc.bytecodes + end_addr_offs, LABEL_IDX(&s->lp));
+
+  if (skip_start_size < cout->skip_size) {
+    for (int i = skip_start_size; i < cout->skip_size; i++) {
+      REPLACE_LABEL(s->bc.bytecodes + cout->skip_addr_offset_stack[i], start);
+    }
+  }
+  cout->skip_size = skip_start_size;
+  if (stop_start_size < cout->stop_size) {
+    for (int i = stop_start_size; i < cout->stop_size; i++) {
+      REPLACE_LABEL(s->bc.bytecodes + cout->stop_addr_offset_stack[i], LABEL_IDX(&s->lp));
+    }
+  }
+  cout->stop_size = stop_start_size;
+}
+static void compile_reg_dowhile(cout_t* cout, ast_t* node, struct scope *s)
+{
+  PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
+  size_t start = LABEL_IDX(&s->lp);
+
+  compile_reg_node(cout, node->_while.comp, s);
+
+  int mark = s->temp_top;
+  if (is_reg_expr(node->_while.cond, s)) {
+    int r = compile_reg_expr(cout, node->_while.cond, s, REG_NONE);
+    EMIT(&s->bc, OP_R_JTRUE);
+    EMIT(&s->bc, r);
+  } else {
+    compile_reg_push(cout, node->_while.cond, s);
+    EMIT(&s->bc, OP_JTRUE);
+  }
+  SET_LABEL(&s->bc, start);
+  s->temp_top = mark;
+}
+static void compile_reg_for(cout_t *cout, ast_t *node, struct scope *s)
+{
+  size_t skip_start_size = cout->skip_size;
+  size_t stop_start_size = cout->stop_size;
+
+  compile_reg_push(cout, node->_for.ited, s);
+  EMIT(&s->bc, OP_PUSH_INT);
+  SET_16BITS_INDEX(&s->bc, 1);
+  EMIT(&s->bc, OP_PUSH_INT);
+  SET_16BITS_INDEX(&s->bc, 0);
+
+  const char *it_name = node->_for.it_name;
+  struct h_entry *e = hashmap_search(&s->loctable, it_name);
+  if (e == NULL)
+    __compiler_error("maximum number of locals is %d", LOCAL_MAX);
+  if (e->key == NULL)
+    e = hashmap_insert_e(&s->loctable, e, it_name, SEAL_VALUE_INT((&s->loctable)->filled));
+
+  EMIT(&s->bc, OP_FOR_PREP);
+  size_t end_addr_offs = CUR_ADDR_OFFSET(&s->bc);
+  EMIT_DUMMY(&s->bc, 4);
+
+  PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
+  size_t start_addr = LABEL_IDX(&s->lp);
+  compile_reg_node(cout, node->_for.comp, s);
+
+  PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
+  REPLACE_LABEL(s->bc.bytecodes + end_addr_offs, LABEL_IDX(&s->lp));
+
+  EMIT(&s->bc, OP_FOR_NEXT);
+  EMIT(&s->bc, e->val.as._int); /* push slot index of local table */
+  SET_LABEL(&s->bc, start_addr);
+
+  if (skip_start_size < cout->skip_size) {
+    for (int i = skip_start_size; i < cout->skip_size; i++) {
+      REPLACE_LABEL(s->bc.bytecodes + cout->skip_addr_offset_stack[i], LABEL_IDX(&s->lp));
+    }
+  }
+  cout->skip_size = skip_start_size;
+  if (stop_start_size < cout->stop_size) {
+    PUSH_LABEL(&s->lp, CUR_IDX(&s->bc));
+    for (int i = stop_start_size; i < cout->stop_size; i++) {
+      REPLACE_LABEL(s->bc.bytecodes + cout->stop_addr_offset_stack[i], LABEL_IDX(&s->lp));
+      if (LAST_OPCODE(&s->bc) != OP_FOR_STOP)
+        EMIT(&s->bc, OP_FOR_STOP);
+    }
+  }
+  cout->stop_size = stop_start_size;
+}
+static void compile_reg_return(cout_t* cout, ast_t* node, struct scope *s)
+{
+  compile_reg_push(cout, node->_return.expr, s);
+  MARK_TAIL_CALL(node->_return.expr, s);
+  EMIT(&s->bc, OP_HALT);
+}
+/* checks if 'len' instructions starting from k-th one can be fused */
+static inline bool fusable(size_t *starts, bool *is_target, size_t ins_size, size_t k, size_t len)
+{
+  if (k + len > ins_size)
+    return false;
+  for (size_t i = 1; i < len; i++)
+    if (is_target[starts[k + i]])
+      return false;
+  return true;
+}
+
+/*
+ * replaces hot opcode sequences of a scope with superinstructions
+ * a sequence is fused only if no label points inside of it,
+ * labels and line info are moved to the new offsets
+ */
+static void select_superinstructions(struct scope *s)
+{
+  struct bytechunk *bc = &s->bc;
+  seal_byte *code = bc->bytecodes;
+  size_t size = bc->size;
+
+  size_t *starts = SEAL_CALLOC(size + 1, sizeof(size_t)); /* offsets of instructions */
+  size_t *new_offs = SEAL_CALLOC(size + 1, sizeof(size_t)); /* old offset -> new offset */
+  bool *is_target = SEAL_CALLOC(size + 1, sizeof(bool)); /* offsets pointed by labels */
+  seal_byte *res = SEAL_CALLOC(size + 1, sizeof(seal_byte)); /* fused code never grows */
+  size_t ins_size = 0, res_size = 0;
+
+  for (size_t i = 0; i < size; i += op_size(code[i]))
+    starts[ins_size++] = i;
+  starts[ins_size] = size;
+  for (size_t i = 0; i < s->lp.size; i++)
+    is_target[s->lp.addrs[i]] = true;
+
+#define INS(j)  (code + starts[k + (j)]) /* j-th instruction from current one */
+#define OP(j)   (*INS(j))
+#define FUSE(j) fusable(starts, is_target, ins_size, k, j)
+#define PUT(byte) (res[res_size++] = (seal_byte)(byte))
+
+  for (size_t k = 0; k < ins_size;) {
+    size_t start = res_size, len = 1;
+
+    if (FUSE(5) && OP(0) == OP_GET_LOCAL && OP(1) == OP_PUSH_INT && (OP(2) == OP_ADD || OP(2) == OP_SUB) &&
+        OP(3) == OP_SET_LOCAL && OP(4) == OP_POP && INS(0)[1] == INS(3)[1]) {
+      PUT(OP(2) == OP_ADD ? OP_INC_LOCAL : OP_DEC_LOCAL);
+      PUT(INS(0)[1]);
+      PUT(INS(1)[1]);
+      PUT(INS(1)[2]);
+      len = 5;
+    } else if (FUSE(4) && OP(0) == OP_GET_LOCAL && OP(1) == OP_PUSH_INT && OP(3) == OP_JFALSE &&
+               OP(2) >= OP_GT && OP(2) <= OP_NE) {
+      switch (OP(2)) {
+      case OP_LT: PUT(OP_JFALSE_LT_LI); break;
+      case OP_LE: PUT(OP_JFALSE_LE_LI); break;
+      case OP_GT: PUT(OP_JFALSE_GT_LI); break;
+      case OP_GE: PUT(OP_JFALSE_GE_LI); break;
+      case OP_EQ: PUT(OP_JFALSE_EQ_LI); break;
+      case OP_NE: PUT(OP_JFALSE_NE_LI); break;
+      }
+      PUT(INS(0)[1]);
+      PUT(INS(1)[1]);
+      PUT(INS(1)[2]);
+      for (int i = 1; i <= 4; i++) /* label */
+        PUT(INS(3)[i]);
+      len = 4;
+    } else if (FUSE(3) && OP(0) == OP_GET_LOCAL && OP(1) == OP_GET_LOCAL && OP(2) == OP_ADD) {
+      PUT(OP_ADD_LL);
+      PUT(INS(0)[1]);
+      PUT(INS(1)[1]);
+      len = 3;
+    } else if (FUSE(3) && OP(0) == OP_DUP && (OP(1) == OP_JFALSE || OP(1) == OP_JTRUE) && OP(2) == OP_POP) {
+      PUT(OP(1) == OP_JFALSE ? OP_JFALSE_OR_POP : OP_JTRUE_OR_POP);
+      for (int i = 1; i <= 4; i++) /* label */
+        PUT(INS(1)[i]);
+      len = 3;
+    } else {
+      for (int i = 0; i < op_size(OP(0)); i++)
+        PUT(INS(0)[i]);
+    }
+
+    for (size_t i = starts[k]; i < starts[k + len]; i++)
+      new_offs[i] = start;
+    k += len;
+  }
+  new_offs[size] = res_size;
+
+#undef INS
+#undef OP
+#undef FUSE
+#undef PUT
+
+  for (size_t i = 0; i < s->lp.size; i++)
+    s->lp.addrs[i] = new_offs[s->lp.addrs[i]];
+  for (int i = 0; i < bc->l_size; i++)
+    bc->linfo[i].offset = new_offs[bc->linfo[i].offset];
+
+  SEAL_FREE(bc->bytecodes);
+  bc->bytecodes = res;
+  bc->size = res_size;
+  bc->cap = size + 1;
+
+  SEAL_FREE(starts);
+  SEAL_FREE(new_offs);
+  SEAL_FREE(is_target);
+}
+
+/*
+ * removes redundant instructions of a scope after superinstructions are selected:
+ * jumps to unconditional jumps are threaded to final target, code after 'OP_HALT'
+ * or 'OP_JUMP' that no label points to is dropped, jumps to next instruction are
+ * dropped and store followed by pop and load of same variable keeps only store
+ */
+static void peephole(struct scope *s)
+{
+  struct bytechunk *bc = &s->bc;
+  seal_byte *code = bc->bytecodes;
+  size_t size = bc->size;
+
+  /* chains are bounded by number of labels, jump to itself stays */
+  for (size_t i = 0; i < s->lp.size; i++) {
+    size_t addr = s->lp.addrs[i];
+    for (size_t n = 0; n < s->lp.size && addr < size && code[addr] == OP_JUMP; n++)
+      addr = s->lp.addrs[GET_LABEL(code + addr + 1)];
+    s->lp.addrs[i] = addr;
+  }
+
+  size_t *starts = SEAL_CALLOC(size + 1, sizeof(size_t)); /* offsets of instructions */
+  size_t *new_offs = SEAL_CALLOC(size + 1, sizeof(size_t)); /* old offset -> new offset */
+  bool *is_target = SEAL_CALLOC(size + 1, sizeof(bool)); /* offsets pointed by labels */
+  seal_byte *res = SEAL_CALLOC(size + 1, sizeof(seal_byte)); /* code only shrinks */
+  size_t ins_size = 0, res_size = 0;
+  bool reachable = true;
+
+  for (size_t i = 0; i < size; i += op_size(code[i]))
+    starts[ins_size++] = i;
+  starts[ins_size] = size;
+  for (size_t i = 0; i < s->lp.size; i++)
+    is_target[s->lp.addrs[i]] = true;
+
+#define INS(j)  (code + starts[k + (j)]) /* j-th instruction from current one */
+#define OP(j)   (*INS(j))
+#define FUSE(j) fusable(starts, is_target, ins_size, k, j)
+
+  for (size_t k = 0; k < ins_size;) {
+    size_t start = res_size, len = 1, keep = 0;
+
+    if (is_target[starts[k]])
+      reachable = true;
+
+    if (!reachable) {
+      /* dropped */
+    } else if (OP(0) == OP_JUMP && s->lp.addrs[GET_LABEL(INS(0) + 1)] == starts[k + 1]) {
+      /* dropped */
+    } else if (FUSE(3) && OP(0) == OP_SET_LOCAL && OP(1) == OP_POP && OP(2) == OP_GET_LOCAL &&
+               INS(0)[1] == INS(2)[1]) {
+      keep = op_size(OP_SET_LOCAL);
+      len = 3;
+    } else if (FUSE(3) && OP(0) == OP_SET_GLOBAL && OP(1) == OP_POP && OP(2) == OP_GET_GLOBAL &&
+               INS(0)[1] == INS(2)[1] && INS(0)[2] == INS(2)[2]) {
+      keep = op_size(OP_SET_GLOBAL);
+      len = 3;
+    } else {
+      keep = op_size(OP(0));
+      if (OP(0) == OP_HALT || OP(0) == OP_JUMP)
+        reachable = false;
+    }
+    memcpy(res + res_size, INS(0), keep);
+    res_size += keep;
+
+    for (size_t i = starts[k]; i < starts[k + len]; i++)
+      new_offs[i] = start;
+    k += len;
+  }
+  new_offs[size] = res_size;
+
+#undef INS
+#undef OP
+#undef FUSE
+
+  for (size_t i = 0; i < s->lp.size; i++)
+    s->lp.addrs[i] = new_offs[s->lp.addrs[i]];
+  for (int i = 0; i < bc->l_size; i++)
+    bc->linfo[i].offset = new_offs[bc->linfo[i].offset];
+
+  SEAL_FREE(bc->bytecodes);
+  bc->bytecodes = res;
+  bc->size = res_size;
+  bc->cap = size + 1;
+
+  SEAL_FREE(starts);
+  SEAL_FREE(new_offs);
+  SEAL_FREE(is_target);
+}
+
+/*
+ * replaces label indices of jumps with offsets relative to the end of jump,
+ * every jump starts short (8-bit offset) and is made long (32-bit offset)
+ * while its target is out of range, until sizes do not change
+ */
+static void relax_jumps(struct scope *s)
+{
+  struct bytechunk *bc = &s->bc;
+  seal_byte *code = bc->bytecodes;
+  size_t size = bc->size;
+
+  size_t *starts = SEAL_CALLOC(size + 1, sizeof(size_t)); /* offsets of instructions */
+  size_t *new_offs = SEAL_CALLOC(size + 1, sizeof(size_t)); /* old offset -> new offset */
+  size_t *targets = SEAL_CALLOC(size + 1, sizeof(size_t)); /* old target offset of each jump */
+  bool *is_long = SEAL_CALLOC(size + 1, sizeof(bool));
+  size_t ins_size = 0, res_size;
+  bool changed;
+
+  for (size_t i = 0; i < size; i += op_size(code[i])) {
+    if (IS_JUMP_OP(code[i])) {
+      targets[ins_size] = s->lp.addrs[GET_LABEL(code + i + op_size(code[i]) - 4)];
+    }
+    starts[ins_size++] = i;
+  }
+  starts[ins_size] = size;
+
+#define NEW_SIZE(k) (op_size(code[starts[k]]) - (IS_JUMP_OP(code[starts[k]]) && !is_long[k] ? 3 : 0))
+
+  do {
+    res_size = 0;
+    for (size_t k = 0; k < ins_size; k++) {
+      for (size_t i = starts[k]; i < starts[k + 1]; i++)
+        new_offs[i] = res_size;
+      res_size += NEW_SIZE(k);
+    }
+    new_offs[size] = res_size;
+
+    changed = false;
+    for (size_t k = 0; k < ins_size; k++) {
+      if (!IS_JUMP_OP(code[starts[k]]) || is_long[k])
+        continue;
+      long offs = (long)new_offs[targets[k]] - (long)(new_offs[starts[k]] + NEW_SIZE(k));
+      if (offs < INT8_MIN || offs > INT8_MAX) {
+        is_long[k] = true;
+        changed = true;
+      }
+    }
+  } while (changed);
+
+  seal_byte *res = SEAL_CALLOC(res_size + 1, sizeof(seal_byte));
+  for (size_t k = 0; k < ins_size; k++) {
+    seal_byte *ins = code + starts[k], *out = res + new_offs[starts[k]];
+    int len = op_size(*ins);
+    if (!IS_JUMP_OP(*ins)) {
+      memcpy(out, ins, len);
+      continue;
+    }
+    int32_t offs = (int32_t)(new_offs[targets[k]] - (new_offs[starts[k]] + NEW_SIZE(k)));
+    memcpy(out, ins, len - 4); /* opcode and operands before label */
+    if (is_long[k]) {
+      out[len - 4] = (seal_byte)((uint32_t)offs >> 24);
+      out[len - 3] = (seal_byte)((uint32_t)offs >> 16);
+      out[len - 2] = (seal_byte)((uint32_t)offs >> 8);
+      out[len - 1] = (seal_byte)offs;
+    } else {
+      out[0] = SHORT_JUMP_OP(*ins);
+      out[len - 4] = (seal_byte)(int8_t)offs;
+    }
+  }
+
+#undef NEW_SIZE
+
+  for (int i = 0; i < bc->l_size; i++)
+    bc->linfo[i].offset = new_offs[bc->linfo[i].offset];
+
+  SEAL_FREE(bc->bytecodes);
+  bc->bytecodes = res;
+  bc->size = res_size;
+  bc->cap = res_size + 1;
+
+  SEAL_FREE(s->lp.addrs); /* labels are not needed anymore */
+  s->lp.addrs = NULL;
+  s->lp.size = s->lp.cap = 0;
+
+  SEAL_FREE(starts);
+  SEAL_FREE(new_offs);
+  SEAL_FREE(targets);
+  SEAL_FREE(is_long);
 }
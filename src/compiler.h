@@ -10,9 +10,12 @@
 typedef struct cout cout_t;
 
 #define CONST_POOL_SIZE (0xFFFF + 1)    /* 65536 */
-#define LABEL_SIZE      (0xFFFF + 1)    /* 65536 */
 #define UNCOND_JMP_MAX_SIZE 1024
 
+/* compiler backends */
+#define BACKEND_STACK    0 /* operands live on value stack */
+#define BACKEND_REGISTER 1 /* operands live in local slots */
+
 #define PRINT_CONST_POOL(cout) for (int i = 0; i < cout.const_pool_size; i++) { \
     if (i == 0) printf("CONST POOL START-------\n"); \
     svalue_t s = cout.const_pool[i]; \
@@ -33,7 +36,7 @@ typedef struct cout cout_t;
         printf("null\n"); \
         break; \
       case SEAL_FUNC: \
-        printf("\'%s\' function\n", s.as.func.name); \
+        printf("\'%s\' function\n", AS_FUNC(s).name); \
         break; \
       default: \
         printf("UNRECOGNIZED DATA TYPE TO PRINT\n"); \
@@ -58,8 +61,8 @@ struct const_pool {
   size_t cap;
 };
 
-struct label_pool {
-  seal_word *addrs;
+struct label_pool { /* used only while compiling, jumps are relative in output */
+  size_t *addrs;
   size_t size;
   size_t cap;
 };
@@ -69,14 +72,21 @@ struct scope {
   struct const_pool cp;
   struct label_pool lp;
   hashmap_t loctable;
+
+  /* registers of register backend, temporaries are placed after named locals */
+  int temp_base; /* first temporary slot */
+  int temp_top;  /* first free temporary slot */
+  int temp_end;  /* highest used slot + 1 */
+
+  int cache_size; /* field access sites, each has its own inline cache */
 };
 
 struct cout {
   struct bytechunk bc;     
   svalue_t*  const_pool; /* pool for constant values */
   size_t const_pool_size;
-  seal_word* labels; /* array of labels to store */
-  size_t label_pool_size;
+  struct field_cache *caches; /* inline caches of main chunk */
+  size_t cache_size;
   size_t* skip_addr_offset_stack; /* stack for skip statements */
   size_t* stop_addr_offset_stack; /* stack for stop statements */
   size_t skip_size; /* skip statements size */
@@ -84,9 +94,25 @@ struct cout {
   seal_byte main_scope_local_size;
   struct scope main_scope;
   const char *file_name;
+  hashmap_t symtab; /* global name -> slot index, filled is number of slots */
+  bool is_lazy; /* function bodies are compiled on first call, symtab grows meanwhile */
+};
+
+/* function whose body is not compiled yet, cout and ast of its file are kept */
+struct lazy_def {
+  ast_t *node;
+  cout_t *cout;
 };
 
 void compile(cout_t*, ast_t*, const char*); /* init cout and compile root node into bytecode */
+void compiler_set_backend(int); /* select backend for following compilations */
+int compiler_backend(void);
+void compiler_set_opt_level(int); /* 0 disables constant folding and peephole pass */
+int compiler_opt_level(void);
+void compiler_set_lazy(bool); /* compile function bodies on first call */
+void compile_lazy(struct seal_func*); /* compiles body of function defined in lazy mode */
+static void compile_scope(cout_t*, ast_t*, struct scope*); /* compile body of scope with selected backend */
+static seal_word global_slot(cout_t*, const char*); /* returns slot of global, adds new one if needed */
 static void compile_node(cout_t*, ast_t*, struct scope*); /* compile any node into bytecode */
 static void compile_if(cout_t*, ast_t*, struct scope*);
 static void compile_while(cout_t*, ast_t*, struct scope*);
@@ -102,6 +128,7 @@ static void compile_func_call(cout_t*, ast_t*, struct scope*);
 static void compile_assign(cout_t*, ast_t*, struct scope*);
 static void compile_var_ref(cout_t*, ast_t*, struct scope*);
 static void compile_func_def(cout_t*, ast_t*, struct scope*);
+static void compile_func_body(cout_t*, ast_t*, struct seal_func*);
 static void compile_return(cout_t*, ast_t*, struct scope*);
 static void compile_list(cout_t*, ast_t*, struct scope*);
 static void compile_subscript(cout_t*, ast_t*, struct scope*);
@@ -109,5 +136,23 @@ static void compile_map(cout_t*, ast_t*, struct scope*);
 static void compile_memacc(cout_t*, ast_t*, struct scope*);
 static void compile_include(cout_t*, ast_t*, struct scope*);
 static void compile_ternary(cout_t*, ast_t*, struct scope*);
+static void select_superinstructions(struct scope*); /* fuse hot opcode sequences of scope */
+static void peephole(struct scope*); /* drop redundant instructions of scope */
+static void relax_jumps(struct scope*); /* replace jump labels with relative offsets */
+
+/* register backend */
+static void count_locals(ast_t*, hashmap_t*); /* collect names that will be local in scope */
+static int  alloc_temp(struct scope*);
+static void clear_temps(ast_t*, struct scope*, size_t); /* nulls temporaries written since offset */
+static bool is_reg_expr(ast_t*, struct scope*); /* checks if expression can be compiled into registers */
+static void compile_reg_node(cout_t*, ast_t*, struct scope*);
+static int  compile_reg_expr(cout_t*, ast_t*, struct scope*, int); /* returns register holding result */
+static void compile_reg_push(cout_t*, ast_t*, struct scope*); /* pushes result to stack */
+static size_t compile_reg_cond(cout_t*, ast_t*, struct scope*); /* returns offset of jump label */
+static void compile_reg_if(cout_t*, ast_t*, struct scope*);
+static void compile_reg_while(cout_t*, ast_t*, struct scope*);
+static void compile_reg_dowhile(cout_t*, ast_t*, struct scope*);
+static void compile_reg_for(cout_t*, ast_t*, struct scope*);
+static void compile_reg_return(cout_t*, ast_t*, struct scope*);
 
 #endif /* SEAL_COMPILER_H */
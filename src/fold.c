@@ -0,0 +1,340 @@
+#include "fold.h"
+#include "arena.h"
+
+#define LIT_IS_NUM(node) ((node)->type == AST_INT || (node)->type == AST_FLOAT)
+#define LIT_AS_NUM(node) ((node)->type == AST_INT ? (seal_float)(node)->integer.val : (node)->floating.val)
+
+/* truth of literal, same as TO_BOOL of vm */
+#define LIT_TO_BOOL(node) ( \
+  (node)->type == AST_INT ? (node)->integer.val != 0 : \
+  (node)->type == AST_FLOAT ? (node)->floating.val != 0.0 : \
+  (node)->type == AST_STRING ? (node)->string.val[0] != '\0' : \
+  (node)->type == AST_BOOL ? (node)->boolean.val : \
+  false \
+)
+
+/* operator node becomes literal in place, its operands are read before */
+#define FOLD_INT(node, v)   ((node)->type = AST_INT, (node)->integer.val = (v), (node))
+#define FOLD_FLOAT(node, v) ((node)->type = AST_FLOAT, (node)->floating.val = (v), (node))
+#define FOLD_BOOL(node, v)  ((node)->type = AST_BOOL, (node)->boolean.val = (v), (node))
+
+/* integers wrap as they do in vm, without undefined overflow at compile time */
+#define WRAP(a, op, b) ((seal_int)((uint64_t)(a) op (uint64_t)(b)))
+
+#define CMP_CASES(node, a, b) \
+  case TOK_EQ: return FOLD_BOOL(node, (a) == (b)); \
+  case TOK_NE: return FOLD_BOOL(node, (a) != (b)); \
+  case TOK_GT: return FOLD_BOOL(node, (a) >  (b)); \
+  case TOK_GE: return FOLD_BOOL(node, (a) >= (b)); \
+  case TOK_LT: return FOLD_BOOL(node, (a) <  (b)); \
+  case TOK_LE: return FOLD_BOOL(node, (a) <= (b));
+
+void fold_constants(ast_t *root)
+{
+  fold_scope(root, NULL, 0);
+}
+
+static ast_t *fold_scope(ast_t *body, const char **params, size_t param_size)
+{
+  struct hashmap_static def_storage, const_storage;
+  struct fold_scope fs = { .val_size = 0, .is_full = false };
+  hashmap_init_static(&fs.defs, &def_storage);
+  hashmap_init_static(&fs.consts, &const_storage);
+
+  for (size_t i = 0; i < param_size && !fs.is_full; i++) {
+    if (fs.defs.filled >= fs.defs.cap)
+      fs.is_full = true;
+    else
+      hashmap_insert(&fs.defs, params[i], SEAL_VALUE_INT(1));
+  }
+  count_defs(body, &fs);
+  if (body->type != AST_COMP) /* body of inline function is its return statement */
+    return fold_node(body, &fs);
+
+  /* statement defines constant for statements after it, never for ones before */
+  for (size_t i = 0; i < body->comp.stmt_size; i++) {
+    ast_t *stmt = body->comp.stmts[i] = fold_node(body->comp.stmts[i], &fs);
+    if (fs.is_full || stmt->type != AST_ASSIGN || stmt->assign.op_type != TOK_ASSIGN ||
+        stmt->assign.var->type != AST_VAR_REF || stmt->assign.var->var_ref.is_global ||
+        !IS_LITERAL(stmt->assign.expr))
+      continue;
+    const char *name = stmt->assign.var->var_ref.name;
+    if (hashmap_search(&fs.defs, name)->val.as._int != 1)
+      continue;
+    fs.vals[fs.val_size] = stmt->assign.expr;
+    hashmap_insert(&fs.consts, name, SEAL_VALUE_INT(fs.val_size++));
+  }
+  return body;
+}
+
+/* counts assignments and loop variables of scope, nested functions have their own scope */
+static void count_defs(ast_t *node, struct fold_scope *fs)
+{
+  const char *name = NULL;
+
+  if (node == NULL)
+    return;
+  switch (node->type) {
+  case AST_COMP:
+    for (size_t i = 0; i < node->comp.stmt_size; i++)
+      count_defs(node->comp.stmts[i], fs);
+    break;
+  case AST_IF:
+    count_defs(node->_if.cond, fs);
+    count_defs(node->_if.comp, fs);
+    if (node->_if.has_else)
+      count_defs(node->_if._else, fs);
+    break;
+  case AST_ELSE:
+    count_defs(node->_else.comp, fs);
+    break;
+  case AST_WHILE: case AST_DOWHILE:
+    count_defs(node->_while.cond, fs);
+    count_defs(node->_while.comp, fs);
+    break;
+  case AST_FOR:
+    name = node->_for.it_name;
+    count_defs(node->_for.ited, fs);
+    count_defs(node->_for.comp, fs);
+    break;
+  case AST_ASSIGN:
+    if (node->assign.var->type == AST_VAR_REF && !node->assign.var->var_ref.is_global)
+      name = node->assign.var->var_ref.name;
+    count_defs(node->assign.var, fs);
+    count_defs(node->assign.expr, fs);
+    break;
+  case AST_UNARY:
+    count_defs(node->unary.expr, fs);
+    break;
+  case AST_BINARY: case AST_BINARY_BOOL:
+    count_defs(node->binary.left, fs);
+    count_defs(node->binary.right, fs);
+    break;
+  case AST_TERNARY:
+    count_defs(node->ternary.cond, fs);
+    count_defs(node->ternary.expr_true, fs);
+    count_defs(node->ternary.expr_false, fs);
+    break;
+  case AST_FUNC_CALL:
+    count_defs(node->func_call.main, fs);
+    for (size_t i = 0; i < node->func_call.arg_size; i++)
+      count_defs(node->func_call.args[i], fs);
+    break;
+  case AST_SUBSCRIPT:
+    count_defs(node->subscript.main, fs);
+    count_defs(node->subscript.index, fs);
+    break;
+  case AST_MEMACC:
+    count_defs(node->memacc.main, fs);
+    break;
+  case AST_LIST:
+    for (size_t i = 0; i < node->list.mem_size; i++)
+      count_defs(node->list.mems[i], fs);
+    break;
+  case AST_MAP:
+    for (size_t i = 0; i < node->map.field_size; i++)
+      count_defs(node->map.field_vals[i], fs);
+    break;
+  case AST_RETURN:
+    count_defs(node->_return.expr, fs);
+    break;
+  default:
+    break;
+  }
+  if (name == NULL || fs->is_full)
+    return;
+  struct h_entry *e = hashmap_search(&fs->defs, name);
+  if (e == NULL)
+    fs->is_full = true; /* compiler reports too many locals */
+  else if (e->key == NULL)
+    hashmap_insert_e(&fs->defs, e, name, SEAL_VALUE_INT(1));
+  else
+    e->val.as._int++;
+}
+
+static ast_t *fold_node(ast_t *node, struct fold_scope *fs)
+{
+  struct h_entry *e;
+
+  switch (node->type) {
+  case AST_COMP:
+    for (size_t i = 0; i < node->comp.stmt_size; i++)
+      node->comp.stmts[i] = fold_node(node->comp.stmts[i], fs);
+    break;
+  case AST_IF:
+    node->_if.cond = fold_node(node->_if.cond, fs);
+    node->_if.comp = fold_node(node->_if.comp, fs);
+    if (node->_if.has_else)
+      node->_if._else = fold_node(node->_if._else, fs);
+    break;
+  case AST_ELSE:
+    node->_else.comp = fold_node(node->_else.comp, fs);
+    break;
+  case AST_WHILE: case AST_DOWHILE:
+    node->_while.cond = fold_node(node->_while.cond, fs);
+    node->_while.comp = fold_node(node->_while.comp, fs);
+    break;
+  case AST_FOR:
+    node->_for.ited = fold_node(node->_for.ited, fs);
+    node->_for.comp = fold_node(node->_for.comp, fs);
+    break;
+  case AST_FUNC_DEF:
+    node->func_def.comp = fold_scope(node->func_def.comp, node->func_def.param_names, node->func_def.param_size);
+    break;
+  case AST_RETURN:
+    node->_return.expr = fold_node(node->_return.expr, fs);
+    break;
+  case AST_ASSIGN:
+    if (node->assign.var->type != AST_VAR_REF) /* target itself is never replaced */
+      node->assign.var = fold_node(node->assign.var, fs);
+    node->assign.expr = fold_node(node->assign.expr, fs);
+    break;
+  case AST_VAR_REF:
+    if (node->var_ref.is_global || fs->is_full)
+      break;
+    e = hashmap_search(&fs->consts, node->var_ref.name);
+    if (e != NULL && e->key != NULL) {
+      ast_t *lit = static_create_ast(AST_NOP, node->line);
+      *lit = *fs->vals[e->val.as._int];
+      lit->line = node->line;
+      return lit;
+    }
+    break;
+  case AST_UNARY:
+    node->unary.expr = fold_node(node->unary.expr, fs);
+    return fold_unary(node);
+  case AST_BINARY:
+    node->binary.left = fold_node(node->binary.left, fs);
+    node->binary.right = fold_node(node->binary.right, fs);
+    return fold_binary(node);
+  case AST_BINARY_BOOL:
+    node->binary.left = fold_node(node->binary.left, fs);
+    node->binary.right = fold_node(node->binary.right, fs);
+    if (!IS_LITERAL(node->binary.left))
+      break;
+    /* 'and' gives falsy left side, 'or' truthy one, otherwise right side */
+    if (LIT_TO_BOOL(node->binary.left) == (node->binary.op_type == TOK_OR))
+      return node->binary.left;
+    return node->binary.right;
+  case AST_TERNARY:
+    node->ternary.cond = fold_node(node->ternary.cond, fs);
+    node->ternary.expr_true = fold_node(node->ternary.expr_true, fs);
+    node->ternary.expr_false = fold_node(node->ternary.expr_false, fs);
+    if (IS_LITERAL(node->ternary.cond))
+      return LIT_TO_BOOL(node->ternary.cond) ? node->ternary.expr_true : node->ternary.expr_false;
+    break;
+  case AST_FUNC_CALL:
+    node->func_call.main = fold_node(node->func_call.main, fs);
+    for (size_t i = 0; i < node->func_call.arg_size; i++)
+      node->func_call.args[i] = fold_node(node->func_call.args[i], fs);
+    break;
+  case AST_SUBSCRIPT:
+    node->subscript.main = fold_node(node->subscript.main, fs);
+    node->subscript.index = fold_node(node->subscript.index, fs);
+    break;
+  case AST_MEMACC:
+    node->memacc.main = fold_node(node->memacc.main, fs); /* member is a name, not a variable */
+    break;
+  case AST_LIST:
+    for (size_t i = 0; i < node->list.mem_size; i++)
+      node->list.mems[i] = fold_node(node->list.mems[i], fs);
+    break;
+  case AST_MAP:
+    for (size_t i = 0; i < node->map.field_size; i++)
+      node->map.field_vals[i] = fold_node(node->map.field_vals[i], fs);
+    break;
+  default:
+    break;
+  }
+  return node;
+}
+
+static ast_t *fold_unary(ast_t *node)
+{
+  ast_t *expr = node->unary.expr;
+  if (!IS_LITERAL(expr))
+    return node;
+
+  switch (node->unary.op_type) {
+  case TOK_PLUS: /* compiled into nothing */
+    return expr;
+  case TOK_NOT:
+    return FOLD_BOOL(node, !LIT_TO_BOOL(expr));
+  case TOK_MINUS:
+    if (expr->type == AST_INT)
+      return FOLD_INT(node, WRAP(0, -, expr->integer.val));
+    if (expr->type == AST_FLOAT)
+      return FOLD_FLOAT(node, -expr->floating.val);
+    break;
+  case TOK_BNOT:
+    if (expr->type == AST_INT)
+      return FOLD_INT(node, ~expr->integer.val);
+    break;
+  }
+  return node;
+}
+
+static ast_t *fold_binary(ast_t *node)
+{
+  ast_t *left = node->binary.left, *right = node->binary.right;
+  if (!IS_LITERAL(left) || !IS_LITERAL(right))
+    return node;
+
+  if (left->type == AST_INT && right->type == AST_INT) {
+    seal_int a = left->integer.val, b = right->integer.val;
+    bool traps = b == 0 || (a == INT64_MIN && b == -1); /* left for vm to fail */
+    switch (node->binary.op_type) {
+    case TOK_PLUS:  return FOLD_INT(node, WRAP(a, +, b));
+    case TOK_MINUS: return FOLD_INT(node, WRAP(a, -, b));
+    case TOK_MUL:   return FOLD_INT(node, WRAP(a, *, b));
+    case TOK_DIV:   return traps ? node : FOLD_INT(node, a / b);
+    case TOK_MOD:   return traps ? node : FOLD_INT(node, a % b);
+    case TOK_BAND:  return FOLD_INT(node, a & b);
+    case TOK_BOR:   return FOLD_INT(node, a | b);
+    case TOK_XOR:   return FOLD_INT(node, a ^ b);
+    case TOK_SHL:   return b < 0 || b > 63 ? node : FOLD_INT(node, WRAP(a, <<, b));
+    case TOK_SHR:   return b < 0 || b > 63 ? node : FOLD_INT(node, a >> b);
+    CMP_CASES(node, a, b)
+    }
+    return node;
+  }
+  if (LIT_IS_NUM(left) && LIT_IS_NUM(right)) {
+    seal_float a = LIT_AS_NUM(left), b = LIT_AS_NUM(right);
+    switch (node->binary.op_type) {
+    case TOK_PLUS:  return FOLD_FLOAT(node, a + b);
+    case TOK_MINUS: return FOLD_FLOAT(node, a - b);
+    case TOK_MUL:   return FOLD_FLOAT(node, a * b);
+    case TOK_DIV:   return b == 0.0 ? node : FOLD_FLOAT(node, a / b);
+    CMP_CASES(node, a, b)
+    }
+    return node;
+  }
+  if (left->type == AST_STRING && right->type == AST_STRING) {
+    const char *a = left->string.val, *b = right->string.val;
+    switch (node->binary.op_type) {
+    case TOK_PLUS: {
+      size_t alen = strlen(a), blen = strlen(b);
+      char *res = SEAL_MALLOC(alen + blen + 1); /* constant outlives ast */
+      memcpy(res, a, alen);
+      memcpy(res + alen, b, blen + 1);
+      node->type = AST_STRING;
+      node->string.val = res;
+      return node;
+    }
+    case TOK_EQ: return FOLD_BOOL(node, strcmp(a, b) == 0);
+    case TOK_NE: return FOLD_BOOL(node, strcmp(a, b) != 0);
+    case TOK_IN: return FOLD_BOOL(node, strstr(b, a) != NULL);
+    }
+    return node;
+  }
+  if ((left->type == AST_BOOL && right->type == AST_BOOL) ||
+      left->type == AST_NULL || right->type == AST_NULL) {
+    /* null is only equal to null, bools compare by value */
+    bool eq = left->type == right->type && (left->type == AST_NULL || left->boolean.val == right->boolean.val);
+    if (node->binary.op_type == TOK_EQ)
+      return FOLD_BOOL(node, eq);
+    if (node->binary.op_type == TOK_NE)
+      return FOLD_BOOL(node, !eq);
+  }
+  return node;
+}
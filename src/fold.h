@@ -0,0 +1,31 @@
+#ifndef SEAL_FOLD_H
+#define SEAL_FOLD_H
+
+#include "sealconf.h"
+#include "ast.h"
+#include "hashmap.h"
+
+/*
+ * constant folding and propagation over ast, runs between parsing and
+ * compilation. operators on literals are evaluated with semantics of vm,
+ * operations that fail at runtime (division by zero, unsupported operand
+ * types) are left to vm so that error is reported only if they run.
+ * local that is assigned a literal once, by a statement of scope itself,
+ * is replaced with that literal in following statements
+ */
+struct fold_scope {
+  hashmap_t defs;   /* local name -> number of its definitions in scope */
+  hashmap_t consts; /* local name -> index of its literal in vals */
+  ast_t *vals[LOCAL_MAX];
+  size_t val_size;
+  bool is_full; /* too many names to track, nothing is propagated */
+};
+
+void fold_constants(ast_t*); /* fold root node of file in place */
+static ast_t* fold_scope(ast_t* body, const char** params, size_t param_size); /* returns folded body */
+static void count_defs(ast_t*, struct fold_scope*);
+static ast_t* fold_node(ast_t*, struct fold_scope*); /* returns node that replaces given one */
+static ast_t* fold_unary(ast_t*);
+static ast_t* fold_binary(ast_t*);
+
+#endif /* SEAL_FOLD_H */
@@ -1,74 +1,308 @@
 #include "gc.h"
+#include "shape.h"
 
-#define IS_ALLOCATED(s) (IS_LIST(s) || IS_MAP(s) || (IS_STRING(s) && !s.as.string->is_static))
+size_t gc_zct_size, gc_zct_limit = 1;
+size_t gc_zct_cap;
+svalue_t *gc_zct;
+size_t gc_allocated, gc_freed;
 
-inline void gc_decref(svalue_t s)
+/* possible roots of garbage cycles, work stack of traversals and white objects to free */
+struct gc_buf {
+  svalue_t *vals;
+  size_t size;
+  size_t cap;
+};
+
+static struct gc_buf gc_roots, gc_work, gc_white;
+
+static void gc_buf_push(struct gc_buf *b, svalue_t s)
+{
+  if (b->size >= b->cap)
+    b->vals = SEAL_REALLOC(b->vals, sizeof(svalue_t) * (b->cap = b->cap ? b->cap * 2 : 64));
+  b->vals[b->size++] = s;
+}
+
+#define GC_SET_COLOR(s, c) ((s).as.gc->flags = ((s).as.gc->flags & ~GC_COLOR) | (c))
+#define GC_GET_COLOR(s)    ((s).as.gc->flags & GC_COLOR)
+
+/* calls f on every container held by s */
+#define GC_EACH_CHILD(s, f) do { \
+  if (VAL_TYPE(s) == SEAL_LIST) { \
+    for (size_t _i = 0; _i < (s).as.list->size; _i++) \
+      if (GC_CONTAINER((s).as.list->mems[_i])) \
+        f((s).as.list->mems[_i]); \
+  } else { \
+    struct seal_map *_m = (s).as.map; \
+    for (size_t _i = 0; _i < map_end(_m); _i++) { \
+      svalue_t *_v = map_at(_m, _i, NULL); \
+      if (_v != NULL && GC_CONTAINER(*_v)) \
+        f(*_v); \
+    } \
+  } \
+} while (0)
+
+size_t gc_size(svalue_t s)
 {
-  if (!IS_ALLOCATED(s))
-    return;
-  //printf("DEC REF COUNT OF \'%s\': %d\n", AS_STRING(s), s.as.string->ref_count);
   switch (VAL_TYPE(s)) {
   case SEAL_STRING:
-    if (--s.as.string->ref_count <= 0) {
-      //printf("FREEING %s\n", AS_STRING(s));
+    return sizeof(struct seal_string) + s.as.string->size + 1;
+  case SEAL_LIST:
+    return sizeof(struct seal_list) + s.as.list->cap * sizeof(svalue_t);
+  case SEAL_MAP:
+    return map_bytes(s.as.map);
+  case SEAL_FUNC:
+    return sizeof(struct seal_func);
+  }
+  return 0;
+}
+
+static size_t gc_header_size(svalue_t s)
+{
+  return VAL_TYPE(s) == SEAL_LIST ? sizeof(struct seal_list) : sizeof(struct seal_map);
+}
+
+/* releases header of container, buffered one is released by cycle collector */
+static void gc_free_header(svalue_t s)
+{
+  if (s.as.gc->flags & GC_BUFFERED)
+    s.as.gc->flags |= GC_DEAD;
+  else
+    SEAL_POOL_FREE(s.as.gc, gc_header_size(s));
+}
+
+/* members and entries of container, header is left */
+static void gc_free_body(svalue_t s)
+{
+  if (VAL_TYPE(s) == SEAL_LIST) {
+    SEAL_POOL_FREE(s.as.list->mems, s.as.list->cap * sizeof(svalue_t));
+    s.as.list->size = s.as.list->cap = 0;
+  } else {
+    map_free_body(s.as.map);
+  }
+}
+
+void gc_free(svalue_t s)
+{
+  switch (VAL_TYPE(s)) {
+  case SEAL_STRING:
+    if (s.as.string->is_static)
+      return;
+    gc_freed += gc_size(s);
+    if (s.as.string->is_pooled) {
+      SEAL_POOL_FREE((char*)(s.as.string->val), s.as.string->size + 1);
+      SEAL_POOL_FREE(s.as.string, sizeof(struct seal_string));
+    } else {
       free((char*)(s.as.string->val));
       free((s.as.string));
-      s.as.string = NULL;
     }
     break;
   case SEAL_LIST:
-    if (--s.as.list->ref_count <= 0) {
-      for (int i = 0; i < s.as.list->size; i++) {
-        gc_decref(s.as.list->mems[i]);
-      }
-      free(s.as.list->mems);
-      free(s.as.list);
+    gc_freed += gc_size(s);
+    for (int i = 0; i < s.as.list->size; i++) {
+      gc_decref(s.as.list->mems[i]);
     }
+    gc_free_body(s);
+    gc_free_header(s);
     break;
   case SEAL_MAP:
-    if (--s.as.map->ref_count <= 0) {
+    gc_freed += gc_size(s);
+    for (size_t i = 0; i < map_end(s.as.map); i++) {
+      svalue_t *v = map_at(s.as.map, i, NULL);
+      if (v != NULL)
+        gc_decref(*v);
+    }
 
-      for (int i = 0; i < s.as.map->map->cap; i++) {
-        if (s.as.map->map->entries[i].key)
-          gc_decref(s.as.map->map->entries[i].val);
-      }
+    gc_free_body(s);
+    gc_free_header(s);
+    break;
+  case SEAL_FUNC:
+    gc_freed += gc_size(s);
+    free(s.as.func);
+    break;
+  }
+}
+
+void gc_zct_grow(void)
+{
+  gc_zct = SEAL_REALLOC(gc_zct, sizeof(svalue_t) * (gc_zct_cap = gc_zct_cap ? gc_zct_cap * 2 : 64));
+}
 
-      free(s.as.map->map->entries);
-      free(s.as.map->map);
-      free(s.as.map);
+void gc_reconcile(size_t roots)
+{
+  size_t kept = 0;
+  /* freed objects append their members, loop picks them up */
+  for (size_t i = 0; i < gc_zct_size; i++) {
+    svalue_t s = gc_zct[i];
+    if (s.as.gc->ref_count > 0) {
+      s.as.gc->flags &= ~GC_IN_ZCT;
+    } else if (s.as.gc->flags & GC_ROOTED) {
+      gc_zct[kept++] = s; /* still on stack, check again later */
+    } else {
+      s.as.gc->flags &= ~GC_IN_ZCT; /* static strings stay alive */
+      gc_free(s);
     }
-    break;
   }
+  gc_zct_size = kept;
+  /* scanning roots again is amortized over new entries */
+  gc_zct_limit = kept + 1 + roots / GC_ROOTS_PER_ENTRY;
 }
-void gc_decref_nofree(svalue_t s)
+
+void gc_possible_root(svalue_t s)
 {
-  if (!IS_ALLOCATED(s))
+  if (s.as.gc->flags & GC_BUFFERED)
     return;
-  switch (VAL_TYPE(s)) {
-  case SEAL_STRING:
-    --s.as.string->ref_count;
-    break;
-  case SEAL_LIST:
-    --s.as.list->ref_count;
-    break;
-  case SEAL_MAP:
-    --s.as.map->ref_count;
-    break;
+  s.as.gc->flags |= GC_BUFFERED;
+  gc_buf_push(&gc_roots, s);
+}
+
+/* removes counts of references inside subgraph */
+#define GC_GRAY_CHILD(t) do { \
+  --(t).as.gc->ref_count; \
+  if (GC_GET_COLOR(t) != GC_GRAY) { \
+    GC_SET_COLOR(t, GC_GRAY); \
+    gc_buf_push(&gc_work, t); \
+  } \
+} while (0)
+
+static void gc_mark_gray(svalue_t s)
+{
+  if (GC_GET_COLOR(s) == GC_GRAY)
+    return;
+  GC_SET_COLOR(s, GC_GRAY);
+  gc_buf_push(&gc_work, s);
+  while (gc_work.size > 0) {
+    svalue_t t = gc_work.vals[--gc_work.size];
+    GC_EACH_CHILD(t, GC_GRAY_CHILD);
+  }
+}
+
+/* restores counts of subgraph referenced from outside */
+#define GC_BLACK_CHILD(t) do { \
+  ++(t).as.gc->ref_count; \
+  if (GC_GET_COLOR(t) != GC_BLACK) { \
+    GC_SET_COLOR(t, GC_BLACK); \
+    gc_buf_push(&gc_work, t); \
+  } \
+} while (0)
+
+static void gc_scan_black(svalue_t s)
+{
+  size_t bottom = gc_work.size;
+  GC_SET_COLOR(s, GC_BLACK);
+  gc_buf_push(&gc_work, s);
+  while (gc_work.size > bottom) {
+    svalue_t t = gc_work.vals[--gc_work.size];
+    GC_EACH_CHILD(t, GC_BLACK_CHILD);
   }
 }
-inline void gc_incref(svalue_t s)
+
+#define GC_SCAN_CHILD(t) do { \
+  if (GC_GET_COLOR(t) == GC_GRAY) \
+    gc_buf_push(&gc_work, t); \
+} while (0)
+
+/* object is alive if references remain after subtraction, or if it is on stack */
+static void gc_scan(svalue_t s)
 {
-  if (!IS_ALLOCATED(s))
+  gc_buf_push(&gc_work, s);
+  while (gc_work.size > 0) {
+    svalue_t t = gc_work.vals[--gc_work.size];
+    if (GC_GET_COLOR(t) != GC_GRAY)
+      continue;
+    if (t.as.gc->ref_count > 0 || (t.as.gc->flags & (GC_ROOTED | GC_IN_ZCT))) {
+      gc_scan_black(t);
+    } else {
+      GC_SET_COLOR(t, GC_WHITE);
+      GC_EACH_CHILD(t, GC_SCAN_CHILD);
+    }
+  }
+}
+
+#define GC_COLLECT_CHILD(t) do { \
+  if (GC_GET_COLOR(t) == GC_WHITE && !((t).as.gc->flags & GC_BUFFERED)) { \
+    GC_SET_COLOR(t, GC_COLLECTED); \
+    gc_buf_push(&gc_work, t); \
+  } \
+} while (0)
+
+static void gc_collect_white(svalue_t s)
+{
+  if (GC_GET_COLOR(s) != GC_WHITE || (s.as.gc->flags & GC_BUFFERED))
     return;
-  switch (VAL_TYPE(s)) {
-  case SEAL_STRING:
-    s.as.string->ref_count++;
-    break;
-  case SEAL_LIST:
-    s.as.list->ref_count++;
-    break;
-  case SEAL_MAP:
-    s.as.map->ref_count++;
-    break;
+  GC_SET_COLOR(s, GC_COLLECTED);
+  gc_buf_push(&gc_work, s);
+  while (gc_work.size > 0) {
+    svalue_t t = gc_work.vals[--gc_work.size];
+    gc_buf_push(&gc_white, t);
+    GC_EACH_CHILD(t, GC_COLLECT_CHILD);
+  }
+}
+
+/*
+ * counts of containers referenced from cycle were already subtracted,
+ * other members were never touched by trial deletion
+ */
+static void gc_release_member(svalue_t s)
+{
+  if (!GC_CONTAINER(s)) {
+    gc_decref(s);
+  } else if (GC_GET_COLOR(s) != GC_COLLECTED) {
+    if (s.as.gc->ref_count <= 0 && !(s.as.gc->flags & GC_IN_ZCT))
+      gc_zct_add(s);
+  }
+}
+
+static void gc_release_members(svalue_t s)
+{
+  if (VAL_TYPE(s) == SEAL_LIST) {
+    for (size_t i = 0; i < s.as.list->size; i++)
+      gc_release_member(s.as.list->mems[i]);
+  } else {
+    for (size_t i = 0; i < map_end(s.as.map); i++) {
+      svalue_t *v = map_at(s.as.map, i, NULL);
+      if (v != NULL)
+        gc_release_member(*v);
+    }
+  }
+}
+
+static void gc_free_white(svalue_t s)
+{
+  gc_freed += gc_size(s);
+  gc_free_body(s);
+  SEAL_POOL_FREE(s.as.gc, gc_header_size(s));
+}
+
+void gc_collect_cycles(void)
+{
+  size_t kept = 0;
+  for (size_t i = 0; i < gc_roots.size; i++) {
+    svalue_t s = gc_roots.vals[i];
+    if (s.as.gc->flags & GC_DEAD) {
+      SEAL_POOL_FREE(s.as.gc, gc_header_size(s));
+    } else if (s.as.gc->ref_count <= 0 || (s.as.gc->flags & GC_ROOTED)) {
+      s.as.gc->flags &= ~GC_BUFFERED; /* left to zct */
+    } else {
+      gc_mark_gray(s);
+      gc_roots.vals[kept++] = s;
+    }
   }
+  gc_roots.size = kept;
+
+  for (size_t i = 0; i < gc_roots.size; i++)
+    gc_scan(gc_roots.vals[i]);
+
+  for (size_t i = 0; i < gc_roots.size; i++) {
+    gc_roots.vals[i].as.gc->flags &= ~GC_BUFFERED;
+    gc_collect_white(gc_roots.vals[i]);
+  }
+  gc_roots.size = 0;
+
+  /* members are released before anything is freed, they may point back into cycle */
+  for (size_t i = 0; i < gc_white.size; i++)
+    gc_release_members(gc_white.vals[i]);
+  for (size_t i = 0; i < gc_white.size; i++)
+    gc_free_white(gc_white.vals[i]);
+  gc_white.size = 0;
+  gc_allocated = 0;
 }
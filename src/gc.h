@@ -4,8 +4,106 @@
 #include "sealconf.h"
 #include "sealtypes.h"
 
-void gc_decref(svalue_t);
-void gc_decref_nofree(svalue_t);
-void gc_incref(svalue_t);
+#define GC_NEEDS_REF(s) (VAL_TYPE(s) & SEAL_REFCOUNTED) /* single mask test, immediates skip gc */
+#define GC_CONTAINER(s) (VAL_TYPE(s) & (SEAL_LIST | SEAL_MAP)) /* only containers can form cycles */
+
+/*
+ * deferred reference counting, only references from heap (list members,
+ * map values, global slots) are counted. object whose count drops to zero
+ * is put into zero count table (zct) instead of being freed, vm reconciles
+ * table against its stacks at safe points
+ */
+#define GC_IN_ZCT  (1 << 0)
+#define GC_ROOTED  (1 << 1) /* referenced from stack while reconciling */
+#define GC_ROOTS_PER_ENTRY 4 /* roots scanned per new entry of table, smaller table frees dead objects while they are in cache */
+
+/*
+ * cycles are collected by trial deletion (Bacon and Rajan, synchronous).
+ * container whose count is dropped but stays above zero is buffered as
+ * possible root of garbage cycle, collector subtracts counts of references
+ * inside subgraphs of possible roots and frees what is left with no count
+ */
+#define GC_BUFFERED  (1 << 2) /* in possible roots */
+#define GC_DEAD      (1 << 3) /* freed while buffered, header is released by cycle collector */
+#define GC_COLOR     (3 << 4)
+#define GC_BLACK     (0 << 4) /* in use */
+#define GC_GRAY      (1 << 4) /* possible member of garbage cycle */
+#define GC_WHITE     (2 << 4) /* member of garbage cycle */
+#define GC_COLLECTED (3 << 4) /* white, about to be freed */
+#define GC_CYCLE_THRESHOLD (8 << 20) /* bytes of containers allocated between cycle collections */
+
+extern size_t gc_zct_size, gc_zct_limit; /* vm reconciles at next safe point when size reaches limit */
+extern size_t gc_zct_cap;
+extern svalue_t *gc_zct;
+extern size_t gc_allocated; /* bytes of containers allocated since last cycle collection */
+extern size_t gc_freed;     /* bytes freed in total */
+
+size_t gc_size(svalue_t); /* bytes owned by object */
+void gc_free(svalue_t); /* frees object, decrements its members */
+void gc_zct_grow(void);
+void gc_reconcile(size_t roots); /* frees entries that are neither counted nor rooted */
+void gc_possible_root(svalue_t); /* buffers container whose count was dropped */
+void gc_collect_cycles(void); /* frees garbage cycles, roots must be marked */
+
+/* fast paths are inlined into callers */
+static inline void gc_zct_add(svalue_t s)
+{
+  if (gc_zct_size >= gc_zct_cap)
+    gc_zct_grow();
+  s.as.gc->flags |= GC_IN_ZCT;
+  gc_zct[gc_zct_size++] = s;
+}
+
+static inline void gc_incref(svalue_t s)
+{
+  if (GC_NEEDS_REF(s))
+    ++s.as.gc->ref_count;
+}
+
+/* drops heap reference */
+static inline void gc_decref(svalue_t s)
+{
+  if (!GC_NEEDS_REF(s))
+    return;
+  if (--s.as.gc->ref_count <= 0) {
+    if (!(s.as.gc->flags & GC_IN_ZCT))
+      gc_zct_add(s);
+  } else if (GC_CONTAINER(s)) {
+    gc_possible_root(s);
+  }
+}
+
+/* drops stack or local reference, count is untouched */
+static inline void gc_release(svalue_t s)
+{
+  if (!GC_NEEDS_REF(s))
+    return;
+  if (s.as.gc->ref_count <= 0) {
+    if (!(s.as.gc->flags & GC_IN_ZCT))
+      gc_zct_add(s);
+  } else if (GC_CONTAINER(s)) {
+    gc_possible_root(s);
+  }
+}
+
+/* counts newly allocated container towards next cycle collection */
+static inline svalue_t gc_track(svalue_t s)
+{
+  if ((gc_allocated += gc_size(s)) >= GC_CYCLE_THRESHOLD)
+    gc_zct_limit = 0; /* reconcile at next safe point */
+  return s;
+}
+
+static inline void gc_root(svalue_t s)
+{
+  if (GC_NEEDS_REF(s))
+    s.as.gc->flags |= GC_ROOTED;
+}
+
+static inline void gc_unroot(svalue_t s)
+{
+  if (GC_NEEDS_REF(s))
+    s.as.gc->flags &= ~GC_ROOTED;
+}
 
 #endif /* SEAL_GC_H */
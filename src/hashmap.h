@@ -3,6 +3,9 @@
 
 #include "sealconf.h"
 #include "sealtypes.h"
+#if SEAL_HASHMAP_SSE2
+#include <emmintrin.h>
+#endif
 
 #define __hashmap_error(...) do { \
   fprintf(stderr, "error: "); \
@@ -11,128 +14,365 @@
   exit(1); \
 } while (0)
 
+/*
+ * open addressing in swiss table style, backs compiler tables, module
+ * globals and seal maps. every entry has control byte that is empty,
+ * deleted or 7 high bits of hash (h2). low bits of hash select home slot,
+ * HASHMAP_GROUP control bytes from there are matched against h2 at once,
+ * and only entries with same h2 and same stored hash compare keys. key
+ * mostly sits in its home slot, so that entry is fetched along with
+ * control bytes instead of after them, which matters once table is out
+ * of cache. probe moves by whole groups in triangular order and stops at
+ * group with empty byte. first HASHMAP_GROUP - 1 control bytes are
+ * cloned after last one, so group can start at any slot.
+ * capacity is power of two and map grows before load exceeds 7/8.
+ * map of at most HASHMAP_SMALL keys has no control bytes and is scanned
+ * linearly, in insertion order. it has one free slot more than it can
+ * hold, so search always has slot to return, and becomes hashed table
+ * when it would outgrow HASHMAP_SMALL.
+ * slots without key have NULL key, so entries can be iterated directly
+ */
+#define HASHMAP_GROUP   16
+#define HASHMAP_EMPTY   0x80
+#define HASHMAP_DELETED 0xFE
+#define HASHMAP_H2(hash) ((seal_byte)((hash) >> 25))
+#define HASHMAP_SMALL   8
+#define HASHMAP_IS_SMALL(map) ((map)->ctrl == NULL)
+#define HASHMAP_CTRL_BYTES(cap) ((cap) + HASHMAP_GROUP - 1)
+#define HASHMAP_LINE    64 /* entries of hashed map start at cache line */
+
+/* stack storage of map that never grows, holds LOCAL_MAX names (see hashmap_init_static) */
+#define HASHMAP_STATIC_CAP 512
+#if LOCAL_MAX > HASHMAP_STATIC_CAP / 8 * 7
+#error "HASHMAP_STATIC_CAP has no room for LOCAL_MAX entries"
+#endif
+
 struct h_entry {
   unsigned int hash;
+  bool owns_key; /* key is copy freed with seal map, see map_free_body */
   const char* key;
   svalue_t val;
-  bool is_tombstone;
 };
 
 typedef struct hashmap {
-  struct h_entry* entries;
+  struct h_entry* entries; /* allocation of hashed map starts with control bytes instead */
+  seal_byte* ctrl;         /* NULL for small map */
   size_t cap;
   size_t filled;
+  size_t growth_left; /* empty slots that can be used before rehash */
+  bool is_static;     /* storage is not owned, search returns NULL when full */
 } hashmap_t;
 
+struct hashmap_static {
+  struct h_entry entries[HASHMAP_STATIC_CAP];
+  seal_byte ctrl[HASHMAP_CTRL_BYTES(HASHMAP_STATIC_CAP)];
+};
+
 static inline unsigned int hash_str(const char* key) {
-  unsigned int hash = 0;
-  while (*key)
-    hash = *key++ + (hash << 6) + (hash << 16) - hash;
+  return hash_bytes(key, strlen(key));
+}
 
-  return hash;
+/* bit i is set if control byte i of group equals byte */
+static inline unsigned int hashmap_match(const seal_byte* group, seal_byte byte)
+{
+#if SEAL_HASHMAP_SSE2
+  __m128i ctrl = _mm_loadu_si128((const __m128i*)group);
+  return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)byte)));
+#else
+  unsigned int mask = 0;
+  for (int i = 0; i < HASHMAP_GROUP; i++)
+    mask |= (unsigned int)(group[i] == byte) << i;
+  return mask;
+#endif
 }
 
-static inline void hashmap_init(hashmap_t* hashmap, size_t size)
+static inline int hashmap_first_bit(unsigned int mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctz(mask);
+#else
+  int i = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    i++;
+  }
+  return i;
+#endif
+}
+
+static inline int hashmap_last_bit(unsigned int mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return 31 - __builtin_clz(mask);
+#else
+  int i = 0;
+  while (mask >>= 1)
+    i++;
+  return i;
+#endif
+}
+
+/* memory is only read ahead, search never waits for it */
+static inline void hashmap_prefetch(const void* addr)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(addr);
+#else
+  (void)addr;
+#endif
+}
+
+/* control byte of slot and its clone */
+static inline void hashmap_set_ctrl(hashmap_t* hashmap, size_t idx, seal_byte byte)
+{
+  hashmap->ctrl[idx] = byte;
+  if (idx < HASHMAP_GROUP - 1)
+    hashmap->ctrl[hashmap->cap + idx] = byte;
+}
+
+/* allocation of hashed map of cap slots */
+static inline size_t hashmap_bytes_of(size_t cap)
 {
-  hashmap->cap = size;
+  return HASHMAP_CTRL_BYTES(cap) + HASHMAP_LINE - 1 + cap * sizeof(struct h_entry);
+}
+
+/* cap of HASHMAP_SMALL + 1 slots or less makes small map */
+static inline void hashmap_alloc(hashmap_t* hashmap, size_t cap)
+{
+  hashmap->cap = cap;
   hashmap->filled = 0;
-  hashmap->entries = SEAL_CALLOC(size, sizeof(struct h_entry));
-  for (int i = 0; i < size; i++) {
-    hashmap->entries[i].key = NULL;
-    hashmap->entries[i].is_tombstone = false;
+  hashmap->is_static = false;
+  if (cap <= HASHMAP_SMALL + 1) {
+    hashmap->growth_left = cap - 1;
+    hashmap->entries = SEAL_CALLOC(cap, sizeof(struct h_entry));
+    hashmap->ctrl = NULL;
+    return;
+  }
+  hashmap->growth_left = cap / 8 * 7;
+  /* entry is half a line, aligned entries never straddle two lines */
+  hashmap->ctrl = SEAL_CALLOC(1, hashmap_bytes_of(cap));
+  uintptr_t end = (uintptr_t)(hashmap->ctrl + HASHMAP_CTRL_BYTES(cap));
+  hashmap->entries = (struct h_entry*)((end + HASHMAP_LINE - 1) & ~(uintptr_t)(HASHMAP_LINE - 1));
+  memset(hashmap->ctrl, HASHMAP_EMPTY, HASHMAP_CTRL_BYTES(cap));
+}
+
+/* size keys fit without growing */
+static inline void hashmap_init(hashmap_t* hashmap, size_t size)
+{
+  if (size <= HASHMAP_SMALL) {
+    hashmap_alloc(hashmap, (size < 2 ? 2 : size) + 1);
+    return;
   }
+  size_t cap = HASHMAP_GROUP;
+  while (cap / 8 * 7 < size)
+    cap *= 2;
+  hashmap_alloc(hashmap, cap);
 }
 
-static inline void hashmap_init_static(hashmap_t* hashmap, struct h_entry* entries, size_t size)
+static inline size_t hashmap_bytes(hashmap_t* hashmap)
 {
-  hashmap->cap = size;
+  if (HASHMAP_IS_SMALL(hashmap))
+    return hashmap->cap * sizeof(struct h_entry);
+  return hashmap_bytes_of(hashmap->cap);
+}
+
+static inline void hashmap_init_static(hashmap_t* hashmap, struct hashmap_static* storage)
+{
+  hashmap->cap = HASHMAP_STATIC_CAP;
   hashmap->filled = 0;
-  hashmap->entries = entries;
-  for (int i = 0; i < size; i++) {
+  hashmap->growth_left = LOCAL_MAX;
+  hashmap->is_static = true;
+  hashmap->entries = storage->entries;
+  hashmap->ctrl = storage->ctrl;
+  for (size_t i = 0; i < HASHMAP_STATIC_CAP; i++)
     hashmap->entries[i].key = NULL;
-    hashmap->entries[i].is_tombstone = false;
-  }
+  memset(hashmap->ctrl, HASHMAP_EMPTY, HASHMAP_CTRL_BYTES(HASHMAP_STATIC_CAP));
 }
 
-static inline struct h_entry* hashmap_search(hashmap_t* hashmap, const char* key)
+static inline void hashmap_free(hashmap_t* hashmap)
 {
-  unsigned int idx = hash_str(key) % hashmap->cap;
-  struct h_entry* tombstone = NULL;
-
-  struct h_entry* e;
-  unsigned int start_idx = idx;
-  do {
-    e = &hashmap->entries[idx];
-    if (e->key == NULL) {
-      if (e->is_tombstone) {
-        if (tombstone == NULL)
-          tombstone = e;
-      } else {
-        return tombstone != NULL ? tombstone : e;
+  if (hashmap->is_static)
+    return;
+  if (HASHMAP_IS_SMALL(hashmap))
+    SEAL_FREE(hashmap->entries);
+  else
+    SEAL_FREE(hashmap->ctrl);
+}
+
+/*
+ * returns entry of key, or free slot where key should be inserted (its
+ * key is NULL). NULL only if key is missing and static map is full
+ */
+static inline struct h_entry* hashmap_search_hash(hashmap_t* hashmap, const char* key, unsigned int hash)
+{
+  if (HASHMAP_IS_SMALL(hashmap)) {
+    struct h_entry* free_slot = NULL;
+    for (size_t i = 0; i < hashmap->cap; i++) {
+      struct h_entry* e = &hashmap->entries[i];
+      if (e->key == NULL) {
+        if (free_slot == NULL)
+          free_slot = e;
+      } else if (e->hash == hash && (e->key == key || strcmp(e->key, key) == 0)) {
+        return e;
       }
-    } else if (strcmp(e->key, key) == 0) {
-      return e;
     }
-    idx = (idx + 1) % hashmap->cap;
-  } while (idx != start_idx);
+    return free_slot;
+  }
+
+  size_t mask = hashmap->cap - 1;
+  size_t pos = hash & mask;
+  seal_byte h2 = HASHMAP_H2(hash);
+  struct h_entry* free_slot = NULL;
+  hashmap_prefetch(&hashmap->entries[pos]); /* key or free slot is mostly there */
+
+  /* positions pos + HASHMAP_GROUP * k cover every slot as capacity is power of two */
+  for (size_t step = HASHMAP_GROUP; ; step += HASHMAP_GROUP) {
+    const seal_byte* ctrl = hashmap->ctrl + pos;
+
+    for (unsigned int m = hashmap_match(ctrl, h2); m != 0; m &= m - 1) {
+      struct h_entry* e = &hashmap->entries[(pos + hashmap_first_bit(m)) & mask];
+      if (e->hash == hash && (e->key == key || strcmp(e->key, key) == 0))
+        return e;
+    }
 
-  return NULL;
+    if (free_slot == NULL) {
+      unsigned int deleted = hashmap_match(ctrl, HASHMAP_DELETED);
+      if (deleted)
+        free_slot = &hashmap->entries[(pos + hashmap_first_bit(deleted)) & mask];
+    }
+    unsigned int empty = hashmap_match(ctrl, HASHMAP_EMPTY);
+    if (empty) {
+      if (free_slot != NULL)
+        return free_slot;
+      if (hashmap->is_static && hashmap->growth_left == 0)
+        return NULL;
+      return &hashmap->entries[(pos + hashmap_first_bit(empty)) & mask];
+    }
+    pos = (pos + step) & mask;
+  }
 }
 
-static inline bool hashmap_insert(hashmap_t* hashmap, const char* key, svalue_t val)
+static inline struct h_entry* hashmap_search(hashmap_t* hashmap, const char* key)
 {
-  if (hashmap->filled >= hashmap->cap)
-    __hashmap_error("hashmap is full");
+  return hashmap_search_hash(hashmap, key, hash_str(key));
+}
 
-  struct h_entry* searched = hashmap_search(hashmap, key);
-  
-  struct h_entry e = {
-    hash_str(key),
-    key,
-    val,
-    true
-  };
+/* seal map lookup, hash of string is cached */
+static inline struct h_entry* hashmap_search_str(hashmap_t* hashmap, struct seal_string* key)
+{
+  return hashmap_search_hash(hashmap, key->val, str_hash(key));
+}
 
-  bool is_new = searched->key == NULL;
-  if (is_new)
-    hashmap->filled++;
+/* moves entries to table of cap slots, deleted slots are dropped */
+static inline void hashmap_rehash(hashmap_t* hashmap, size_t cap)
+{
+  hashmap_t old = *hashmap;
+  hashmap_alloc(hashmap, cap);
+  for (size_t i = 0, n = 0; i < old.cap; i++) {
+    struct h_entry* e = &old.entries[i];
+    if (e->key == NULL)
+      continue;
+    if (HASHMAP_IS_SMALL(hashmap)) {
+      hashmap->entries[n++] = *e; /* keeps order */
+      continue;
+    }
+    struct h_entry* slot = hashmap_search_hash(hashmap, e->key, e->hash);
+    hashmap_set_ctrl(hashmap, slot - hashmap->entries, HASHMAP_H2(e->hash));
+    *slot = *e;
+  }
+  hashmap->filled = old.filled;
+  hashmap->growth_left -= old.filled;
+  hashmap_free(&old);
+}
 
-  *searched = e;
+/*
+ * puts key into entry returned by search, returns entry holding key.
+ * map may grow, so entry given by search is not valid after insertion
+ */
+static inline struct h_entry* hashmap_insert_hash(hashmap_t* hashmap, struct h_entry* entry,
+    const char* key, unsigned int hash, svalue_t val)
+{
+  if (entry->key != NULL) {
+    entry->key = key;
+    entry->val = val;
+    return entry;
+  }
 
-  return is_new;
+  size_t idx = entry - hashmap->entries;
+  /* every free slot of small map counts against growth */
+  bool is_empty = HASHMAP_IS_SMALL(hashmap) || hashmap->ctrl[idx] == HASHMAP_EMPTY;
+  if (is_empty && hashmap->growth_left == 0) {
+    size_t cap;
+    if (hashmap->is_static)
+      __hashmap_error("hashmap is full");
+    if (HASHMAP_IS_SMALL(hashmap)) /* 3, 5, 9 slots, then hashed */
+      cap = hashmap->cap > HASHMAP_SMALL / 2 + 1 ? HASHMAP_GROUP : 2 * hashmap->cap - 1;
+    else /* mostly deleted slots are reclaimed in place, otherwise capacity doubles */
+      cap = hashmap->filled < hashmap->cap / 16 * 7 ? hashmap->cap : hashmap->cap * 2;
+    hashmap_rehash(hashmap, cap);
+    entry = hashmap_search_hash(hashmap, key, hash);
+    idx = entry - hashmap->entries;
+    is_empty = HASHMAP_IS_SMALL(hashmap) || hashmap->ctrl[idx] == HASHMAP_EMPTY;
+  }
+
+  if (is_empty)
+    hashmap->growth_left--;
+  if (!HASHMAP_IS_SMALL(hashmap))
+    hashmap_set_ctrl(hashmap, idx, HASHMAP_H2(hash));
+  hashmap->filled++;
+  *entry = (struct h_entry) { .hash = hash, .key = key, .val = val };
+  return entry;
 }
 
-static inline bool hashmap_insert_e(hashmap_t* hashmap, struct h_entry* entry, const char* key, svalue_t val)
+static inline struct h_entry* hashmap_insert_e(hashmap_t* hashmap, struct h_entry* entry, const char* key, svalue_t val)
 {
-  struct h_entry e = {
-    hash_str(key),
-    key,
-    val,
-    true
-  };
-
-  bool is_new = entry->key == NULL;
-  if (is_new)
-    hashmap->filled++;
+  return hashmap_insert_hash(hashmap, entry, key, hash_str(key), val);
+}
 
-  *entry = e;
+/* returns true if key is new */
+static inline bool hashmap_insert(hashmap_t* hashmap, const char* key, svalue_t val)
+{
+  unsigned int hash = hash_str(key);
+  struct h_entry* searched = hashmap_search_hash(hashmap, key, hash);
+  if (searched == NULL)
+    __hashmap_error("hashmap is full");
 
+  bool is_new = searched->key == NULL;
+  hashmap_insert_hash(hashmap, searched, key, hash, val);
   return is_new;
 }
 
-static inline bool hashmap_remove(hashmap_t* hashmap, const char* key)
+/* key of seal map must be interned */
+static inline void hashmap_insert_str(hashmap_t* hashmap, struct seal_string* key, svalue_t val)
 {
-  if (hashmap->filled <= 0)
-    __hashmap_error("hashmap is empty");
+  struct h_entry* searched = hashmap_search_str(hashmap, key);
+  hashmap_insert_hash(hashmap, searched, key->val, str_hash(key), val);
+}
 
+static inline bool hashmap_remove(hashmap_t* hashmap, const char* key)
+{
   struct h_entry* searched = hashmap_search(hashmap, key);
-
-  if (searched->key == NULL)
+  if (searched == NULL || searched->key == NULL)
     return false;
 
-  searched->is_tombstone = true;
+  size_t idx = searched - hashmap->entries;
+  if (HASHMAP_IS_SMALL(hashmap)) {
+    hashmap->growth_left++;
+  } else {
+    /*
+     * probe never passes group with empty byte, so slot can be empty again
+     * if full slots around it are too few to have ever filled a group
+     */
+    unsigned int after = hashmap_match(hashmap->ctrl + idx, HASHMAP_EMPTY);
+    unsigned int before = hashmap_match(hashmap->ctrl + ((idx - HASHMAP_GROUP) & (hashmap->cap - 1)), HASHMAP_EMPTY);
+    if (after && before && hashmap_first_bit(after) + (HASHMAP_GROUP - 1 - hashmap_last_bit(before)) < HASHMAP_GROUP) {
+      hashmap_set_ctrl(hashmap, idx, HASHMAP_EMPTY);
+      hashmap->growth_left++;
+    } else {
+      hashmap_set_ctrl(hashmap, idx, HASHMAP_DELETED);
+    }
+  }
   searched->key = NULL;
-
   hashmap->filled--;
 
   return true;
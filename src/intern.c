@@ -0,0 +1,100 @@
+#include "intern.h"
+
+/* open addressing with linear probing, grows at 3/4 load */
+static struct seal_string** table = NULL;
+static size_t cap = 0;
+static size_t filled = 0;
+
+/* strings of single characters live here, interned along with the table */
+struct seal_string* str_chars[256];
+static struct seal_string char_strings[256];
+static char char_vals[256][2];
+
+static void intern_grow(void)
+{
+  struct seal_string** old = table;
+  size_t old_cap = cap;
+
+  cap = cap ? cap * 2 : INTERN_START_CAP;
+  table = SEAL_CALLOC(cap, sizeof(struct seal_string*));
+  for (size_t i = 0; i < old_cap; i++) {
+    if (old[i] == NULL)
+      continue;
+    size_t idx = old[i]->hash & (cap - 1);
+    while (table[idx] != NULL)
+      idx = (idx + 1) & (cap - 1);
+    table[idx] = old[i];
+  }
+  SEAL_FREE(old);
+}
+
+/* slot of string with given characters, or empty slot where it belongs */
+static size_t intern_slot(const char* val, size_t size, unsigned int hash)
+{
+  size_t idx = hash & (cap - 1);
+  for (struct seal_string* s; (s = table[idx]) != NULL; idx = (idx + 1) & (cap - 1))
+    if (s->hash == hash && s->size == size && memcmp(s->val, val, size) == 0)
+      break;
+  return idx;
+}
+
+static void intern_chars(void)
+{
+  for (int c = 0; c < 256; c++) {
+    char_vals[c][0] = (char)c;
+    char_strings[c] = (struct seal_string) {
+      .gc = { .ref_count = 1 }, /* never enters zct */
+      .val = char_vals[c],
+      .size = 1,
+      .hash = hash_bytes(char_vals[c], 1),
+      .has_hash = true,
+      .is_static = true,
+      .is_interned = true,
+    };
+    table[intern_slot(char_vals[c], 1, char_strings[c].hash)] = &char_strings[c];
+    str_chars[c] = &char_strings[c];
+  }
+  filled += 256;
+}
+
+struct seal_string* str_intern(const char* val, size_t size)
+{
+  if (cap == 0) {
+    intern_grow();
+    intern_chars();
+  }
+  if (4 * (filled + 1) > 3 * cap)
+    intern_grow();
+
+  unsigned int hash = hash_bytes(val, size);
+  size_t idx = intern_slot(val, size, hash);
+  if (table[idx] != NULL)
+    return table[idx];
+
+  /* header and characters in one block, owned by table */
+  struct seal_string* s = SEAL_MALLOC(sizeof(struct seal_string) + size + 1);
+  char* chars = (char*)(s + 1);
+  memcpy(chars, val, size);
+  chars[size] = '\0';
+  *s = (struct seal_string) {
+    .gc = { .ref_count = 1 }, /* never enters zct */
+    .val = chars,
+    .size = size,
+    .hash = hash,
+    .has_hash = true,
+    .is_static = true,
+    .is_interned = true,
+  };
+  table[idx] = s;
+  filled++;
+  return s;
+}
+
+struct seal_string* str_find_interned(struct seal_string* str)
+{
+  if (str->is_interned)
+    return str;
+  if (cap == 0)
+    return NULL;
+  return table[intern_slot(str->val, str->size, str_hash(str))];
+}
@@ -0,0 +1,39 @@
+#ifndef SEAL_INTERN_H
+#define SEAL_INTERN_H
+
+#include "sealconf.h"
+#include "sealtypes.h"
+
+/*
+ * vm-wide table of unique strings: identifiers, constant strings of every
+ * file (map keys written in source among them) and strings of single
+ * characters. indexing and iteration of strings return the latter. keys
+ * computed at runtime are not interned, maps own copies of them.
+ * interned string is never freed and its hash is computed once, two
+ * interned strings are equal only if they are the same object
+ */
+#define INTERN_START_CAP 1024 /* power of two */
+
+struct seal_string* str_intern(const char* val, size_t size); /* returns interned copy of characters */
+struct seal_string* str_find_interned(struct seal_string* str); /* NULL if no string with same characters is interned */
+
+extern struct seal_string* str_chars[256]; /* filled once first string is interned */
+
+/* interned string of one character, allocated once for whole run */
+static inline struct seal_string* str_char(char c)
+{
+  struct seal_string* s = str_chars[(unsigned char)c];
+  return s != NULL ? s : str_intern(&c, 1);
+}
+
+static inline struct seal_string* str_intern_string(struct seal_string* str)
+{
+  return str->is_interned ? str : str_intern(str->val, str->size);
+}
+
+static inline svalue_t SEAL_VALUE_STRING_INTERNED(const char* val)
+{
+  return (svalue_t) { .type = SEAL_STRING, .as.string = str_intern(val, strlen(val)) };
+}
+
+#endif /* SEAL_INTERN_H */
@@ -1,5 +1,12 @@
 #include "io.h"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 bool check_if_seal_file(const char* path)
 {
   if (strlen(path) <= 5) return false;
@@ -29,3 +36,43 @@ const char* read_file(const char* path)
 		return content;
 	}
 }
+
+const char* map_file(const char* path, size_t* size)
+{
+#ifdef _WIN32
+  const char* content = read_file(path);
+  if (content)
+    *size = strlen(content);
+  return content;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return NULL;
+  }
+  *size = st.st_size;
+  if (*size == 0) {
+    close(fd);
+    return SEAL_CALLOC(1, sizeof(char));
+  }
+  /* pages are copied only when lexer writes into them */
+  void* content = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  return content == MAP_FAILED ? NULL : content;
+#endif
+}
+
+void unmap_file(const char* content, size_t size)
+{
+#ifdef _WIN32
+  SEAL_FREE((char*)content);
+#else
+  if (size == 0)
+    SEAL_FREE((char*)content);
+  else
+    munmap((void*)content, size);
+#endif
+}
@@ -5,5 +5,7 @@
 
 bool check_if_seal_file(const char* path);
 const char* read_file(const char* path);
+const char* map_file(const char* path, size_t* size); /* private writable copy of file, NULL if it cannot be opened */
+void unmap_file(const char* content, size_t size);
 
 #endif /* SEAL_IO_H */
@@ -1,10 +1,8 @@
 #include "lexer.h"
 #include "io.h"
 
-#define LEXEME_ID                   0
 #define LEXEME_DIGIT                1
 #define LEXEME_FRACTION_BEGIN_DIGIT 2
-#define LEXEME_STRING               3
 
 #define SINGLE_LINE_COMMENT 0
 #define MULTILINE_COMMENT   1
@@ -31,6 +29,35 @@
 #define lexer_is_alnum_(c) ( \
   lexer_is_id(c) || lexer_is_digit(c))
 
+/*
+ * perfect hash of keywords on their first two characters and length,
+ * table is filled at compile time, no two keywords share a slot
+ */
+#define KEYWORD_HASH(c0, c1, len) (((c0) + 6 * (c1) + 3 * (len)) & 63)
+
+static const seal_byte keywords[64] = {
+  [KEYWORD_HASH('i', 'f', 2)] = TOK_IF,
+  [KEYWORD_HASH('t', 'h', 4)] = TOK_THEN,
+  [KEYWORD_HASH('e', 'l', 4)] = TOK_ELSE,
+  [KEYWORD_HASH('d', 'o', 2)] = TOK_DO,
+  [KEYWORD_HASH('w', 'h', 5)] = TOK_WHILE,
+  [KEYWORD_HASH('f', 'o', 3)] = TOK_FOR,
+  [KEYWORD_HASH('i', 'n', 2)] = TOK_IN,
+  [KEYWORD_HASH('s', 'k', 4)] = TOK_SKIP,
+  [KEYWORD_HASH('s', 't', 4)] = TOK_STOP,
+  [KEYWORD_HASH('i', 'n', 7)] = TOK_INCLUDE,
+  [KEYWORD_HASH('a', 's', 2)] = TOK_AS,
+  [KEYWORD_HASH('d', 'e', 6)] = TOK_DEFINE,
+  [KEYWORD_HASH('r', 'e', 6)] = TOK_RETURN,
+  [KEYWORD_HASH('t', 'y', 6)] = TOK_TYPEOF,
+  [KEYWORD_HASH('a', 'n', 3)] = TOK_AND,
+  [KEYWORD_HASH('o', 'r', 2)] = TOK_OR,
+  [KEYWORD_HASH('n', 'o', 3)] = TOK_NOT,
+  [KEYWORD_HASH('t', 'r', 4)] = TOK_TRUE,
+  [KEYWORD_HASH('f', 'a', 5)] = TOK_FALSE,
+  [KEYWORD_HASH('n', 'u', 4)] = TOK_NULL,
+};
+
 static inline void lexer_error(lexer_t* lexer, const char* err, int line)
 {
   fprintf(stderr, "seal: file: \'%s\', line %d\nsyntax error: %s\n", lexer->file_path, line == 0 ? lexer->line : line, err);
@@ -41,14 +68,15 @@ static inline void lexer_error(lexer_t* lexer, const char* err, int line)
 
 inline void init_lexer(lexer_t* lexer, const char* file_path)
 {
-  const char* src = read_file(file_path);
+  size_t src_size;
+  const char* src = map_file(file_path, &src_size);
   if (!src) {
     fprintf(stderr, "seal: cannot open \'%s\': No such file or directory\n", file_path);
     exit(EXIT_FAILURE);
   }
   lexer->file_path           = file_path;
   lexer->src                 = src;
-  lexer->src_size            = strlen(src);
+  lexer->src_size            = src_size;
   lexer->i                   = 0;
   lexer->line                = 1;
   lexer->toks                = NULL;
@@ -82,7 +110,7 @@ inline void lexer_get_tokens(lexer_t* lexer)
     lexer_error(lexer, err, lexer->paren_lines_stack[lexer->paren_lines_ptr]);
   }
 
-  if (lexer->tok_size > 0 && lexer->toks[lexer->tok_size - 1]->type != TOK_NEWL) {
+  if (lexer->tok_size > 0 && lexer->toks[lexer->tok_size - 1].type != TOK_NEWL) {
     lexer_add_token(lexer, create_token(TOK_NEWL, NULL, lexer->line));
   }
 
@@ -93,7 +121,7 @@ inline void lexer_get_tokens(lexer_t* lexer)
 
   lexer_add_token(lexer, create_token(TOK_EOF, NULL, lexer->line));
 
-  SEAL_FREE((char*)lexer->src); // free source file after lexing
+  lexer_terminate_slices(lexer); // source is kept, tokens point into it
 }
 
 static inline void stack_push(int val, int stack[], int stack_size, int* stack_ptr)
@@ -121,7 +149,7 @@ static void lexer_get_token(lexer_t* lexer)
   bool encountered_word = true;
 
   char c = lexer_advance(lexer);
-  token_t* tok = NULL;
+  token_t tok = { .type = -1 }; // no token
 
   switch (c) {
     case ' ': case '\t':
@@ -316,8 +344,8 @@ static void lexer_get_token(lexer_t* lexer)
   }
 
   // parenthesis stack
-  if (tok && tok->type >= TOK_LPAREN && tok->type <= TOK_RBRACE) {
-    if (tok->type == TOK_LPAREN || tok->type == TOK_LBRACK || tok->type == TOK_LBRACE) {
+  if (tok.type >= TOK_LPAREN && tok.type <= TOK_RBRACE) {
+    if (tok.type == TOK_LPAREN || tok.type == TOK_LBRACK || tok.type == TOK_LBRACE) {
       stack_push(c, lexer->paren_stack, MAX_NESTED_PAREN_LEVEL, &lexer->paren_stack_ptr);
       stack_push(lexer->line, lexer->paren_lines_stack, MAX_NESTED_PAREN_LEVEL, &lexer->paren_lines_ptr);
     } else {
@@ -347,7 +375,7 @@ static void lexer_get_token(lexer_t* lexer)
     }
   }
 
-  if (tok) {
+  if (tok.type >= 0) {
     if (lexer->token_after_comment) {
       char err[ERR_LEN];
       sprintf(err, "token after comment block not allowed");
@@ -371,140 +399,134 @@ static inline char lexer_match(lexer_t* lexer, char c)
 }
 
 /* token functions */
-static inline void lexer_add_token(lexer_t* lexer, token_t* tok)
+static inline void lexer_add_token(lexer_t* lexer, token_t tok)
 {
   lexer->tok_size++;
-  lexer->toks = SEAL_REALLOC(lexer->toks, lexer->tok_size * sizeof(token_t*));
+  lexer->toks = SEAL_ARENA_GROW(lexer->toks, lexer->tok_size, sizeof(token_t));
   lexer->toks[lexer->tok_size - 1] = tok;
 }
 
-static token_t* lexer_get_id(lexer_t* lexer)
+static token_t lexer_get_id(lexer_t* lexer)
 {
-  char* lexeme = lexer_get_lexeme(lexer, LEXEME_ID, 0);
-  for (int i = TOK_IF; i < TOK_ID; i++) {
-    if (strcmp(lexeme, htoken_type_name(i)) == 0) {
-      free(lexeme);
-      return create_token(i, NULL, lexer->line);
-    }
+  const char* start = lexer->src + lexer->i - 1;
+  while (lexer_is_alnum_(lexer_peek(lexer)))
+    lexer->i++;
+  int len = lexer->src + lexer->i - start;
+
+  if (len > 1) {
+    int type = keywords[KEYWORD_HASH(start[0], start[1], len)];
+    const char* name = htoken_type_name(type);
+    if (type != TOK_EOF && strncmp(start, name, len) == 0 && name[len] == '\0')
+      return create_token(type, NULL, lexer->line);
   }
-  return create_token(TOK_ID, lexeme, lexer->line);
+  return create_slice_token(TOK_ID, start, len, lexer->line);
 }
 
-static token_t* lexer_get_digit(lexer_t* lexer, int lexeme_type)
+static token_t lexer_get_digit(lexer_t* lexer, int lexeme_type)
 {
-  token_t* tok = NULL;
-  const char* lexeme = lexer_get_lexeme(lexer, lexeme_type, 0);
-  if (lexeme_type == LEXEME_FRACTION_BEGIN_DIGIT) {
-    tok = create_token(TOK_FLOAT, lexeme, lexer->line);
-  } else if (lexeme_type == LEXEME_DIGIT) {
-    for (const char* cp_lexeme = lexeme; *cp_lexeme != '\0'; cp_lexeme++) {
-      if (*cp_lexeme == '.') {
-        return create_token(TOK_FLOAT, lexeme, lexer->line);
-      }
-    }
-    tok = create_token(TOK_INT, lexeme, lexer->line);
-  } else {
-    fprintf(stderr, "unrecognized digit type to get\n");
+  const char* start = lexer->src + lexer->i - 1; // first digit or '.'
+  bool is_float = lexeme_type == LEXEME_FRACTION_BEGIN_DIGIT;
+
+  while (lexer_is_digit(lexer_peek(lexer)))
+    lexer->i++;
+  if (!is_float && lexer_peek(lexer) == '.') {
+    lexer->i++;
+    is_float = true;
+    while (lexer_is_digit(lexer_peek(lexer)))
+      lexer->i++;
   }
-
-  return tok;
-}
-
-static token_t* lexer_get_string(lexer_t* lexer, int str_sur)
-{
-  const char* lexeme = lexer_get_lexeme(lexer, LEXEME_STRING, str_sur);
-  return create_token(TOK_STRING, lexeme ? lexeme : "", lexer->line);
-}
-
-/* custom append function for string */
-static inline void lexeme_append(char** lexeme, size_t* l_size, char c)
-{
-  (*l_size)++;
-  *lexeme = SEAL_REALLOC(*lexeme, (*l_size + 1) * sizeof(char));
-  (*lexeme)[*l_size - 1] = c;
-  (*lexeme)[*l_size] = '\0';
+  return create_slice_token(is_float ? TOK_FLOAT : TOK_INT, start, lexer->src + lexer->i - start, lexer->line);
 }
 
-/* get lexeme */
-static char* lexer_get_lexeme(lexer_t* lexer, int lexeme_type, int str_sur)
+static token_t lexer_get_string(lexer_t* lexer, int str_sur)
 {
-  char* lexeme  = NULL;
-  size_t l_size = 0;
+  const char* start = lexer->src + lexer->i;
+  bool has_escape = false;
+  char c;
 
-  if (lexeme_type != LEXEME_STRING) {
-    lexeme_append(&lexeme, &l_size, lexer_peek_offset(lexer, -1));
+  while (!lexer_is_end(lexer) && (c = lexer_peek(lexer)) != '\n' && c != str_sur) {
+    lexer_advance(lexer);
+    if (c == '\\' && !lexer_is_end(lexer)) {
+      lexer_advance(lexer);
+      has_escape = true;
+    }
   }
-
-  char c;
-  switch (lexeme_type) {
-    case LEXEME_ID:
-      while (lexer_is_alnum_((c = lexer_peek(lexer)))) {
-        lexer_advance(lexer);
-        lexeme_append(&lexeme, &l_size, c);
-      }
-      break;
-    case LEXEME_DIGIT:
-      while (lexer_is_digit((c = lexer_peek(lexer)))) {
-        lexer_advance(lexer);
-        lexeme_append(&lexeme, &l_size, c);
-      }
-      if (lexer_peek(lexer) == '.') {
-        lexeme_append(&lexeme, &l_size, lexer_advance(lexer));
-      }
-      while (lexer_is_digit((c = lexer_peek(lexer)))) {
-        lexer_advance(lexer);
-        lexeme_append(&lexeme, &l_size, c);
-      }
-      break;
-    case LEXEME_FRACTION_BEGIN_DIGIT:
-      while (lexer_is_digit((c = lexer_peek(lexer)))) {
-        lexer_advance(lexer);
-        lexeme_append(&lexeme, &l_size, c);
-      }
-      break;
-    case LEXEME_STRING:
-      while ((c = lexer_peek(lexer)) != '\n' && c != str_sur) {
-        lexer_advance(lexer);
-        if (c == '\\') {
-          char esc_c = lexer_advance(lexer);
-          switch (esc_c) {
-            case '\\':
-              break;
-            case 'n':
-              c = '\n';
-              break;
-            case 'r':
-              c = '\r';
-              break;
-            case 't':
-              c = '\t';
-              break;
-            case '\'':
-              c = '\'';
-              break;
-            case '\"':
-              c = '\"';
-              break;
-            case 'b':
-              c = '\b';
-              break;
-            default: {
-              char err[ERR_LEN];
-              sprintf(err, "invalid escape sequence '\\%c'", esc_c);
-              lexer_error(lexer, err, 0);
-            }
-          }
+  if (lexer_peek(lexer) != str_sur) {
+    lexer_error(lexer, "unterminated string", 0);
+  }
+  int len = lexer->src + lexer->i - start;
+  lexer_advance(lexer);
+
+  if (!has_escape)
+    return create_slice_token(TOK_STRING, start, len, lexer->line);
+
+  /* only strings with escape sequences are copied */
+  char* lexeme = SEAL_MALLOC(len + 1);
+  int l_size = 0;
+  for (int i = 0; i < len; i++) {
+    c = start[i];
+    if (c == '\\') {
+      char esc_c = start[++i];
+      switch (esc_c) {
+        case '\\':
+          break;
+        case 'n':
+          c = '\n';
+          break;
+        case 'r':
+          c = '\r';
+          break;
+        case 't':
+          c = '\t';
+          break;
+        case '\'':
+          c = '\'';
+          break;
+        case '\"':
+          c = '\"';
+          break;
+        case 'b':
+          c = '\b';
+          break;
+        default: {
+          char err[ERR_LEN];
+          sprintf(err, "invalid escape sequence '\\%c'", esc_c);
+          lexer_error(lexer, err, 0);
         }
-        lexeme_append(&lexeme, &l_size, c);
-      }
-      if (c != str_sur) {
-        lexer_error(lexer, "unterminated string", 0);
       }
-      lexer_advance(lexer);
-      break;
+    }
+    lexeme[l_size++] = c;
   }
+  lexeme[l_size] = '\0';
+  return create_token(TOK_STRING, lexeme, lexer->line);
+}
 
-  return lexeme;
+/*
+ * terminates slices in place once source is not read anymore, slice
+ * directly followed by another slice or by end of file is copied
+ */
+static void lexer_terminate_slices(lexer_t* lexer)
+{
+  const char* src  = lexer->src;
+  const char* end  = src + lexer->src_size;
+  const char* next = end; // start of following slice
+
+  for (int i = lexer->tok_size - 1; i >= 0; i--) {
+    token_t* tok = &lexer->toks[i];
+    if (tok->val < src || tok->val >= end)
+      continue; // name of token or copied string
+    const char* start = tok->val;
+    char* slice_end = (char*)start + tok->len;
+    if (slice_end == next || slice_end == end) {
+      char* lexeme = SEAL_MALLOC(tok->len + 1);
+      memcpy(lexeme, start, tok->len);
+      lexeme[tok->len] = '\0';
+      tok->val = lexeme;
+    } else {
+      *slice_end = '\0';
+    }
+    next = start;
+  }
 }
 
 static void lexer_ignore_comment(lexer_t* lexer, int comment_type)
@@ -5,9 +5,10 @@
 #include "parser.h"
 #include "vm.h"
 #include "gc.h"
+#include "sealc.h"
 
 #define USAGE(prog_name) (fprintf(stdout, "seal: usage: %s filename.seal\n", prog_name))
-#define PRINT_FLAGS() (fprintf(stderr, "seal: flags: -pt (print tokens), -pa (print AST), -po (print opcodes), -pb (print bytes), -pc (print constant pool)\n"))
+#define PRINT_FLAGS() (fprintf(stderr, "seal: flags: -pt (print tokens), -pa (print AST), -po (print opcodes), -pb (print bytes), -pc (print constant pool), -pq (print quickened sites), -pi (print inline cache statistics), -rb (register backend), -nc (no bytecode cache), -lc (lazy compilation of functions), -O0|-O1 (constant folding and peephole optimizations off|on), -md N (maximum call depth), --alloc=libc|pool (allocator of runtime objects)\n"))
 #define PRINT_VERSION() (fprintf(stdout, "Seal %s\n", VERSION))
 
 int main(int argc, char** argv)
@@ -28,6 +29,8 @@ int main(int argc, char** argv)
   bool PRINT_BYTE = false;
   bool PRINT_CONST_POOL = false;
   bool PRINT_STACK = false;
+  bool PRINT_QUICK = false;
+  bool PRINT_CACHES = false;
 
   for (int i = 2; i < argc; i++) {
     if (strcmp(argv[i], "-pt") == 0) {
@@ -42,29 +45,65 @@ int main(int argc, char** argv)
       PRINT_CONST_POOL = true;
     } else if (strcmp(argv[i], "-ps") == 0) {
       PRINT_STACK = true;
-    }
+    } else if (strcmp(argv[i], "-pq") == 0) {
+      PRINT_QUICK = true;
+      vm_trace_quickening(true);
+    } else if (strcmp(argv[i], "-pi") == 0) {
+      PRINT_CACHES = true;
+    } else if (strcmp(argv[i], "-rb") == 0) {
+      compiler_set_backend(BACKEND_REGISTER);
+    } else if (strcmp(argv[i], "-nc") == 0) {
+      sealc_enabled = false;
+    } else if (strcmp(argv[i], "-lc") == 0) {
+      compiler_set_lazy(true);
+    } else if (strcmp(argv[i], "-O0") == 0) {
+      compiler_set_opt_level(0);
+    } else if (strcmp(argv[i], "-O1") == 0) {
+      compiler_set_opt_level(1);
+    } else if (strcmp(argv[i], "-md") == 0) {
+      int depth = i + 1 < argc ? atoi(argv[++i]) : 0;
+      if (depth < 1) {
+        PRINT_FLAGS();
+        return EXIT_FAILURE;
+      }
+      vm_set_max_depth(depth);
+    } else if (strcmp(argv[i], "--alloc=libc") == 0) {
+      pool_enabled = false;
+    } else if (strcmp(argv[i], "--alloc=pool") == 0) {
+      pool_enabled = true;
+    } /* other arguments are left to the script */
   }
   const char* file_path = argv[1];
-  /* lexing */
-  ast_t* root;
-  lexer_t lexer;
-  init_lexer(&lexer, file_path);
-  lexer_get_tokens(&lexer);
-  if (PRINT_TOKS)
-    print_tokens(lexer.toks, lexer.tok_size);
-  /* parsing and generating abstract syntax tree (AST) */
-  
   create_const_asts(); /* allocate constant ASTs */
-  parser_t parser;
-  init_parser(&parser, &lexer);
-  root = parser_parse(&parser);
-  if (PRINT_AST)
-    print_ast(root);
 
   cout_t cout;
-  compile(&cout, root, parser.file_path);
+  struct sealc_key key = { 0 };
+  /* front end runs only if there is no fresh bytecode cache */
+  if (PRINT_TOKS || PRINT_AST || !sealc_load(&cout, file_path, &key)) {
+    /* lexing */
+    ast_t* root;
+    lexer_t lexer;
+    arena_t arena = { 0 };
+    front_arena = &arena; /* tokens and AST are dropped after compilation */
+    init_lexer(&lexer, file_path);
+    lexer_get_tokens(&lexer);
+    if (PRINT_TOKS)
+      print_tokens(lexer.toks, lexer.tok_size);
+    /* parsing and generating abstract syntax tree (AST) */
+    parser_t parser;
+    init_parser(&parser, &lexer);
+    root = parser_parse(&parser);
+    if (PRINT_AST)
+      print_ast(root);
+
+    compile(&cout, root, parser.file_path);
+    if (!cout.is_lazy)
+      arena_free(&arena); /* ast of lazy functions is kept */
+    front_arena = NULL;
+    sealc_save(&cout, file_path, &key); /* before bytecode is quickened */
+  }
   if (PRINT_OP)
-    print_op(cout.bc.bytecodes, cout.bc.size, cout.labels, cout.label_pool_size);
+    print_op(cout.bc.bytecodes, cout.bc.size);
   if (PRINT_BYTE)
     PRINT_BYTE(cout.bc.bytecodes, cout.bc.size)
   if (PRINT_CONST_POOL)
@@ -80,16 +119,16 @@ int main(int argc, char** argv)
     .locals = locals,
     .bytecodes = vm.bytecodes,
     .ip = vm.bytecodes,
-    .label_pool = cout.labels,
     .const_pool = cout.const_pool,
-    .globals = &vm.globals,
+    .globals = vm.globals,
+    .caches = cout.caches,
     .linfo = cout.bc.linfo,
     .linfo_size = cout.bc.l_size,
     .file_name = file_path,
+    .local_size = cout.main_scope_local_size,
   };
   /* add 'args' global variable as command line args' */
   svalue_t list_args = SEAL_VALUE_LIST();
-  gc_incref(list_args);
   for (int i = 1; i < argc; i++) {
     char *alloc_s = SEAL_CALLOC(strlen(argv[i]) + 1, sizeof(char));
     strcpy(alloc_s, argv[i]);
@@ -97,14 +136,18 @@ int main(int argc, char** argv)
     gc_incref(seal_str);
     LIST_PUSH(list_args, seal_str);
   }
-  hashmap_insert(&vm.globals, "args", list_args);
+  vm_set_global(&vm, "args", list_args);
 
   eval_vm(&vm, &main_frame);
   if (PRINT_STACK)
     print_stack(&vm);
+  if (PRINT_QUICK)
+    print_quickened();
+  if (PRINT_CACHES)
+    print_field_caches();
 
   //svalue_t func = hashmap_search(&vm.globals, "add")->val;
-  //print_op(func.as.func.as.userdef.bytecode, 36, cout.labels, 0);
+  //print_op(func.as.func.as.userdef.bytecode, 36);
 
   /* FREE EVERYTHING AFTER BEING USED */
   
@@ -9,18 +9,15 @@
 #define STR_EQ(s1, s2) (strcmp(s1, s2) == 0)
 
 #define MOD_REGISTER_FUNC(mod, _name, str, _argc, _is_vararg) do { \
-  svalue_t func = { \
-    .type = SEAL_FUNC, \
-    .as.func = { \
-      .type = FUNC_BUILTIN, \
-      .name = str, \
-      .is_vararg = _is_vararg, \
-      .as.builtin = { \
-        .cfunc = _name, \
-        .argc = _argc \
-      } \
+  svalue_t func = SEAL_VALUE_FUNC(((struct seal_func) { \
+    .type = FUNC_BUILTIN, \
+    .name = str, \
+    .is_vararg = _is_vararg, \
+    .as.builtin = { \
+      .cfunc = _name, \
+      .argc = _argc \
     } \
-  }; \
+  })); \
   hashmap_insert(AS_MOD(mod)->globals, str, func); \
 } while (0)
 
@@ -9,10 +9,10 @@
   parser->tok_size - 1)
 
 #define parser_eof(parser) ( \
-  parser->toks[parser->tok_size - 1])
+  &parser->toks[parser->tok_size - 1])
 
 #define parser_peek(parser) ( \
-  parser->toks[parser->i])
+  &parser->toks[parser->i])
 
 #define parser_match(parser, t) ( \
   parser_peek(parser)->type == t)
@@ -22,7 +22,7 @@
 
 #define parser_peek_offset(parser, offset) ( \
   (parser->i + (offset) >= 0 && parser->i + (offset) < parser->tok_size)\
-  ? parser->toks[parser->i + (offset)]\
+  ? &parser->toks[parser->i + (offset)]\
   : parser_eof(parser))
 
 #define is_lvalue(node) ( \
@@ -53,7 +53,7 @@ static inline void kill_if_duplicated_name(parser_t* parser,
 
 static inline token_t* parser_advance(parser_t* parser)
 {
-  return parser->toks[parser_is_end(parser) ? parser_eof_index(parser) : parser->i++];
+  return &parser->toks[parser_is_end(parser) ? parser_eof_index(parser) : parser->i++];
 }
 
 static inline token_t* parser_eat(parser_t* parser, int type)
@@ -105,14 +105,14 @@ static ast_t* parser_parse_statements(parser_t* parser,
   ast_t* ast = static_create_ast(AST_COMP, parser_line(parser));
 
   ast->comp.stmt_size = 1;
-  ast->comp.stmts = SEAL_CALLOC(1, sizeof(ast_t*));
+  ast->comp.stmts = SEAL_ARENA_ALLOC(sizeof(ast_t*));
   ast->comp.stmts[0] = parser_parse_statement(parser, is_func, is_ifelse, is_loop, false);
 
   while (!parser_is_end(parser) && parser_match(parser, TOK_NEWL)) {
     parser_eat(parser, TOK_NEWL);
 
     ast->comp.stmt_size++;
-    ast->comp.stmts = SEAL_REALLOC(ast->comp.stmts, ast->comp.stmt_size * sizeof(ast_t*));
+    ast->comp.stmts = SEAL_ARENA_GROW(ast->comp.stmts, ast->comp.stmt_size, sizeof(ast_t*));
     ast->comp.stmts[ast->comp.stmt_size - 1] = parser_parse_statement(parser, is_func, is_ifelse, is_loop, false);
   }
 
@@ -184,7 +184,7 @@ static inline ast_t* parser_parse_inline_statement(parser_t* parser, bool is_fun
 {
   ast_t* comp = static_create_ast(AST_COMP, parser_line(parser));
   comp->comp.stmt_size = 1;
-  comp->comp.stmts = SEAL_CALLOC(1, sizeof(ast_t));
+  comp->comp.stmts = SEAL_ARENA_ALLOC(sizeof(ast_t*));
   comp->comp.stmts[0] = parser_parse_statement(parser, is_func, is_ifelse, is_loop, true);
 
   return comp;
@@ -221,7 +221,7 @@ static ast_t* parser_parse_list(parser_t* parser)
   parser_eat(parser, TOK_LBRACK);
   if (!parser_match(parser, TOK_RBRACK)) {
     ast->list.mem_size = 1;
-    ast->list.mems = SEAL_CALLOC(1, sizeof(ast_t*));
+    ast->list.mems = SEAL_ARENA_ALLOC(sizeof(ast_t*));
     ast->list.mems[0] = parser_parse_expr(parser);
   }
   while (parser_match(parser, TOK_COMMA)) {
@@ -231,7 +231,7 @@ static ast_t* parser_parse_list(parser_t* parser)
       break;
 
     ast->list.mem_size++;
-    ast->list.mems = SEAL_REALLOC(ast->list.mems, ast->list.mem_size * sizeof(ast_t*));
+    ast->list.mems = SEAL_ARENA_GROW(ast->list.mems, ast->list.mem_size, sizeof(ast_t*));
     ast->list.mems[ast->list.mem_size - 1] = parser_parse_expr(parser);
   }
   parser_eat(parser, TOK_RBRACK);
@@ -250,12 +250,12 @@ static ast_t* parser_parse_map(parser_t* parser)
   if (!parser_match(parser, TOK_RBRACE)) {
     ast->map.field_size = 1;
     // field names
-    ast->map.field_names = SEAL_CALLOC(1, sizeof(char*));
+    ast->map.field_names = SEAL_ARENA_ALLOC(sizeof(char*));
     ast->map.field_names[0] = parser_eat(parser, TOK_ID)->val;
 
     parser_eat(parser, TOK_ASSIGN); // require '='
     // field vals
-    ast->map.field_vals = SEAL_CALLOC(1, sizeof(ast_t*));
+    ast->map.field_vals = SEAL_ARENA_ALLOC(sizeof(ast_t*));
     ast->map.field_vals[0] = parser_parse_expr(parser);
   }
   while (parser_match(parser, TOK_COMMA)) {
@@ -270,12 +270,12 @@ static ast_t* parser_parse_map(parser_t* parser)
 
     ast->map.field_size++;
     // field names
-    ast->map.field_names = SEAL_REALLOC(ast->map.field_names, ast->map.field_size * sizeof(char*));
+    ast->map.field_names = SEAL_ARENA_GROW(ast->map.field_names, ast->map.field_size, sizeof(char*));
     ast->map.field_names[ast->map.field_size - 1] = field_name;
 
     parser_eat(parser, TOK_ASSIGN); // require '='
     // field vals
-    ast->map.field_vals = SEAL_REALLOC(ast->map.field_vals, ast->map.field_size * sizeof(ast_t*));
+    ast->map.field_vals = SEAL_ARENA_GROW(ast->map.field_vals, ast->map.field_size, sizeof(ast_t*));
     ast->map.field_vals[ast->map.field_size - 1] = parser_parse_expr(parser);
   }
   parser_eat(parser, TOK_RBRACE);
@@ -305,7 +305,7 @@ static ast_t* parser_parse_func_call(parser_t* parser)
 
   if (!parser_match(parser, TOK_RPAREN)) {
     ast->func_call.arg_size = 1;
-    ast->func_call.args = SEAL_CALLOC(1, sizeof(ast_t*));
+    ast->func_call.args = SEAL_ARENA_ALLOC(sizeof(ast_t*));
     ast->func_call.args[0] = parser_parse_expr(parser);
   }
 
@@ -313,7 +313,7 @@ static ast_t* parser_parse_func_call(parser_t* parser)
     parser_eat(parser, TOK_COMMA);
 
     ast->func_call.arg_size++;
-    ast->func_call.args = SEAL_REALLOC(ast->func_call.args, ast->func_call.arg_size * sizeof(ast_t*));
+    ast->func_call.args = SEAL_ARENA_GROW(ast->func_call.args, ast->func_call.arg_size, sizeof(ast_t*));
     ast->func_call.args[ast->func_call.arg_size - 1] = parser_parse_expr(parser);
   }
 
@@ -479,7 +479,7 @@ static ast_t* parser_parse_func_def(parser_t* parser, bool can_be_global)
     }
 
     ast->func_def.param_size = 1;
-    ast->func_def.param_names = SEAL_CALLOC(1, sizeof(char*));
+    ast->func_def.param_names = SEAL_ARENA_ALLOC(sizeof(char*));
     ast->func_def.param_names[0] = parser_eat(parser, TOK_ID)->val;
   }
 
@@ -495,7 +495,7 @@ static ast_t* parser_parse_func_def(parser_t* parser, bool can_be_global)
     kill_if_duplicated_name(parser, param, ast->func_def.param_names, ast->func_def.param_size);
 
     ast->func_def.param_size++;
-    ast->func_def.param_names = SEAL_REALLOC(ast->func_def.param_names, ast->func_def.param_size * sizeof(char*));
+    ast->func_def.param_names = SEAL_ARENA_GROW(ast->func_def.param_names, ast->func_def.param_size, sizeof(char*));
     ast->func_def.param_names[ast->func_def.param_size - 1] = param;
   }
 
@@ -895,14 +895,14 @@ static ast_t* parser_parse_include(parser_t* parser)
     } else if (parser_match(parser, TOK_COLON)) {
       parser_advance(parser);
 
-      ast->include.symbols = SEAL_CALLOC(1, sizeof(char*));
+      ast->include.symbols = SEAL_ARENA_ALLOC(sizeof(char*));
       ast->include.symbols[0] = parser_eat(parser, TOK_ID)->val;
       ast->include.symbols_size = 1;
 
       while (parser_match(parser, TOK_COMMA)) {
         parser_advance(parser); /* comma */
 
-        ast->include.symbols = SEAL_REALLOC(ast->include.symbols, sizeof(char*) * ++ast->include.symbols_size);
+        ast->include.symbols = SEAL_ARENA_GROW(ast->include.symbols, ++ast->include.symbols_size, sizeof(char*));
         ast->include.symbols[ast->include.symbols_size - 1] = parser_eat(parser, TOK_ID)->val;
       }
     } else {
@@ -8,7 +8,7 @@
 
 typedef struct {
   const char* file_path;
-  token_t** toks;
+  token_t* toks;
   size_t tok_size;
   int i;
 } parser_t;
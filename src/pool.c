@@ -0,0 +1,31 @@
+#include "pool.h"
+
+bool pool_enabled = true;
+struct pool_block *pool_free_list[POOL_CLASSES];
+
+static char *slab, *slab_end;
+
+void *pool_refill(size_t cls)
+{
+  size_t size = (cls + 1) * POOL_GRAIN;
+  if (slab_end - slab < size) {
+    /* rest of old slab is too small for this class, it is left unused */
+    slab = SEAL_CALLOC(1, POOL_SLAB);
+    slab_end = slab + POOL_SLAB;
+  }
+  void *b = slab;
+  slab += size;
+  return b;
+}
+
+void *pool_realloc(void *ptr, size_t old, size_t size)
+{
+  if (!POOL_SMALL(old) && !POOL_SMALL(size))
+    return realloc(ptr, size);
+  if (POOL_SMALL(old) && POOL_SMALL(size) && POOL_CLASS(old) == POOL_CLASS(size))
+    return ptr;
+  void *res = pool_alloc(size);
+  memcpy(res, ptr, old < size ? old : size);
+  pool_free(ptr, old);
+  return res;
+}
@@ -0,0 +1,55 @@
+#ifndef SEAL_POOL_H
+#define SEAL_POOL_H
+
+#include "sealconf.h"
+
+/*
+ * size-class allocator for small runtime objects: string, list and map
+ * headers, short strings and members of short lists. blocks of a class are
+ * carved from slabs and recycled through its free list, slabs are kept
+ * until exit. caller passes size back when freeing, larger blocks and
+ * everything with --alloc=libc go to libc
+ */
+#define POOL_GRAIN   16
+#define POOL_MAX     256
+#define POOL_CLASSES (POOL_MAX / POOL_GRAIN)
+#define POOL_SLAB    (64 << 10)
+#define POOL_CLASS(size) (((size) - 1) / POOL_GRAIN)
+#define POOL_SMALL(size) (pool_enabled && (size) - 1 < POOL_MAX) /* zero size is not small */
+
+struct pool_block {
+  struct pool_block *next;
+};
+
+extern bool pool_enabled; /* decided before first allocation, never changes afterwards */
+extern struct pool_block *pool_free_list[POOL_CLASSES];
+
+void *pool_refill(size_t cls); /* returns zeroed block carved from slab */
+void *pool_realloc(void *ptr, size_t old, size_t size);
+
+/* zeroed like calloc */
+static inline void *pool_alloc(size_t size)
+{
+  if (!POOL_SMALL(size))
+    return calloc(1, size);
+  size_t cls = POOL_CLASS(size);
+  struct pool_block *b = pool_free_list[cls];
+  if (b == NULL)
+    return pool_refill(cls);
+  pool_free_list[cls] = b->next;
+  memset(b, 0, size);
+  return b;
+}
+
+static inline void pool_free(void *ptr, size_t size)
+{
+  if (!POOL_SMALL(size)) {
+    free(ptr);
+    return;
+  }
+  struct pool_block *b = ptr;
+  b->next = pool_free_list[POOL_CLASS(size)];
+  pool_free_list[POOL_CLASS(size)] = b;
+}
+
+#endif /* SEAL_POOL_H */
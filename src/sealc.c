@@ -0,0 +1,360 @@
+#include "sealc.h"
+#include "hashmap.h"
+#include "intern.h"
+#include "io.h"
+
+/*
+ * layout: header, symbol table, main chunk. every field is padded to 8
+ * bytes so that line info can be used in place.
+ * chunk: bytecode size, bytecode, line info size, line info, constant
+ * pool size, constants and number of field caches. constant: type and
+ * payload, function constant is followed by its own chunk
+ */
+struct sealc_header {
+  uint64_t magic;
+  char build[32];
+  uint64_t backend;
+  uint64_t opt_level;
+  struct sealc_key key;
+  uint64_t size; /* size of whole cache */
+};
+
+struct sealc_writer {
+  char *data;
+  size_t size, cap;
+};
+
+struct sealc_reader {
+  const char *cur, *end;
+  const char *file_name;
+  bool failed;
+};
+
+#define SEALC_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+bool sealc_enabled = true;
+
+static bool source_key(const char *path, struct sealc_key *key)
+{
+  size_t size;
+  const char *src = map_file(path, &size);
+  if (!src)
+    return false;
+  uint64_t hash = 0xcbf29ce484222325ULL; /* fnv-1a */
+  for (size_t i = 0; i < size; i++)
+    hash = (hash ^ (seal_byte)src[i]) * 0x100000001b3ULL;
+  unmap_file(src, size);
+  key->src_size = size;
+  key->src_hash = hash;
+  return true;
+}
+
+static char *cache_path(const char *path)
+{
+  size_t len = strlen(path);
+  char *res = SEAL_MALLOC(len + 2);
+  memcpy(res, path, len);
+  res[len] = 'c'; /* file.seal -> file.sealc */
+  res[len + 1] = '\0';
+  return res;
+}
+
+/* writing */
+
+static void put(struct sealc_writer *w, const void *src, size_t n)
+{
+  size_t padded = SEALC_ALIGN(n);
+  if (w->size + padded > w->cap) {
+    while (w->size + padded > w->cap)
+      w->cap = w->cap ? w->cap * 2 : 4096;
+    w->data = SEAL_REALLOC(w->data, w->cap);
+  }
+  memcpy(w->data + w->size, src, n);
+  memset(w->data + w->size + n, 0, padded - n);
+  w->size += padded;
+}
+
+static void put_u64(struct sealc_writer *w, uint64_t val)
+{
+  put(w, &val, sizeof(val));
+}
+
+static void put_str(struct sealc_writer *w, const char *str)
+{
+  size_t len = strlen(str);
+  put_u64(w, len);
+  put(w, str, len + 1);
+}
+
+static void put_chunk(struct sealc_writer *w, seal_byte *bytecode, size_t size,
+    struct line_info *linfo, int linfo_size, svalue_t *const_pool, size_t pool_size, size_t cache_size);
+
+static void put_const(struct sealc_writer *w, svalue_t val)
+{
+  put_u64(w, val.type);
+  switch (val.type) {
+    case SEAL_INT:
+      put_u64(w, val.as._int);
+      break;
+    case SEAL_FLOAT: {
+      uint64_t bits;
+      memcpy(&bits, &val.as._float, sizeof(bits));
+      put_u64(w, bits);
+      break;
+    }
+    case SEAL_BOOL:
+      put_u64(w, val.as._bool);
+      break;
+    case SEAL_STRING:
+      put_str(w, val.as.string->val);
+      break;
+    case SEAL_FUNC: {
+      struct seal_func *func = val.as.func;
+      put_u64(w, func->name != NULL);
+      if (func->name)
+        put_str(w, func->name);
+      put_u64(w, func->is_vararg);
+      put_u64(w, func->as.userdef.argc);
+      put_u64(w, func->as.userdef.local_size);
+      put_chunk(w, func->as.userdef.bytecode, func->as.userdef.bytecode_size,
+          func->as.userdef.linfo, func->as.userdef.linfo_size,
+          func->as.userdef.const_pool, func->as.userdef.const_pool_size, func->as.userdef.cache_size);
+      break;
+    }
+  }
+}
+
+static void put_chunk(struct sealc_writer *w, seal_byte *bytecode, size_t size,
+    struct line_info *linfo, int linfo_size, svalue_t *const_pool, size_t pool_size, size_t cache_size)
+{
+  put_u64(w, size);
+  put(w, bytecode, size);
+  put_u64(w, linfo_size);
+  put(w, linfo, linfo_size * sizeof(struct line_info));
+  put_u64(w, pool_size);
+  for (size_t i = 0; i < pool_size; i++)
+    put_const(w, const_pool[i]);
+  put_u64(w, cache_size);
+}
+
+void sealc_save(cout_t *cout, const char *path, const struct sealc_key *key)
+{
+  if (!sealc_enabled || key->src_hash == 0 || cout->is_lazy)
+    return; /* bodies of lazy functions are not compiled yet */
+  struct sealc_writer w = { 0 };
+  struct sealc_header header = {
+    .magic = SEALC_MAGIC,
+    .build = SEALC_BUILD,
+    .backend = compiler_backend(),
+    .opt_level = compiler_opt_level(),
+    .key = *key,
+  };
+  put(&w, &header, sizeof(header));
+
+  /* symbol table, entries are listed with their slots */
+  hashmap_t *symtab = &cout->symtab;
+  put_u64(&w, symtab->cap);
+  put_u64(&w, symtab->filled);
+  for (size_t i = 0; i < symtab->cap; i++) {
+    if (symtab->entries[i].key == NULL)
+      continue;
+    put_u64(&w, symtab->entries[i].val.as._int);
+    put_str(&w, symtab->entries[i].key);
+  }
+  put_u64(&w, cout->main_scope_local_size);
+  put_chunk(&w, cout->bc.bytecodes, cout->bc.size, cout->bc.linfo, cout->bc.l_size,
+      cout->const_pool, cout->const_pool_size, cout->cache_size);
+  ((struct sealc_header*)w.data)->size = w.size;
+
+  /* written under temporary name, readers never see partial cache */
+  char *cpath = cache_path(path);
+  char *tmp = SEAL_MALLOC(strlen(cpath) + 5);
+  sprintf(tmp, "%s.tmp", cpath);
+  FILE *f = fopen(tmp, "wb");
+  if (f) {
+    bool written = fwrite(w.data, 1, w.size, f) == w.size;
+    if (fclose(f) == 0 && written)
+      rename(tmp, cpath);
+    else
+      remove(tmp);
+  }
+  SEAL_FREE(tmp);
+  SEAL_FREE(cpath);
+  SEAL_FREE(w.data);
+}
+
+/* reading */
+
+static const void *get(struct sealc_reader *r, size_t n)
+{
+  size_t padded = SEALC_ALIGN(n);
+  if (r->failed || (size_t)(r->end - r->cur) < padded) {
+    r->failed = true;
+    return NULL;
+  }
+  const void *res = r->cur;
+  r->cur += padded;
+  return res;
+}
+
+static uint64_t get_u64(struct sealc_reader *r)
+{
+  const uint64_t *val = get(r, sizeof(uint64_t));
+  return val ? *val : 0;
+}
+
+static const char *get_str(struct sealc_reader *r)
+{
+  uint64_t len = get_u64(r);
+  const char *str = len < (uint64_t)(r->end - r->cur) ? get(r, len + 1) : NULL;
+  if (str == NULL || str[len] != '\0') {
+    r->failed = true;
+    return "";
+  }
+  return str;
+}
+
+static svalue_t *get_chunk(struct sealc_reader *r, seal_byte **bytecode, size_t *size,
+    struct line_info **linfo, int *linfo_size, size_t *pool_size, struct field_cache **caches, size_t *cache_size);
+
+static svalue_t get_const(struct sealc_reader *r)
+{
+  svalue_t val = SEAL_VALUE_NULL;
+  switch (get_u64(r)) {
+    case SEAL_NULL:
+      break;
+    case SEAL_INT:
+      val = SEAL_VALUE_INT((seal_int)get_u64(r));
+      break;
+    case SEAL_FLOAT: {
+      uint64_t bits = get_u64(r);
+      memcpy(&val.as._float, &bits, sizeof(bits));
+      val.type = SEAL_FLOAT;
+      break;
+    }
+    case SEAL_BOOL:
+      val = SEAL_VALUE_BOOL(get_u64(r) != 0);
+      break;
+    case SEAL_STRING:
+      val = SEAL_VALUE_STRING_INTERNED(get_str(r));
+      break;
+    case SEAL_FUNC: {
+      const char *name = get_u64(r) ? get_str(r) : NULL;
+      bool is_vararg = get_u64(r);
+      seal_byte argc = get_u64(r);
+      seal_byte local_size = get_u64(r);
+      seal_byte *bytecode;
+      struct line_info *linfo;
+      struct field_cache *caches = NULL;
+      size_t size, pool_size, cache_size = 0;
+      int linfo_size;
+      svalue_t *const_pool = get_chunk(r, &bytecode, &size, &linfo, &linfo_size, &pool_size, &caches, &cache_size);
+      val = SEAL_VALUE_FUNC(((struct seal_func) {
+        .type = FUNC_USERDEF,
+        .is_vararg = is_vararg,
+        .name = name,
+        .as.userdef = {
+          .bytecode = bytecode,
+          .bytecode_size = size,
+          .linfo = linfo,
+          .linfo_size = linfo_size,
+          .const_pool = const_pool,
+          .const_pool_size = pool_size,
+          .caches = caches,
+          .cache_size = cache_size,
+          .argc = argc,
+          .local_size = local_size,
+          .globals = NULL,
+          .file_name = r->file_name,
+        }
+      }));
+      break;
+    }
+    default:
+      r->failed = true;
+  }
+  return val;
+}
+
+static svalue_t *get_chunk(struct sealc_reader *r, seal_byte **bytecode, size_t *size,
+    struct line_info **linfo, int *linfo_size, size_t *pool_size, struct field_cache **caches, size_t *cache_size)
+{
+  *size = get_u64(r);
+  *bytecode = (seal_byte*)get(r, *size);
+  *linfo_size = get_u64(r);
+  *linfo = (struct line_info*)get(r, *linfo_size * sizeof(struct line_info));
+  *pool_size = get_u64(r);
+  if (r->failed || *pool_size > CONST_POOL_SIZE) {
+    r->failed = true;
+    return NULL;
+  }
+  svalue_t *const_pool = SEAL_CALLOC(*pool_size ? *pool_size : 1, sizeof(svalue_t));
+  for (size_t i = 0; i < *pool_size && !r->failed; i++)
+    const_pool[i] = get_const(r);
+  *cache_size = get_u64(r);
+  if (r->failed || *cache_size > 0xFFFF + 1) {
+    r->failed = true;
+    return const_pool;
+  }
+  /* caches start empty, they hold pointers of this run only */
+  *caches = SEAL_CALLOC(*cache_size ? *cache_size : 1, sizeof(struct field_cache));
+  return const_pool;
+}
+
+bool sealc_load(cout_t *cout, const char *path, struct sealc_key *key)
+{
+  key->src_hash = 0; /* no key, cache is not written */
+  if (!sealc_enabled || !source_key(path, key))
+    return false;
+
+  char *cpath = cache_path(path);
+  size_t size;
+  const char *data = map_file(cpath, &size);
+  SEAL_FREE(cpath);
+  if (!data)
+    return false;
+
+  const struct sealc_header *header = (const struct sealc_header*)data;
+  if (size < sizeof(*header) || header->magic != SEALC_MAGIC || header->size != size ||
+      strncmp(header->build, SEALC_BUILD, sizeof(header->build)) != 0 ||
+      header->backend != compiler_backend() || header->opt_level != (uint64_t)compiler_opt_level() ||
+      header->key.src_size != key->src_size || header->key.src_hash != key->src_hash) {
+    unmap_file(data, size);
+    return false;
+  }
+
+  struct sealc_reader r = {
+    .cur = data + SEALC_ALIGN(sizeof(*header)),
+    .end = data + size,
+    .file_name = path,
+  };
+  uint64_t cap = get_u64(&r);
+  uint64_t filled = get_u64(&r);
+  if (r.failed || filled >= cap || filled > GLOBAL_MAX || cap > 4 * GLOBAL_MAX) {
+    unmap_file(data, size);
+    return false;
+  }
+  hashmap_t *symtab = &cout->symtab;
+  hashmap_init(symtab, cap);
+  for (uint64_t i = 0; i < filled && !r.failed; i++) {
+    uint64_t slot = get_u64(&r);
+    const char *name = get_str(&r);
+    if (slot >= filled || !hashmap_insert(symtab, name, SEAL_VALUE_INT(slot)))
+      r.failed = true; /* names must be distinct, slots in range */
+  }
+  cout->main_scope_local_size = get_u64(&r);
+  cout->const_pool = get_chunk(&r, &cout->bc.bytecodes, &cout->bc.size,
+      &cout->bc.linfo, &cout->bc.l_size, &cout->const_pool_size, &cout->caches, &cout->cache_size);
+  if (r.failed) {
+    /* objects built so far are dropped, file is compiled from source */
+    unmap_file(data, size);
+    return false;
+  }
+  cout->bc.cap = cout->bc.size;
+  cout->bc.l_cap = cout->bc.l_size;
+  cout->file_name = path;
+  cout->is_lazy = false; /* everything in cache is compiled */
+  cout->skip_addr_offset_stack = cout->stop_addr_offset_stack = NULL;
+  cout->skip_size = cout->stop_size = 0;
+  return true;
+}
@@ -0,0 +1,28 @@
+#ifndef SEAL_SEALC_H
+#define SEAL_SEALC_H
+
+#include "sealconf.h"
+#include "compiler.h"
+
+/*
+ * on-disk cache of compiler output, 'file.seal' is cached in 'file.sealc'.
+ * cache is fresh if it was written by the same build of interpreter with
+ * the same backend and optimization level from source of the same size
+ * and hash. fresh cache is mapped privately and used in place: bytecode,
+ * line info and strings point into mapping, only constant pools and
+ * function objects are built
+ */
+#define SEALC_MAGIC 0x0a434c414553ULL /* "SEALC\n" */
+#define SEALC_BUILD VERSION " " __DATE__ " " __TIME__ /* bytecode may change with any build */
+
+struct sealc_key {
+  uint64_t src_size;
+  uint64_t src_hash;
+};
+
+extern bool sealc_enabled; /* cleared by -nc flag */
+
+bool sealc_load(cout_t*, const char* path, struct sealc_key*); /* fills key of source, true if cache was fresh */
+void sealc_save(cout_t*, const char* path, const struct sealc_key*); /* silently skipped if cache cannot be written */
+
+#endif /* SEAL_SEALC_H */
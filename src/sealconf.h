@@ -14,8 +14,48 @@
 #define SEAL_REALLOC(ptr, size) realloc(ptr, size)
 #define SEAL_FREE(ptr)          free(ptr)
 
+/* runtime objects freed by gc, caller knows their size (see pool.h) */
+#define SEAL_POOL_ALLOC(size)             pool_alloc(size)
+#define SEAL_POOL_REALLOC(ptr, old, size) pool_realloc(ptr, old, size)
+#define SEAL_POOL_FREE(ptr, size)         pool_free(ptr, size)
+
+/* tokens and ast, dropped after compilation (see arena.h) */
+#define SEAL_ARENA_ALLOC(size)            arena_alloc(front_arena, size)
+#define SEAL_ARENA_GROW(ptr, n, size)     arena_grow(front_arena, ptr, n, size)
+
+/*
+ * dispatch opcodes with computed goto (labels as values) instead of switch,
+ * each opcode handler jumps directly to the next one.
+ * only available with GCC and Clang, define as 0 to use portable switch loop
+ */
+#ifndef SEAL_THREADED_DISPATCH
+#if defined(__GNUC__) || defined(__clang__)
+#define SEAL_THREADED_DISPATCH 1
+#else
+#define SEAL_THREADED_DISPATCH 0
+#endif
+#endif
+
+/*
+ * compare 16 control bytes of hashmap group at once with SSE2 (see hashmap.h),
+ * define as 0 to use portable byte loop
+ */
+#ifndef SEAL_HASHMAP_SSE2
+#if defined(__SSE2__) || defined(_M_X64)
+#define SEAL_HASHMAP_SSE2 1
+#else
+#define SEAL_HASHMAP_SSE2 0
+#endif
+#endif
+
+/* seed of string hash, fixed so that maps list their entries in same order on every run */
+#ifndef SEAL_HASH_SEED
+#define SEAL_HASH_SEED 0x243f6a8885a308d3ULL
+#endif
+
 #define ERR_LEN 256
 #define LOCAL_MAX 255
+#define GLOBAL_MAX (0xFFFF + 1) /* globals are addressed by 16-bit slots */
 
 typedef long long seal_int;
 typedef double    seal_float;
@@ -2,6 +2,7 @@
 #define SEAL_TYPES_H
 
 #include "sealconf.h"
+#include "pool.h"
 
 #define SEAL_NULL        (1 << 0)    /* 00000001 */
 #define SEAL_INT         (1 << 1)    /* 00000010 */
@@ -13,6 +14,8 @@
 #define SEAL_FUNC        (1 << 7)    /* 10000000 */
 #define SEAL_MOD         (1 << 8)   /* 100000000 */
 #define SEAL_PTR         (1 << 9)  /* 1000000000 */
+#define SEAL_UNDEF       0         /* internal, value of unassigned global slot */
+#define SEAL_REFCOUNTED  (SEAL_STRING | SEAL_LIST | SEAL_MAP | SEAL_FUNC) /* heap objects starting with gc header */
 #define SEAL_NUMBER      (SEAL_INT | SEAL_FLOAT)    /* 00000110 */
 #define SEAL_ITERABLE    (SEAL_STRING | SEAL_LIST)  /* 00000110 */
 #define SEAL_ANY         (SEAL_NULL | SEAL_INT | SEAL_FLOAT | SEAL_STRING | \
@@ -22,6 +25,7 @@
 typedef int seal_type;
 typedef struct svalue svalue_t;
 typedef struct hashmap hashmap_t;
+struct lazy_def; /* see compiler.h */
 
 
 struct line_info {
@@ -29,7 +33,28 @@ struct line_info {
   int offset;
 };
 
+/* inline cache of field access site, see cached_map_field in vm.c */
+#define FIELD_CACHE_WAYS 4
+
+struct field_cache {
+  struct {
+    const void *owner; /* shape or hashmap entries of map, or module */
+    const char *key;   /* characters of interned key */
+    int slot;          /* index of field in owner */
+    int kind;          /* CACHE_SHAPE, CACHE_DICT or CACHE_MOD */
+  } ways[FIELD_CACHE_WAYS];
+  int size; /* filled ways */
+  int next; /* way to replace once all are filled */
+};
+
+/* first member of any reference counted object */
+struct gc_header {
+  int ref_count;   /* references from heap, stack and locals are not counted */
+  seal_byte flags; /* GC_IN_ZCT, GC_ROOTED */
+};
+
 struct seal_func {
+  struct gc_header gc;
   enum {
     FUNC_BUILTIN,
     FUNC_USERDEF
@@ -37,14 +62,18 @@ struct seal_func {
   union {
     struct {
       seal_byte *bytecode;
+      int bytecode_size;
       struct line_info *linfo;
       int linfo_size;
       svalue_t *const_pool;
-      seal_word *label_pool;
+      int const_pool_size;
       seal_byte  argc;
       seal_byte  local_size;
-      hashmap_t *globals;
+      svalue_t *globals; /* global slots of module */
       const char *file_name;
+      struct lazy_def *lazy; /* body to compile on first call, NULL once compiled */
+      struct field_cache *caches; /* one per field access site */
+      int cache_size;
     } userdef;
     struct {
       svalue_t (*cfunc)(seal_byte argc, svalue_t* argv);
@@ -56,41 +85,51 @@ struct seal_func {
 };
 
 struct seal_string {
+  struct gc_header gc;
   const char* val;
   int size;
-  int ref_count;
-  bool is_static;
+  unsigned int hash; /* valid if has_hash, see str_hash */
+  bool has_hash;
+  bool is_static;   /* never freed, count is kept only for uniformity */
+  bool is_pooled;   /* header and characters come from pool */
+  bool is_interned; /* unique among interned strings (see intern.h) */
 };
 
 struct seal_list {
+  struct gc_header gc;
   svalue_t *mems;
   size_t size;
   size_t cap;
-  int ref_count;
 };
 
 #define LIST_PUSH(s, e) do { \
   struct seal_list *l = AS_LIST(s); \
   if (l->size >= l->cap) { \
-    l->mems = SEAL_REALLOC(l->mems, sizeof(svalue_t) * (l->cap *= 2)); \
+    l->mems = SEAL_POOL_REALLOC(l->mems, sizeof(svalue_t) * l->cap, sizeof(svalue_t) * l->cap * 2); \
+    l->cap *= 2; \
   } \
   l->mems[l->size++] = e; \
 } while (0)
 
-typedef struct shashmap shashmap_t;
+struct seal_shape; /* see shape.h */
 
 struct seal_map {
-  shashmap_t *map;
-  int ref_count;
+  struct gc_header gc;
+  struct seal_shape *shape; /* NULL in dictionary mode */
+  svalue_t *slots;          /* values in key order of shape */
+  int cap;                  /* number of allocated slots */
+  hashmap_t *map;           /* entries in dictionary mode, keys are characters of interned strings or owned copies */
 };
 
+/* k is not in map yet */
 #define MAP_INSERT(s, k, v) do { \
-  shashmap_insert(AS_MAP(s)->map, k, v); \
+  *map_add_field(AS_MAP(s), k) = (v); \
 } while (0)
 
 
 struct seal_module {
-  hashmap_t *globals;
+  hashmap_t *globals; /* field name -> value, or -> slot index if slots are set */
+  svalue_t *slots;    /* global slots of seal modules, NULL for native ones */
   const char *name;
 };
 
@@ -106,95 +145,52 @@ struct svalue {
     seal_float  _float;
     struct seal_string *string;
     bool        _bool;
-    struct seal_func func;
+    struct seal_func *func;
     struct seal_list *list;
     struct seal_map *map;
     struct seal_module *mod;
-    struct seal_pointer ptr;
-  } as;
+    struct seal_pointer *ptr;
+    const char *name; /* name of unassigned global */
+    struct gc_header *gc; /* header of any reference counted object */
+  } as; /* payload is one word, larger objects live on heap */
 };
 
-struct sh_entry {
-  unsigned int hash;
-  const char* key;
-  svalue_t val;
-  bool is_tombstone;
-};
-
-typedef struct shashmap {
-  struct sh_entry* entries;
-  size_t cap;
-  size_t filled;
-} shashmap_t;
-
-static inline unsigned int shash_str(const char* key) {
-  unsigned int hash = 0;
-  while (*key)
-    hash = *key++ + (hash << 6) + (hash << 16) - hash;
-
-  return hash;
-}
-
-static inline void shashmap_init(shashmap_t* hashmap, size_t size)
+/* seeded multiply-xorshift over 8-byte words, strong enough for low bits to index hashmap */
+static inline unsigned int hash_bytes(const char* key, size_t size)
 {
-  hashmap->cap = size;
-  hashmap->filled = 0;
-  hashmap->entries = SEAL_CALLOC(size, sizeof(struct sh_entry));
-  for (int i = 0; i < size; i++) {
-    hashmap->entries[i].key = NULL;
-    hashmap->entries[i].is_tombstone = false;
+  uint64_t hash = SEAL_HASH_SEED ^ (size * 0x9e3779b97f4a7c15ULL);
+  uint64_t word;
+  for (; size >= 8; key += 8, size -= 8) {
+    memcpy(&word, key, 8);
+    hash = (hash ^ word) * 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 31;
   }
+  word = 0;
+  memcpy(&word, key, size);
+  hash = (hash ^ word) * 0x94d049bb133111ebULL;
+  hash ^= hash >> 29;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  return (unsigned int)(hash ^ (hash >> 32));
 }
 
-static inline struct sh_entry* shashmap_search(shashmap_t* hashmap, const char* key)
+/* hash of characters, computed once per string */
+static inline unsigned int str_hash(struct seal_string* str)
 {
-  unsigned int idx = shash_str(key) % hashmap->cap;
-  struct sh_entry* tombstone = NULL;
-
-  struct sh_entry* e;
-  unsigned int start_idx = idx;
-  do {
-    e = &hashmap->entries[idx];
-    if (e->key == NULL) {
-      if (e->is_tombstone) {
-        if (tombstone == NULL)
-          tombstone = e;
-      } else {
-        return tombstone != NULL ? tombstone : e;
-      }
-    } else if (strcmp(e->key, key) == 0) {
-      return e;
-    }
-    idx = (idx + 1) % hashmap->cap;
-  } while (idx != start_idx);
-
-  return NULL;
+  if (!str->has_hash) {
+    str->hash = hash_bytes(str->val, str->size);
+    str->has_hash = true;
+  }
+  return str->hash;
 }
 
-static inline bool shashmap_insert(shashmap_t* hashmap, const char* key, svalue_t val)
+/* distinct interned strings never compare characters */
+static inline bool str_equal(struct seal_string* l, struct seal_string* r)
 {
-  if (hashmap->filled >= hashmap->cap) {
-    printf("hashmap is full");
-    exit(1);
+  if (l == r)
+    return true;
+  if ((l->is_interned && r->is_interned) || l->size != r->size || str_hash(l) != str_hash(r))
     return false;
-  }
-
-  struct sh_entry* searched = shashmap_search(hashmap, key);
-  
-  struct sh_entry e = {
-    shash_str(key),
-    key,
-    val,
-    true
-  };
-
-  bool is_new = searched->key == NULL;
-  if (is_new)
-    hashmap->filled++;
-
-  *searched = e;
-
-  return is_new;
+  return memcmp(l->val, r->val, l->size) == 0;
 }
 
 #define AS_INT(val)    ((val).as._int)
@@ -202,11 +198,11 @@ static inline bool shashmap_insert(shashmap_t* hashmap, const char* key, svalue_
 #define AS_NUM(val)    (IS_INT(val) ? AS_INT(val) : AS_FLOAT(val))
 #define AS_STRING(_val) ((_val).as.string->val)
 #define AS_BOOL(val)   ((val).as._bool)
-#define AS_FUNC(val)   ((val).as.func)
+#define AS_FUNC(val)   (*(val).as.func)
 #define AS_LIST(val)   ((val).as.list)
 #define AS_MAP(val)    ((val).as.map)
 #define AS_MOD(val)    ((val).as.mod)
-#define AS_PTR(val)    ((val).as.ptr)
+#define AS_PTR(val)    (*(val).as.ptr)
 
 #define VAL_TYPE(val)  ((val).type)
 #define IS_NULL(val)   (VAL_TYPE(val) == SEAL_NULL)
@@ -220,6 +216,7 @@ static inline bool shashmap_insert(shashmap_t* hashmap, const char* key, svalue_
 #define IS_MAP(val)    (VAL_TYPE(val) == SEAL_MAP)
 #define IS_MOD(val)    (VAL_TYPE(val) == SEAL_MOD)
 #define IS_PTR(val)    (VAL_TYPE(val) == SEAL_PTR)
+#define IS_UNDEF(val)  (VAL_TYPE(val) == SEAL_UNDEF)
 
 
 #define sval(t, mem, val) (svalue_t) { .type = t, .as.mem = val }
@@ -229,7 +226,7 @@ static inline bool shashmap_insert(shashmap_t* hashmap, const char* key, svalue_
 #define SEAL_VALUE_INT(val)    sval(SEAL_INT, _int, val)
 #define SEAL_VALUE_FLOAT(val)  sval(SEAL_FLOAT, _float, val)
 #define SEAL_VALUE_BOOL(val)   sval(SEAL_BOOL, _bool, val)
-#define SEAL_VALUE_PTR(val, _name)    sval(SEAL_PTR, ptr, ((struct seal_pointer) {.ptr = val, .name = _name }))
+#define SEAL_VALUE_UNDEF(_name)       sval(SEAL_UNDEF, name, _name) /* keeps name for errors */
 
 
 static inline svalue_t SEAL_VALUE_STRING(const char* val)
@@ -241,43 +238,61 @@ static inline svalue_t SEAL_VALUE_STRING(const char* val)
   res.as.string->val = val;
   res.as.string->size = strlen(val);
   res.as.string->is_static = false;
-  res.as.string->ref_count = 0;
+  res.as.string->gc.ref_count = 0;
   return res;
 }
 
-static inline svalue_t SEAL_VALUE_STRING_STATIC(const char* val)
+/* string of size characters, caller fills characters through buf */
+static inline svalue_t SEAL_VALUE_STRING_POOLED(size_t size, char **buf)
 {
-  svalue_t res = SEAL_VALUE_STRING(val);
-  res.as.string->is_static = true;
+  svalue_t res = {
+    .type = SEAL_STRING,
+    .as.string = SEAL_POOL_ALLOC(sizeof(struct seal_string))
+  };
+  res.as.string->val = *buf = SEAL_POOL_ALLOC(size + 1);
+  res.as.string->size = size;
+  res.as.string->is_pooled = true;
   return res;
 }
 
-static inline svalue_t SEAL_VALUE_LIST()
+/* function objects are owned by constant pool or module defining them, so start with one reference */
+static inline svalue_t SEAL_VALUE_FUNC(struct seal_func func)
 {
   svalue_t res = {
-    .type = SEAL_LIST,
-    .as.list = SEAL_CALLOC(1, sizeof(struct seal_list))
+    .type = SEAL_FUNC,
+    .as.func = SEAL_MALLOC(sizeof(struct seal_func))
   };
-  AS_LIST(res)->ref_count = 0;
-  AS_LIST(res)->cap = 2;
-  AS_LIST(res)->size = 0;
-  AS_LIST(res)->mems = SEAL_CALLOC(AS_LIST(res)->cap, sizeof(svalue_t));
+  *res.as.func = func;
+  AS_FUNC(res).gc = (struct gc_header) { .ref_count = 1 };
   return res;
 }
 
+/* pointers are not reference counted, modules release what they point to */
+static inline svalue_t SEAL_VALUE_PTR(void *val, const char *name)
+{
+  svalue_t res = {
+    .type = SEAL_PTR,
+    .as.ptr = SEAL_MALLOC(sizeof(struct seal_pointer))
+  };
+  AS_PTR(res).ptr = val;
+  AS_PTR(res).name = name;
+  return res;
+}
 
-static inline svalue_t SEAL_VALUE_MAP()
+static inline svalue_t SEAL_VALUE_LIST()
 {
   svalue_t res = {
-    .type = SEAL_MAP,
-    .as.map = SEAL_CALLOC(1, sizeof(struct seal_map)),
+    .type = SEAL_LIST,
+    .as.list = SEAL_POOL_ALLOC(sizeof(struct seal_list))
   };
-  AS_MAP(res)->map = SEAL_CALLOC(1, sizeof(shashmap_t));
-  AS_MAP(res)->ref_count = 0;
-  shashmap_init(res.as.map->map, 256);
+  AS_LIST(res)->gc.ref_count = 0;
+  AS_LIST(res)->cap = 2;
+  AS_LIST(res)->size = 0;
+  AS_LIST(res)->mems = SEAL_POOL_ALLOC(AS_LIST(res)->cap * sizeof(svalue_t));
   return res;
 }
 
+
 static inline const char*
 seal_type_name(int type)
 {
@@ -0,0 +1,73 @@
+#include "shape.h"
+
+struct seal_shape shape_empty = { 0 };
+
+static struct seal_shape *shape_child(struct seal_shape *shape, const char *key)
+{
+  for (struct seal_shape *child = shape->children; child != NULL; child = child->sibling)
+    if (child->keys[shape->size] == key)
+      return child;
+  if (shape->size >= SHAPE_MAX_KEYS || shape->child_size >= SHAPE_MAX_TRANSITIONS)
+    return NULL;
+
+  struct seal_shape *child = SEAL_CALLOC(1, sizeof(struct seal_shape));
+  child->parent = shape;
+  child->size = shape->size + 1;
+  child->keys = SEAL_MALLOC(child->size * sizeof(const char*));
+  if (shape->size > 0) /* keys of empty shape are NULL */
+    memcpy(child->keys, shape->keys, shape->size * sizeof(const char*));
+  child->keys[shape->size] = key;
+  child->sibling = shape->children;
+  shape->children = child;
+  shape->child_size++;
+  return child;
+}
+
+void map_to_dict(struct seal_map *map)
+{
+  struct seal_shape *shape = map->shape;
+  hashmap_t *dict = SEAL_POOL_ALLOC(sizeof(hashmap_t));
+  hashmap_init(dict, shape->size + 1);
+  for (int i = 0; i < shape->size; i++)
+    hashmap_insert(dict, shape->keys[i], map->slots[i]);
+  if (map->cap > 0)
+    SEAL_POOL_FREE(map->slots, map->cap * sizeof(svalue_t));
+  map->shape = NULL;
+  map->slots = NULL;
+  map->cap = 0;
+  map->map = dict;
+}
+
+svalue_t *map_add_field(struct seal_map *map, struct seal_string *key)
+{
+  struct seal_string *interned = str_find_interned(key);
+  struct seal_shape *child = map->shape != NULL && interned != NULL ? shape_child(map->shape, interned->val) : NULL;
+  if (child == NULL) {
+    if (map->shape != NULL)
+      map_to_dict(map);
+    struct h_entry *e = hashmap_search_str(map->map, key);
+    if (interned != NULL)
+      return &hashmap_insert_hash(map->map, e, interned->val, str_hash(key), SEAL_VALUE_NULL)->val;
+
+    /* key computed at runtime is not interned, map keeps its own copy */
+    char *copy = SEAL_MALLOC(key->size + 1);
+    memcpy(copy, key->val, key->size);
+    copy[key->size] = '\0';
+    e = hashmap_insert_hash(map->map, e, copy, str_hash(key), SEAL_VALUE_NULL);
+    e->owns_key = true;
+    return &e->val;
+  }
+
+  if (child->size > map->cap) {
+    int cap = map->cap ? 2 * map->cap : 2;
+    if (cap > SHAPE_MAX_KEYS)
+      cap = SHAPE_MAX_KEYS;
+    map->slots = map->cap > 0
+      ? SEAL_POOL_REALLOC(map->slots, map->cap * sizeof(svalue_t), cap * sizeof(svalue_t))
+      : SEAL_POOL_ALLOC(cap * sizeof(svalue_t));
+    map->cap = cap;
+  }
+  map->shape = child;
+  map->slots[child->size - 1] = SEAL_VALUE_NULL;
+  return &map->slots[child->size - 1];
+}
@@ -0,0 +1,129 @@
+#ifndef SEAL_SHAPE_H
+#define SEAL_SHAPE_H
+
+#include "sealconf.h"
+#include "sealtypes.h"
+#include "hashmap.h"
+#include "intern.h"
+
+/*
+ * hidden classes of maps used as records. shape lists keys of map in
+ * insertion order and values live in dense slot array in same order, so
+ * maps built with same keys in same order share one shape. adding key
+ * moves map to child shape, children are transitions of parent that are
+ * found by key. keys are characters of interned strings and are compared
+ * by pointer. shapes are never freed, so key that is not interned (computed
+ * at runtime) never gets shape, map moves to dictionary mode and owns copy
+ * of it.
+ * map with more than SHAPE_MAX_KEYS keys, or whose shape has too many
+ * transitions already (map is used as dictionary), keeps its entries in
+ * hashmap instead (dictionary mode) and never gets shape again
+ */
+#define SHAPE_MAX_KEYS        16
+#define SHAPE_MAX_TRANSITIONS 32
+
+struct seal_shape {
+  struct seal_shape *parent;
+  struct seal_shape *children; /* transitions, linked through sibling */
+  struct seal_shape *sibling;
+  const char **keys;           /* keys in slot order, last one is added by this shape */
+  int size;                    /* number of keys */
+  int child_size;
+};
+
+extern struct seal_shape shape_empty; /* root of every shape tree */
+
+svalue_t *map_add_field(struct seal_map *map, struct seal_string *key); /* returns slot for new key */
+void map_to_dict(struct seal_map *map); /* moves fields to hashmap */
+static struct seal_shape *shape_child(struct seal_shape *shape, const char *key); /* NULL if shape cannot grow */
+
+/* size keys fit without growing */
+static inline svalue_t SEAL_VALUE_MAP(size_t size)
+{
+  svalue_t res = {
+    .type = SEAL_MAP,
+    .as.map = SEAL_POOL_ALLOC(sizeof(struct seal_map)),
+  };
+  AS_MAP(res)->gc.ref_count = 0;
+  if (size > SHAPE_MAX_KEYS) {
+    AS_MAP(res)->map = SEAL_POOL_ALLOC(sizeof(hashmap_t));
+    hashmap_init(AS_MAP(res)->map, size);
+    return res;
+  }
+  AS_MAP(res)->shape = &shape_empty;
+  AS_MAP(res)->cap = size;
+  AS_MAP(res)->slots = size > 0 ? SEAL_POOL_ALLOC(size * sizeof(svalue_t)) : NULL;
+  return res;
+}
+
+/* value of key, NULL if map has no such key */
+static inline svalue_t *map_field(struct seal_map *map, struct seal_string *key)
+{
+  if (map->shape == NULL) {
+    struct h_entry *e = hashmap_search_str(map->map, key);
+    return e->key != NULL ? &e->val : NULL;
+  }
+  /* every key of shape is interned, string that is not cannot be among them */
+  if (!key->is_interned && (key = str_find_interned(key)) == NULL)
+    return NULL;
+  const char **keys = map->shape->keys;
+  for (int i = 0; i < map->shape->size; i++)
+    if (keys[i] == key->val)
+      return &map->slots[i];
+  return NULL;
+}
+
+static inline size_t map_size(struct seal_map *map)
+{
+  return map->shape != NULL ? map->shape->size : map->map->filled;
+}
+
+/* fields are visited with map_at for indices below map_end */
+static inline size_t map_end(struct seal_map *map)
+{
+  return map->shape != NULL ? map->shape->size : map->map->cap;
+}
+
+/* value at index, NULL if index holds no field. key is stored if not NULL */
+static inline svalue_t *map_at(struct seal_map *map, size_t i, const char **key)
+{
+  if (map->shape != NULL) {
+    if (key != NULL)
+      *key = map->shape->keys[i];
+    return &map->slots[i];
+  }
+  struct h_entry *e = &map->map->entries[i];
+  if (e->key == NULL)
+    return NULL;
+  if (key != NULL)
+    *key = e->key;
+  return &e->val;
+}
+
+/* bytes of map that are freed with it */
+static inline size_t map_bytes(struct seal_map *map)
+{
+  if (map->shape != NULL)
+    return sizeof(struct seal_map) + map->cap * sizeof(svalue_t);
+  return sizeof(struct seal_map) + sizeof(hashmap_t) + hashmap_bytes(map->map);
+}
+
+/* map is left empty, header stays */
+static inline void map_free_body(struct seal_map *map)
+{
+  if (map->shape == NULL) {
+    for (size_t i = 0; i < map->map->cap; i++)
+      if (map->map->entries[i].key != NULL && map->map->entries[i].owns_key)
+        SEAL_FREE((char*)map->map->entries[i].key);
+    hashmap_free(map->map);
+    SEAL_POOL_FREE(map->map, sizeof(hashmap_t));
+    map->map = NULL;
+  } else if (map->cap > 0) {
+    SEAL_POOL_FREE(map->slots, map->cap * sizeof(svalue_t));
+  }
+  map->shape = &shape_empty;
+  map->slots = NULL;
+  map->cap = 0;
+}
+
+#endif /* SEAL_SHAPE_H */
@@ -2,6 +2,7 @@
 #define SEAL_TOKEN_H
 
 #include "sealconf.h"
+#include "arena.h"
 
 enum {
   TOK_EOF     ,   /* "end of file" */
@@ -86,8 +87,9 @@ enum {
 
 typedef struct {
   int type;
-  const char* val;
   int line;
+  int len; /* length of slice, 0 if val is name of token */
+  const char* val; /* name of token or slice of source, terminated after lexing */
 } token_t;
 
 static inline const char* token_type_name(int type)
@@ -244,22 +246,36 @@ static inline const char* htoken_type_name(int type)
   }
 }
 
-static inline token_t* create_token(int type, const char* val, int line)
+static inline token_t create_token(int type, const char* val, int line)
 {
-  token_t* tok = (token_t*)SEAL_MALLOC(sizeof(token_t));
+  token_t tok;
 
-  tok->type = type;
-  tok->val  = val == NULL ? htoken_type_name(type) : val;
-  tok->line = line;
+  tok.type = type;
+  tok.val  = val == NULL ? htoken_type_name(type) : val;
+  tok.len  = 0;
+  tok.line = line;
 
   return tok;
 }
 
-static void print_tokens(token_t** tokens, size_t token_size)
+/* token whose value is slice of source */
+static inline token_t create_slice_token(int type, const char* val, int len, int line)
+{
+  token_t tok;
+
+  tok.type = type;
+  tok.val  = val;
+  tok.len  = len;
+  tok.line = line;
+
+  return tok;
+}
+
+static void print_tokens(token_t* tokens, size_t token_size)
 {
   printf("token size: %zu\ntokens:\n", token_size);
   for (int i = 0; i < token_size; i++) {
-    token_t* tok = tokens[i];
+    token_t* tok = &tokens[i];
     printf("%d, %s, %s\n", tok->line, htoken_type_name(tok->type), tok->val);
   }
 }
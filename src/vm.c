@@ -1,7 +1,10 @@
 #include "vm.h"
 #include "builtins.h"
 #include "gc.h"
+#include "intern.h"
+#include "shape.h"
 #include "parser.h"
+#include "sealc.h"
 #ifdef _WIN32
 #include <windows.h>
 #else
@@ -9,28 +12,52 @@
 #endif
 
 #define FETCH(lf) (*lf->ip++)
+
+/* returns source line of instruction being executed in frame */
+static int frame_line(struct local_frame *lf)
+{
+  int i = -1, line = -1;
+  while (++i < lf->linfo_size) {
+    if (lf->ip - 1 - lf->bytecodes < lf->linfo[i].offset) /* ip is already past opcode */
+      break;
+    line = lf->linfo[i].line;
+  }
+  return line;
+}
+
+/* opcode dispatching */
+#if SEAL_THREADED_DISPATCH
+#define VM_DISPATCH()  goto *dispatch_table[op = FETCH(lf)]
+#define VM_LOOP        VM_DISPATCH();
+#define VM_CASE(opc)   L_##opc
+#define VM_DEFAULT     L_DEFAULT
+#define VM_NEXT()      VM_DISPATCH()
+#else
+#define VM_LOOP        for (;;) switch (op = FETCH(lf))
+#define VM_CASE(opc)   case opc
+#define VM_DEFAULT     default
+#define VM_NEXT()      break
+#endif
+
+/* references on stack are not counted, dropped ones are released */
 #define PUSH(vm, val) do { \
+  svalue_t pushed = (val); /* val may read or pop stack itself */ \
   if (vm->sp - vm->stack == STACK_SIZE) \
     VM_ERROR("stack overflow"); \
-  svalue_t loc_val = val; \
-  *vm->sp++ = loc_val; \
-  gc_incref(loc_val); \
+  *vm->sp = pushed; \
+  vm->sp++; \
 } while (0)
 #define DUP(vm) do { \
   svalue_t top = *(vm->sp - 1); \
   PUSH(vm, top); \
 } while (0)
 #define POP(vm) (*(--(vm->sp)))
-#define JUMP(lf, addr) (lf->ip = &lf->bytecodes[lf->label_pool[addr]])
+#define FETCH_JUMP_S(lf) ((int8_t)FETCH(lf)) /* 8-bit relative offset */
+#define FETCH_JUMP_L(lf) (lf->ip += 4, (int32_t)((uint32_t)lf->ip[-4] << 24 | lf->ip[-3] << 16 | lf->ip[-2] << 8 | lf->ip[-1]))
+#define JUMP(lf, offs) (lf->ip += (offs)) /* offset is relative to end of jump instruction */
 #define GET_CONST(lf, i) (lf->const_pool[i])
 #define VM_ERROR(...) do { \
-  int ___i = -1, ___line = -1; \
-  while (++___i < lf->linfo_size) { \
-    if (lf->ip - lf->bytecodes < lf->linfo[___i].offset) \
-      break; \
-    ___line = lf->linfo[___i].line; \
-  } \
-  fprintf(stderr, "seal: file: \'%s\', line %d\n", lf->file_name, ___line); \
+  fprintf(stderr, "seal: file: \'%s\', line %d\n", lf->file_name, frame_line(lf)); \
   fprintf(stderr, __VA_ARGS__); \
   fprintf(stderr, "\n"); \
   exit(EXIT_FAILURE); \
@@ -55,7 +82,7 @@
   IS_STRING(val) ? val.as.string->size > 0 : \
   IS_BOOL(val) ? AS_BOOL(val) : \
   IS_LIST(val) ? AS_LIST(val)->size > 0 : \
-  IS_MAP(val) ? AS_MAP(val)->map->filled > 0 : \
+  IS_MAP(val) ? map_size(AS_MAP(val)) > 0 : \
   IS_FUNC(val) ? true : \
   IS_MOD(val) ? true : \
   IS_PTR(val) ? AS_PTR(val).ptr != NULL : \
@@ -75,16 +102,11 @@
 /* string manipulation */
 struct seal_string* str_concat(const char* l, const char* r)
 {
-  int len = strlen(l) + strlen(r) + 1;
-  char* res = SEAL_CALLOC(len, sizeof(char));
-  strcpy(res, l);
-  strcat(res, r);
-  res[len - 1] = '\0';
-  struct seal_string *str = SEAL_CALLOC(1, sizeof(struct seal_string));
-  str->size = len - 1;
-  str->is_static = false;
-  str->ref_count = 0;
-  str->val = res;
+  size_t llen = strlen(l), rlen = strlen(r);
+  char* res;
+  struct seal_string *str = SEAL_VALUE_STRING_POOLED(llen + rlen, &res).as.string;
+  memcpy(res, l, llen);
+  memcpy(res + llen, r, rlen + 1);
   return str;
 }
 
@@ -99,7 +121,7 @@ struct seal_string* str_concat(const char* l, const char* r)
     BIN_OP_INT(vm, left, right, op); \
   else if (IS_FLOAT(left) && IS_FLOAT(right)) \
     BIN_OP_FLOAT(vm, left, right, op); \
-  else if (IS_INT(left) && IS_FLOAT(right) || IS_FLOAT(left) && IS_INT(right)) \
+  else if ((IS_INT(left) && IS_FLOAT(right)) || (IS_FLOAT(left) && IS_INT(right))) \
     BIN_OP_INT_AND_FLOAT(vm, left, right, op); \
   else if (IS_STRING(left) && IS_STRING(right)) \
     PUSH_STRING(vm, str_concat(AS_STRING(left), AS_STRING(right))); \
@@ -123,11 +145,11 @@ struct seal_string* str_concat(const char* l, const char* r)
 } while (0)
 
 /* equality */
-#define EQUAL_OP_STRING(vm, left, right, op) PUSH_BOOL(vm, strcmp(AS_STRING(left), AS_STRING(right)) op 0)
+#define EQUAL_OP_STRING(vm, left, right, op) PUSH_BOOL(vm, str_equal(left.as.string, right.as.string) op true)
 #define EQUAL_OP_BOOL(vm, left, right, op)   PUSH_BOOL(vm, AS_BOOL(left) op AS_BOOL(right))
 #define EQUAL_OP_INT(vm, left, right, op)    PUSH_BOOL(vm, AS_INT(left) op AS_INT(right))
 #define EQUAL_OP_FLOAT(vm, left, right, op)  PUSH_BOOL(vm, AS_FLOAT(left) op AS_FLOAT(right))
-#define EQUAL_OP_MAP(vm, left, right, op)    PUSH_BOOL(vm, AS_MAP(left)->map op AS_MAP(right)->map)
+#define EQUAL_OP_MAP(vm, left, right, op)    PUSH_BOOL(vm, AS_MAP(left) op AS_MAP(right))
 #define EQUAL_OP_NULL(vm, left, right, op)   PUSH_BOOL(vm, VAL_TYPE(left) op VAL_TYPE(right))
 #define EQUAL_OP_INT_AND_FLOAT(vm, left, right, op) \
   PUSH_BOOL(vm, (IS_INT(left) ? AS_INT(left) : AS_FLOAT(left)) op (IS_INT(right) ? AS_INT(right) : AS_FLOAT(right)))
@@ -137,7 +159,7 @@ struct seal_string* str_concat(const char* l, const char* r)
     EQUAL_OP_INT(vm, left, right, op); \
   else if (IS_FLOAT(left) && IS_FLOAT(right)) \
     EQUAL_OP_FLOAT(vm, left, right, op); \
-  else if (IS_INT(left) && IS_FLOAT(right) || IS_FLOAT(left) && IS_INT(right)) \
+  else if ((IS_INT(left) && IS_FLOAT(right)) || (IS_FLOAT(left) && IS_INT(right))) \
     EQUAL_OP_INT_AND_FLOAT(vm, left, right, op); \
   else if (IS_STRING(left) && IS_STRING(right)) \
     EQUAL_OP_STRING(vm, left, right, op); \
@@ -162,12 +184,43 @@ struct seal_string* str_concat(const char* l, const char* r)
     CMP_OP_INT(vm, left, right, op); \
   else if (IS_FLOAT(left) && IS_FLOAT(right)) \
     CMP_OP_FLOAT(vm, left, right, op); \
-  else if (IS_INT(left) && IS_FLOAT(right) || IS_FLOAT(left) && IS_INT(right)) \
+  else if ((IS_INT(left) && IS_FLOAT(right)) || (IS_FLOAT(left) && IS_INT(right))) \
     CMP_OP_INT_AND_FLOAT(vm, left, right, op); \
   else \
     ERROR_BIN_OP(op, left, right); \
 } while (0)
 
+/* compare local with integer constant, jump if result is false */
+#define CMP_LOCAL_INT_JFALSE(vm, lf, left, right, jmp, op, GENERIC_OP, FETCH_JUMP) do { \
+  GC_SAFE_POINT(); /* threaded jumps may go backward */ \
+  left = GET_LOCAL(lf, FETCH(lf)); \
+  right = SEAL_VALUE_INT(FETCH(lf) << 8); \
+  AS_INT(right) |= FETCH(lf); \
+  jmp = FETCH_JUMP(lf); \
+  if (IS_INT(left)) { \
+    if (!(AS_INT(left) op AS_INT(right))) \
+      JUMP(lf, jmp); \
+  } else { \
+    GENERIC_OP(vm, left, right, op); \
+    if (!AS_BOOL(POP(vm))) \
+      JUMP(lf, jmp); \
+  } \
+} while (0)
+
+/*
+ * quickening, generic opcode of one byte rewrites itself into a variant
+ * specialized for types of its operands. variant whose guard fails
+ * rewrites itself into polymorphic opcode, which runs generic code but
+ * never quickens again, so site seeing several types is not rewritten
+ * on every change of type
+ */
+#define QUICKEN(lf, qop) do { \
+  lf->ip[-1] = (qop); \
+  if (trace_quick) \
+    record_quick_site(lf); \
+} while (0)
+#define DEQUICKEN(lf, gop) (lf->ip[-1] = (gop))
+
 /* unary */
 #define UNRY_OP(vm, val, op) do { \
   switch (op) { \
@@ -188,6 +241,9 @@ struct seal_string* str_concat(const char* l, const char* r)
   case OP_NOT: \
     PUSH_BOOL(vm, !(TO_BOOL(val))); \
     break; \
+  default: \
+    VM_ERROR("internal error: %s is not a unary operator", op_name(op)); \
+    break; \
   } \
 } while (0)
 
@@ -195,23 +251,66 @@ struct seal_string* str_concat(const char* l, const char* r)
 #define GET_LOCAL(lf, slot) (lf->locals[slot])
 #define SET_LOCAL(lf, slot, val) (lf->locals[slot] = val)
 
-/* initialization */
-#define REGISTER_BUILTIN_FUNC(map, _name, str, _argc, _is_vararg) do { \
-  svalue_t func = { \
-    .type = SEAL_FUNC, \
-    .as.func = { \
-      .type = FUNC_BUILTIN, \
-      .name = str, \
-      .is_vararg = _is_vararg, \
-      .as.builtin = { \
-        .cfunc = _name, \
-        .argc = _argc \
-      } \
+/* registers (local slots used by register backend) */
+#define REG(lf, r) (lf->locals[r])
+#define SET_REG(lf, r, val) do { \
+  svalue_t ___val = val; \
+  gc_release(REG(lf, r)); \
+  REG(lf, r) = ___val; \
+} while (0)
+#define POP_REG(vm, lf, r) SET_REG(lf, r, POP(vm)) /* moves value on top of stack into register */
+
+/* R(d) = R(a) op R(b), result of GENERIC_OP is moved from stack */
+#define REG_BIN_OP(vm, lf, left, right, idx, op, GENERIC_OP, VALUE) do { \
+  idx = FETCH(lf); \
+  left  = REG(lf, FETCH(lf)); \
+  right = REG(lf, FETCH(lf)); \
+  if (IS_INT(left) && IS_INT(right)) { \
+    gc_release(REG(lf, idx)); \
+    REG(lf, idx) = VALUE(AS_INT(left) op AS_INT(right)); \
+  } else { \
+    GENERIC_OP(vm, left, right, op); \
+    POP_REG(vm, lf, idx); \
+  } \
+} while (0)
+
+/* compare two registers, jump if result is false */
+#define REG_CMP_JFALSE(vm, lf, left, right, jmp, op, GENERIC_OP, FETCH_JUMP) do { \
+  GC_SAFE_POINT(); /* threaded jumps may go backward */ \
+  left  = REG(lf, FETCH(lf)); \
+  right = REG(lf, FETCH(lf)); \
+  jmp = FETCH_JUMP(lf); \
+  if (IS_INT(left) && IS_INT(right)) { \
+    if (!(AS_INT(left) op AS_INT(right))) \
+      JUMP(lf, jmp); \
+  } else { \
+    GENERIC_OP(vm, left, right, op); \
+    if (!AS_BOOL(POP(vm))) \
+      JUMP(lf, jmp); \
+  } \
+} while (0)
+
+/* initialization, builtins are also kept by name for globals added by lazy compilation */
+#define REGISTER_BUILTIN_FUNC(vm, _name, str, _argc, _is_vararg) do { \
+  svalue_t func = SEAL_VALUE_FUNC(((struct seal_func) { \
+    .type = FUNC_BUILTIN, \
+    .name = str, \
+    .is_vararg = _is_vararg, \
+    .as.builtin = { \
+      .cfunc = _name, \
+      .argc = _argc \
     } \
-  }; \
-  hashmap_insert(map, str, func); \
+  })); \
+  vm_set_global(vm, str, func); \
+  struct h_entry *e = hashmap_search(&builtins, str); \
+  if (e->key == NULL) { \
+    gc_incref(func); \
+    hashmap_insert_e(&builtins, e, str, func); \
+  } \
 } while (0)
 
+static hashmap_t builtins;
+
 static hashmap_t mod_cache;
 
 void init_mod_cache()
@@ -219,49 +318,169 @@ void init_mod_cache()
   hashmap_init(&mod_cache, 256);
 }
 
-static void set_all_functions_global(hashmap_t *globals)
+/* returns field of module, NULL if it does not exist */
+static svalue_t *mod_field(struct seal_module *mod, struct seal_string *name)
 {
-  for (int i = 0; i < globals->cap; i++) {
-    struct h_entry *e = &globals->entries[i];
-    if (e->key && IS_FUNC(e->val) && IS_USERDEF_FUNC(e->val)) {
-      AS_USERDEF_FUNC(e->val).globals = globals;
-    }
+  struct h_entry *e = hashmap_search_str(mod->globals, name);
+  if (e->key == NULL)
+    return NULL;
+  if (mod->slots == NULL)
+    return &e->val;
+
+  svalue_t *val = &mod->slots[e->val.as._int];
+  return IS_UNDEF(*val) ? NULL : val;
+}
+
+/*
+ * inline caches, every field access site remembers where it found fields
+ * of last FIELD_CACHE_WAYS owners it has seen. way of shaped map is valid
+ * forever as shapes are never freed or changed. way of dictionary is
+ * checked against key of entry, as table moves when it grows. modules are
+ * never freed and their tables do not change once loaded. only interned
+ * keys are cached, their characters are never freed
+ */
+enum { CACHE_SHAPE, CACHE_DICT, CACHE_MOD };
+
+static size_t cache_hits, cache_misses, cache_evictions;
+
+static void cache_fill(struct field_cache *cache, int kind, const void *owner, const char *key, int slot)
+{
+  int way;
+  if (cache->size < FIELD_CACHE_WAYS) {
+    way = cache->size++;
+  } else {
+    way = cache->next;
+    cache->next = (cache->next + 1) % FIELD_CACHE_WAYS;
+    cache_evictions++;
+  }
+  cache->ways[way].owner = owner;
+  cache->ways[way].key = key;
+  cache->ways[way].slot = slot;
+  cache->ways[way].kind = kind;
+}
+
+static svalue_t *map_field_miss(struct field_cache *cache, struct seal_map *map, struct seal_string *key)
+{
+  cache_misses++;
+  if (!key->is_interned)
+    return map_field(map, key);
+
+  if (map->shape != NULL) {
+    const char **keys = map->shape->keys;
+    for (int i = 0; i < map->shape->size; i++)
+      if (keys[i] == key->val) {
+        cache_fill(cache, CACHE_SHAPE, map->shape, key->val, i);
+        return &map->slots[i];
+      }
+    return NULL;
+  }
+  struct h_entry *e = hashmap_search_str(map->map, key);
+  if (e->key == NULL)
+    return NULL;
+  cache_fill(cache, CACHE_DICT, map->map->entries, key->val, e - map->map->entries);
+  return &e->val;
+}
+
+/* map_field through inline cache of site */
+static inline svalue_t *cached_map_field(struct field_cache *cache, struct seal_map *map, struct seal_string *key)
+{
+  if (map->shape != NULL) {
+    for (int i = 0; i < cache->size; i++)
+      if (cache->ways[i].owner == map->shape && cache->ways[i].key == key->val && cache->ways[i].kind == CACHE_SHAPE) {
+        cache_hits++;
+        return &map->slots[cache->ways[i].slot];
+      }
+  } else {
+    struct h_entry *entries = map->map->entries;
+    for (int i = 0; i < cache->size; i++)
+      if (cache->ways[i].owner == entries && cache->ways[i].key == key->val && cache->ways[i].kind == CACHE_DICT &&
+          cache->ways[i].slot < map->map->cap && entries[cache->ways[i].slot].key == key->val) {
+        cache_hits++;
+        return &entries[cache->ways[i].slot].val;
+      }
   }
+  return map_field_miss(cache, map, key);
 }
 
-static void RUN_FILE(const char *path, hashmap_t *globals)
+/* mod_field through inline cache of site */
+static inline svalue_t *cached_mod_field(struct field_cache *cache, struct seal_module *mod, struct seal_string *name)
+{
+  for (int i = 0; i < cache->size; i++)
+    if (cache->ways[i].owner == mod && cache->ways[i].key == name->val && cache->ways[i].kind == CACHE_MOD) {
+      svalue_t *val = mod->slots != NULL ? &mod->slots[cache->ways[i].slot] : &mod->globals->entries[cache->ways[i].slot].val;
+      if (!IS_UNDEF(*val)) {
+        cache_hits++;
+        return val;
+      }
+    }
+
+  cache_misses++;
+  struct h_entry *e = hashmap_search_str(mod->globals, name);
+  if (e->key == NULL)
+    return NULL;
+  int slot = mod->slots != NULL ? e->val.as._int : e - mod->globals->entries;
+  svalue_t *val = mod->slots != NULL ? &mod->slots[slot] : &e->val;
+  if (IS_UNDEF(*val))
+    return NULL;
+  if (name->is_interned)
+    cache_fill(cache, CACHE_MOD, mod, name->val, slot);
+  return val;
+}
+
+void print_field_caches()
+{
+  size_t total = cache_hits + cache_misses;
+  printf("FIELD CACHES START-------\n");
+  printf("hits: %zu (%.1f%%)\n", cache_hits, total ? 100.0 * cache_hits / total : 0.0);
+  printf("misses: %zu (%.1f%%)\n", cache_misses, total ? 100.0 * cache_misses / total : 0.0);
+  printf("evictions: %zu\n", cache_evictions);
+  printf("FIELD CACHES END-------\n");
+}
+
+static void RUN_FILE(const char *path, struct seal_module *mod)
 {
   int len = strlen(path) + 1;
   char* file_name = SEAL_CALLOC(len, sizeof(char));
   strcpy(file_name, path);
 
-  ast_t* root;
-  lexer_t lexer;
-  init_lexer(&lexer, file_name);
-  lexer_get_tokens(&lexer);
-  parser_t parser;
-  init_parser(&parser, &lexer);
-  root = parser_parse(&parser);
-  cout_t cout;
-  compile(&cout, root, file_name);
+  cout_t* cout = SEAL_MALLOC(sizeof(cout_t)); /* outlives file, lazy functions are compiled against it */
+  struct sealc_key key;
+  if (!sealc_load(cout, file_name, &key)) {
+    ast_t* root;
+    lexer_t lexer;
+    arena_t arena = { 0 }, *prev_arena = front_arena;
+    front_arena = &arena;
+    init_lexer(&lexer, file_name);
+    lexer_get_tokens(&lexer);
+    parser_t parser;
+    init_parser(&parser, &lexer);
+    root = parser_parse(&parser);
+    compile(cout, root, file_name);
+    if (!cout->is_lazy)
+      arena_free(&arena); /* ast of lazy functions is kept */
+    front_arena = prev_arena;
+    sealc_save(cout, file_name, &key);
+  }
   vm_t vm;
-  init_vm(&vm, &cout);
-  svalue_t locals[cout.main_scope_local_size];
+  init_vm(&vm, cout);
+  svalue_t locals[cout->main_scope_local_size];
+  memset(locals, 0, sizeof(locals));
   struct local_frame main_frame = {
     .locals = locals,
     .bytecodes = vm.bytecodes,
     .ip = vm.bytecodes,
-    .label_pool = cout.labels,
-    .const_pool = cout.const_pool,
-    .globals = &vm.globals,
-    .linfo = cout.bc.linfo,
-    .linfo_size = cout.bc.l_size,
+    .const_pool = cout->const_pool,
+    .globals = vm.globals,
+    .caches = cout->caches,
+    .linfo = cout->bc.linfo,
+    .linfo_size = cout->bc.l_size,
     .file_name = file_name,
+    .local_size = cout->main_scope_local_size,
   };
-  *(globals) = vm.globals;
+  /* fields of module are looked up through symbol table of file */
+  mod->globals = &cout->symtab;
+  mod->slots = vm.globals;
   eval_vm(&vm, &main_frame);
-  *(globals) = vm.globals;
-  set_all_functions_global(globals);
   //SEAL_FREE(vm.stack);
   //SEAL_FREE(vm.bytecodes);
   //SEAL_FREE(vm.label_ptr);
@@ -327,8 +546,7 @@ search:
       };
       val.as.mod->name = name;
       hashmap_insert_e(&mod_cache, e, name, val);
-      val.as.mod->globals = SEAL_CALLOC(1, sizeof(hashmap_t));
-      RUN_FILE(path, val.as.mod->globals);
+      RUN_FILE(path, val.as.mod);
     }
   }
 
@@ -375,560 +593,1246 @@ static svalue_t __seal_type_null,
 )
 /********************************************/
 
+static int max_depth = FRAME_MAX;
+
+/* running vms, innermost first, outer ones wait for module to be included */
+static vm_t *active_vm;
+
+static size_t vm_root(bool root)
+{
+  size_t roots = 0;
+  for (vm_t *vm = active_vm; vm != NULL; vm = vm->prev) {
+    for (svalue_t *p = vm->stack; p < vm->sp; p++)
+      root ? gc_root(*p) : gc_unroot(*p);
+    for (int i = 0; i < vm->frames[0].local_size; i++)
+      root ? gc_root(vm->frames[0].locals[i]) : gc_unroot(vm->frames[0].locals[i]);
+    roots += vm->sp - vm->stack + vm->frames[0].local_size;
+  }
+  return roots;
+}
+
+/* stacks and entry locals of running vms are roots, call frame locals live on stack */
+static void vm_reconcile()
+{
+  size_t roots = vm_root(true);
+  gc_reconcile(roots);
+  if (gc_allocated >= GC_CYCLE_THRESHOLD) {
+    gc_collect_cycles();
+    gc_reconcile(roots); /* members of cycles left without count */
+  }
+  vm_root(false);
+}
+
+size_t vm_collect()
+{
+  size_t freed = gc_freed;
+  size_t roots = vm_root(true);
+  gc_reconcile(roots);
+  gc_collect_cycles();
+  gc_reconcile(roots);
+  vm_root(false);
+  return gc_freed - freed;
+}
+
+/*
+ * every live value is on a stack or in locals at start of calls and jumps,
+ * conditional jumps become backward when peephole threads them onto loops
+ */
+#define GC_SAFE_POINT() do { \
+  if (gc_zct_size >= gc_zct_limit) \
+    vm_reconcile(); \
+} while (0)
+
+static void release_range(svalue_t *from, svalue_t *to)
+{
+  while (from < to)
+    gc_release(*from++);
+}
+
+/* quickened sites, recorded only if tracing is enabled */
+struct quick_site {
+  seal_byte *ip; /* address of opcode */
+  const char *file_name;
+  int line;
+};
+
+static bool trace_quick = false;
+static struct quick_site *quick_sites;
+static size_t quick_size, quick_cap;
+
+static void record_quick_site(struct local_frame *lf)
+{
+  for (size_t i = 0; i < quick_size; i++)
+    if (quick_sites[i].ip == lf->ip - 1)
+      return;
+
+  if (quick_size >= quick_cap)
+    quick_sites = SEAL_REALLOC(quick_sites, sizeof(struct quick_site) * (quick_cap = quick_cap ? quick_cap * 2 : 16));
+  quick_sites[quick_size++] = (struct quick_site) {
+    .ip = lf->ip - 1,
+    .file_name = lf->file_name,
+    .line = frame_line(lf),
+  };
+}
+
+void vm_trace_quickening(bool enable)
+{
+  trace_quick = enable;
+}
+
+void print_quickened()
+{
+  printf("QUICKENED SITES START-------\n");
+  for (size_t i = 0; i < quick_size; i++) {
+    seal_byte op = *quick_sites[i].ip;
+    printf("%s:%d: %s%s\n", quick_sites[i].file_name, quick_sites[i].line, op_name(op),
+        op == OP_ADD_POLY || op == OP_LT_POLY || op == OP_EQ_POLY || op == OP_GET_FIELD_POLY ? " (deoptimized)" : "");
+  }
+  printf("QUICKENED SITES END-------\n");
+}
+
+void vm_set_max_depth(int depth)
+{
+  max_depth = depth;
+}
+
 void init_vm(vm_t* vm, cout_t* cout)
 {
   vm->const_pool_ptr = cout->const_pool;
-  vm->label_ptr = cout->labels;
 
   svalue_t *stack = SEAL_CALLOC(STACK_SIZE, sizeof(svalue_t));
   vm->stack = stack;
 
   vm->sp = vm->stack;
   vm->bytecodes = cout->bc.bytecodes;
-  // vm->lf = SEAL_CALLOC(FRAME_MAX, sizeof(struct local_frame));
-  // vm->lf[0] = (struct local_frame) { .ip = vm->bytecodes, .caller = NULL };
-  hashmap_init(&vm->globals, 256);
-  REGISTER_BUILTIN_FUNC(&vm->globals, __seal_print, "print", 0, true);
-  REGISTER_BUILTIN_FUNC(&vm->globals, __seal_scan, "scan", 0, true);
-  REGISTER_BUILTIN_FUNC(&vm->globals, __seal_exit, "exit", 0, true);
-  REGISTER_BUILTIN_FUNC(&vm->globals, __seal_len, "len", 1, false);
-  REGISTER_BUILTIN_FUNC(&vm->globals, __seal_int, "int", 1, false);
-  REGISTER_BUILTIN_FUNC(&vm->globals, __seal_float, "float", 1, false);
-  REGISTER_BUILTIN_FUNC(&vm->globals, __seal_str, "str", 1, false);
-  REGISTER_BUILTIN_FUNC(&vm->globals, __seal_bool, "bool", 1, false);
-  REGISTER_BUILTIN_FUNC(&vm->globals, __seal_push, "push", 2, true);
-  REGISTER_BUILTIN_FUNC(&vm->globals, __seal_pop, "pop", 1, false);
-  REGISTER_BUILTIN_FUNC(&vm->globals, __seal_insert, "insert", 3, false);
-  REGISTER_BUILTIN_FUNC(&vm->globals, __seal_remove, "remove", 2, false);
-  REGISTER_BUILTIN_FUNC(&vm->globals, __seal_format, "format", 1, true);
-
-
-  __seal_type_null = SEAL_VALUE_STRING_STATIC(seal_type_name(SEAL_NULL));
-  __seal_type_int  = SEAL_VALUE_STRING_STATIC(seal_type_name(SEAL_INT));
-  __seal_type_float = SEAL_VALUE_STRING_STATIC(seal_type_name(SEAL_FLOAT));
-  __seal_type_string = SEAL_VALUE_STRING_STATIC(seal_type_name(SEAL_STRING));
-  __seal_type_bool = SEAL_VALUE_STRING_STATIC(seal_type_name(SEAL_BOOL));
-  __seal_type_list = SEAL_VALUE_STRING_STATIC(seal_type_name(SEAL_LIST));
-  __seal_type_map = SEAL_VALUE_STRING_STATIC(seal_type_name(SEAL_MAP));
-  __seal_type_func = SEAL_VALUE_STRING_STATIC(seal_type_name(SEAL_FUNC));
-  __seal_type_mod = SEAL_VALUE_STRING_STATIC(seal_type_name(SEAL_MOD));
-  __seal_type_ptr = SEAL_VALUE_STRING_STATIC(seal_type_name(SEAL_PTR));
+  vm->frame_max = max_depth;
+  vm->frames = SEAL_CALLOC(max_depth, sizeof(struct local_frame));
+  /* unassigned slots keep their names for error messages */
+  vm->symtab = &cout->symtab;
+  /* slots are never moved, lazy compilation may add globals up to maximum */
+  vm->global_cap = cout->is_lazy ? GLOBAL_MAX : cout->symtab.filled;
+  vm->globals = SEAL_CALLOC(vm->global_cap > 0 ? vm->global_cap : 1, sizeof(svalue_t));
+  for (size_t i = 0; i < cout->symtab.cap; i++) {
+    struct h_entry *e = &cout->symtab.entries[i];
+    if (e->key != NULL)
+      vm->globals[e->val.as._int] = SEAL_VALUE_UNDEF(e->key);
+  }
+  if (builtins.entries == NULL)
+    hashmap_init(&builtins, 64);
+  REGISTER_BUILTIN_FUNC(vm, __seal_print, "print", 0, true);
+  REGISTER_BUILTIN_FUNC(vm, __seal_scan, "scan", 0, true);
+  REGISTER_BUILTIN_FUNC(vm, __seal_exit, "exit", 0, true);
+  REGISTER_BUILTIN_FUNC(vm, __seal_len, "len", 1, false);
+  REGISTER_BUILTIN_FUNC(vm, __seal_int, "int", 1, false);
+  REGISTER_BUILTIN_FUNC(vm, __seal_float, "float", 1, false);
+  REGISTER_BUILTIN_FUNC(vm, __seal_str, "str", 1, false);
+  REGISTER_BUILTIN_FUNC(vm, __seal_bool, "bool", 1, false);
+  REGISTER_BUILTIN_FUNC(vm, __seal_push, "push", 2, true);
+  REGISTER_BUILTIN_FUNC(vm, __seal_pop, "pop", 1, false);
+  REGISTER_BUILTIN_FUNC(vm, __seal_insert, "insert", 3, false);
+  REGISTER_BUILTIN_FUNC(vm, __seal_remove, "remove", 2, false);
+  REGISTER_BUILTIN_FUNC(vm, __seal_format, "format", 1, true);
+  REGISTER_BUILTIN_FUNC(vm, __seal_gc, "gc", 0, false);
+
+
+  __seal_type_null = SEAL_VALUE_STRING_INTERNED(seal_type_name(SEAL_NULL));
+  __seal_type_int  = SEAL_VALUE_STRING_INTERNED(seal_type_name(SEAL_INT));
+  __seal_type_float = SEAL_VALUE_STRING_INTERNED(seal_type_name(SEAL_FLOAT));
+  __seal_type_string = SEAL_VALUE_STRING_INTERNED(seal_type_name(SEAL_STRING));
+  __seal_type_bool = SEAL_VALUE_STRING_INTERNED(seal_type_name(SEAL_BOOL));
+  __seal_type_list = SEAL_VALUE_STRING_INTERNED(seal_type_name(SEAL_LIST));
+  __seal_type_map = SEAL_VALUE_STRING_INTERNED(seal_type_name(SEAL_MAP));
+  __seal_type_func = SEAL_VALUE_STRING_INTERNED(seal_type_name(SEAL_FUNC));
+  __seal_type_mod = SEAL_VALUE_STRING_INTERNED(seal_type_name(SEAL_MOD));
+  __seal_type_ptr = SEAL_VALUE_STRING_INTERNED(seal_type_name(SEAL_PTR));
 }
 
-void eval_vm(vm_t* vm, struct local_frame* lf)
+/* compiles body of lazy function, globals it adds are unassigned or builtins */
+static void compile_on_call(struct seal_func *func, svalue_t *globals)
 {
-  while (true) {
-    seal_byte op = FETCH(lf);
+  hashmap_t *symtab = &func->as.userdef.lazy->cout->symtab;
+  size_t filled = symtab->filled;
+  compile_lazy(func);
+  if (symtab->filled == filled)
+    return;
+
+  for (size_t i = 0; i < symtab->cap; i++) {
+    struct h_entry *e = &symtab->entries[i];
+    if (e->key == NULL || e->val.as._int < filled)
+      continue;
+    struct h_entry *builtin = hashmap_search(&builtins, e->key);
+    if (builtin->key != NULL) {
+      gc_incref(builtin->val);
+      globals[e->val.as._int] = builtin->val;
+    } else {
+      globals[e->val.as._int] = SEAL_VALUE_UNDEF(e->key);
+    }
+  }
+}
 
-    seal_word idx, addr;
-    svalue_t  left, right;
-    struct h_entry* entry;
-    const char* sym;
+void vm_set_global(vm_t* vm, const char* name, svalue_t val)
+{
+  struct h_entry *e = hashmap_search(vm->symtab, name);
+  if (e->key == NULL && vm->symtab->filled < vm->global_cap) /* functions compiled later may use it */
+    e = hashmap_insert_e(vm->symtab, e, name, SEAL_VALUE_INT(vm->symtab->filled));
+  if (e->key != NULL) {
+    gc_incref(val);
+    vm->globals[e->val.as._int] = val;
+  }
+}
 
-    switch (op) {
-    case OP_HALT:
+void eval_vm(vm_t* vm, struct local_frame* lf)
+{
+  seal_byte op;
+  seal_word idx, addr;
+  int32_t jmp; /* relative jump offset */
+  svalue_t  left, right;
+
+#if SEAL_THREADED_DISPATCH
+  static void *dispatch_table[256] = {
+    [0 ... 255] = &&L_DEFAULT,
+    [OP_HALT] = &&L_OP_HALT,
+    [OP_PUSH_CONST] = &&L_OP_PUSH_CONST,
+    [OP_PUSH_INT] = &&L_OP_PUSH_INT,
+    [OP_PUSH_NULL] = &&L_OP_PUSH_NULL,
+    [OP_PUSH_TRUE] = &&L_OP_PUSH_TRUE,
+    [OP_PUSH_FALSE] = &&L_OP_PUSH_FALSE,
+    [OP_POP] = &&L_OP_POP,
+    [OP_DUP] = &&L_OP_DUP,
+    [OP_COPY] = &&L_OP_COPY,
+    [OP_SWAP] = &&L_OP_SWAP,
+    [OP_ADD] = &&L_OP_ADD,
+    [OP_SUB] = &&L_OP_SUB,
+    [OP_MUL] = &&L_OP_MUL,
+    [OP_DIV] = &&L_OP_DIV,
+    [OP_MOD] = &&L_OP_MOD,
+    [OP_AND] = &&L_OP_AND,
+    [OP_OR] = &&L_OP_OR,
+    [OP_XOR] = &&L_OP_XOR,
+    [OP_SHL] = &&L_OP_SHL,
+    [OP_SHR] = &&L_OP_SHR,
+    [OP_EQ] = &&L_OP_EQ,
+    [OP_NE] = &&L_OP_NE,
+    [OP_GT] = &&L_OP_GT,
+    [OP_GE] = &&L_OP_GE,
+    [OP_LT] = &&L_OP_LT,
+    [OP_LE] = &&L_OP_LE,
+    [OP_TYPOF] = &&L_OP_TYPOF,
+    [OP_NOT] = &&L_OP_NOT,
+    [OP_NEG] = &&L_OP_NEG,
+    [OP_BNOT] = &&L_OP_BNOT,
+    [OP_JUMP] = &&L_OP_JUMP,
+    [OP_JFALSE] = &&L_OP_JFALSE,
+    [OP_JTRUE] = &&L_OP_JTRUE,
+    [OP_GET_GLOBAL] = &&L_OP_GET_GLOBAL,
+    [OP_SET_GLOBAL] = &&L_OP_SET_GLOBAL,
+    [OP_GET_LOCAL] = &&L_OP_GET_LOCAL,
+    [OP_SET_LOCAL] = &&L_OP_SET_LOCAL,
+    [OP_CALL] = &&L_OP_CALL,
+    [OP_TAIL_CALL] = &&L_OP_TAIL_CALL,
+    [OP_GEN_LIST] = &&L_OP_GEN_LIST,
+    [OP_GET_FIELD] = &&L_OP_GET_FIELD,
+    [OP_SET_FIELD] = &&L_OP_SET_FIELD,
+    [OP_IN] = &&L_OP_IN,
+    [OP_GEN_MAP] = &&L_OP_GEN_MAP,
+    [OP_INCLUDE] = &&L_OP_INCLUDE,
+    [OP_INCLUDE_SYM] = &&L_OP_INCLUDE_SYM,
+    [OP_FOR_PREP] = &&L_OP_FOR_PREP,
+    [OP_FOR_NEXT] = &&L_OP_FOR_NEXT,
+    [OP_FOR_STOP] = &&L_OP_FOR_STOP,
+    [OP_ADD_LL] = &&L_OP_ADD_LL,
+    [OP_INC_LOCAL] = &&L_OP_INC_LOCAL,
+    [OP_DEC_LOCAL] = &&L_OP_DEC_LOCAL,
+    [OP_JFALSE_LT_LI] = &&L_OP_JFALSE_LT_LI,
+    [OP_JFALSE_LE_LI] = &&L_OP_JFALSE_LE_LI,
+    [OP_JFALSE_GT_LI] = &&L_OP_JFALSE_GT_LI,
+    [OP_JFALSE_GE_LI] = &&L_OP_JFALSE_GE_LI,
+    [OP_JFALSE_EQ_LI] = &&L_OP_JFALSE_EQ_LI,
+    [OP_JFALSE_NE_LI] = &&L_OP_JFALSE_NE_LI,
+    [OP_JFALSE_OR_POP] = &&L_OP_JFALSE_OR_POP,
+    [OP_JTRUE_OR_POP] = &&L_OP_JTRUE_OR_POP,
+    [OP_R_MOVE] = &&L_OP_R_MOVE,
+    [OP_R_LOADI] = &&L_OP_R_LOADI,
+    [OP_R_LOADK] = &&L_OP_R_LOADK,
+    [OP_R_PUSH] = &&L_OP_R_PUSH,
+    [OP_R_POP] = &&L_OP_R_POP,
+    [OP_R_CLEAR] = &&L_OP_R_CLEAR,
+    [OP_R_ADD] = &&L_OP_R_ADD,
+    [OP_R_SUB] = &&L_OP_R_SUB,
+    [OP_R_MUL] = &&L_OP_R_MUL,
+    [OP_R_DIV] = &&L_OP_R_DIV,
+    [OP_R_MOD] = &&L_OP_R_MOD,
+    [OP_R_AND] = &&L_OP_R_AND,
+    [OP_R_OR] = &&L_OP_R_OR,
+    [OP_R_XOR] = &&L_OP_R_XOR,
+    [OP_R_SHL] = &&L_OP_R_SHL,
+    [OP_R_SHR] = &&L_OP_R_SHR,
+    [OP_R_GT] = &&L_OP_R_GT,
+    [OP_R_GE] = &&L_OP_R_GE,
+    [OP_R_LT] = &&L_OP_R_LT,
+    [OP_R_LE] = &&L_OP_R_LE,
+    [OP_R_EQ] = &&L_OP_R_EQ,
+    [OP_R_NE] = &&L_OP_R_NE,
+    [OP_R_IN] = &&L_OP_R_IN,
+    [OP_R_NOT] = &&L_OP_R_NOT,
+    [OP_R_NEG] = &&L_OP_R_NEG,
+    [OP_R_BNOT] = &&L_OP_R_BNOT,
+    [OP_R_TYPOF] = &&L_OP_R_TYPOF,
+    [OP_R_JFALSE] = &&L_OP_R_JFALSE,
+    [OP_R_JTRUE] = &&L_OP_R_JTRUE,
+    [OP_R_JF_GT] = &&L_OP_R_JF_GT,
+    [OP_R_JF_GE] = &&L_OP_R_JF_GE,
+    [OP_R_JF_LT] = &&L_OP_R_JF_LT,
+    [OP_R_JF_LE] = &&L_OP_R_JF_LE,
+    [OP_R_JF_EQ] = &&L_OP_R_JF_EQ,
+    [OP_R_JF_NE] = &&L_OP_R_JF_NE,
+    [OP_JUMP_S] = &&L_OP_JUMP_S,
+    [OP_JFALSE_S] = &&L_OP_JFALSE_S,
+    [OP_JTRUE_S] = &&L_OP_JTRUE_S,
+    [OP_FOR_PREP_S] = &&L_OP_FOR_PREP_S,
+    [OP_FOR_NEXT_S] = &&L_OP_FOR_NEXT_S,
+    [OP_JFALSE_LT_LI_S] = &&L_OP_JFALSE_LT_LI_S,
+    [OP_JFALSE_LE_LI_S] = &&L_OP_JFALSE_LE_LI_S,
+    [OP_JFALSE_GT_LI_S] = &&L_OP_JFALSE_GT_LI_S,
+    [OP_JFALSE_GE_LI_S] = &&L_OP_JFALSE_GE_LI_S,
+    [OP_JFALSE_EQ_LI_S] = &&L_OP_JFALSE_EQ_LI_S,
+    [OP_JFALSE_NE_LI_S] = &&L_OP_JFALSE_NE_LI_S,
+    [OP_JFALSE_OR_POP_S] = &&L_OP_JFALSE_OR_POP_S,
+    [OP_JTRUE_OR_POP_S] = &&L_OP_JTRUE_OR_POP_S,
+    [OP_R_JFALSE_S] = &&L_OP_R_JFALSE_S,
+    [OP_R_JTRUE_S] = &&L_OP_R_JTRUE_S,
+    [OP_R_JF_GT_S] = &&L_OP_R_JF_GT_S,
+    [OP_R_JF_GE_S] = &&L_OP_R_JF_GE_S,
+    [OP_R_JF_LT_S] = &&L_OP_R_JF_LT_S,
+    [OP_R_JF_LE_S] = &&L_OP_R_JF_LE_S,
+    [OP_R_JF_EQ_S] = &&L_OP_R_JF_EQ_S,
+    [OP_R_JF_NE_S] = &&L_OP_R_JF_NE_S,
+    [OP_ADD_II] = &&L_OP_ADD_II,
+    [OP_ADD_FF] = &&L_OP_ADD_FF,
+    [OP_LT_II] = &&L_OP_LT_II,
+    [OP_EQ_STR] = &&L_OP_EQ_STR,
+    [OP_GET_FIELD_LIST_INT] = &&L_OP_GET_FIELD_LIST_INT,
+    [OP_ADD_POLY] = &&L_OP_ADD_POLY,
+    [OP_LT_POLY] = &&L_OP_LT_POLY,
+    [OP_EQ_POLY] = &&L_OP_EQ_POLY,
+    [OP_GET_FIELD_POLY] = &&L_OP_GET_FIELD_POLY,
+  };
+#endif
+
+  /* calls push frames onto vm->frames and run in this loop */
+  vm->frames[0] = *lf;
+  lf = vm->frames;
+  vm->prev = active_vm;
+  active_vm = vm;
+
+  VM_LOOP {
+  VM_CASE(OP_HALT):
+    if (lf == vm->frames) {
+      release_range(vm->stack, vm->sp);
+      release_range(lf->locals, lf->locals + lf->local_size);
+      active_vm = vm->prev;
       return;
-    case OP_PUSH_CONST:
-      idx = FETCH(lf) << 8;
-      idx |= FETCH(lf);
-      left = GET_CONST(lf, idx);
-      if (IS_FUNC(left) && IS_USERDEF_FUNC(left)) {
-        AS_USERDEF_FUNC(left).globals = lf->globals;
-      }
-      PUSH(vm, left);
-      break;
-    case OP_PUSH_INT:
-      idx = FETCH(lf) << 8;
-      idx |= FETCH(lf);
-      PUSH_INT(vm, idx);
-      break;
-    case OP_PUSH_NULL:
-      PUSH_NULL(vm);
-      break;
-    case OP_PUSH_TRUE:
-      PUSH_BOOL(vm, true);
-      break;
-    case OP_PUSH_FALSE:
-      PUSH_BOOL(vm, false);
-      break;
-    case OP_POP:
-      left = POP(vm);
-      gc_decref(left);
-      break;
-    case OP_DUP:
-      DUP(vm);
-      break;
-    case OP_COPY:
-      idx = FETCH(lf);
-      PUSH(vm, *(vm->sp - idx));
-      break;
-    case OP_SWAP:
-      idx = FETCH(lf);
-      left = *(vm->sp - 1);
-      *(vm->sp - 1) = *(vm->sp - idx);
-      *(vm->sp - idx) = left;
-      break;
-    case OP_ADD:
-      right = POP(vm);
-      left  = POP(vm);
-      BIN_OP(vm, left, right, +);
-      gc_decref(left);
-      gc_decref(right);
-      break;
-    case OP_SUB:
-      right = POP(vm);
-      left  = POP(vm);
-      BIN_OP(vm, left, right, -);
-      break;
-    case OP_MUL:
-      right = POP(vm);
-      left  = POP(vm);
-      BIN_OP(vm, left, right, *);
-      break;
-    case OP_DIV:
-      right = POP(vm);
-      left  = POP(vm);
-      if (IS_NUM(right) && AS_NUM(right) == 0.0) {
-        VM_ERROR("division by zero");
-      }
-      BIN_OP(vm, left, right, /);
-      break;
-    case OP_MOD:
-      right = POP(vm);
-      left  = POP(vm);
-      MOD_OP(vm, left, right);
-      break;
-    case OP_AND:
-      right = POP(vm);
-      left  = POP(vm);
-      BITWISE_OP(vm, left, right, &);
-      gc_decref(left);
-      gc_decref(right);
-      break;
-    case OP_OR:
-      right = POP(vm);
-      left  = POP(vm);
-      BITWISE_OP(vm, left, right, |);
-      gc_decref(left);
-      gc_decref(right);
-      break;
-    case OP_XOR:
-      right = POP(vm);
-      left  = POP(vm);
-      BITWISE_OP(vm, left, right, ^);
-      break;
-    case OP_SHL:
-      right = POP(vm);
-      left  = POP(vm);
-      BITWISE_OP(vm, left, right, <<);
-      break;
-    case OP_SHR:
-      right = POP(vm);
-      left  = POP(vm);
-      BITWISE_OP(vm, left, right, >>);
-      break;
-    case OP_EQ:
-      right = POP(vm);
-      left  = POP(vm);
-      EQUAL_OP(vm, left, right, ==);
-      gc_decref(left);
-      gc_decref(right);
-      break;
-    case OP_NE:
-      right = POP(vm);
-      left  = POP(vm);
-      EQUAL_OP(vm, left, right, !=);
-      gc_decref(left);
-      gc_decref(right);
-      break;
-    case OP_GT:
-      right = POP(vm);
-      left  = POP(vm);
-      CMP_OP(vm, left, right, >);
-      break;
-    case OP_GE:
-      right = POP(vm);
-      left  = POP(vm);
-      CMP_OP(vm, left, right, >=);
-      break;
-    case OP_LT:
-      right = POP(vm);
-      left  = POP(vm);
-      CMP_OP(vm, left, right, <);
-      break;
-    case OP_LE:
-      right = POP(vm);
-      left  = POP(vm);
-      CMP_OP(vm, left, right, <=);
-      break;
-    case OP_TYPOF:
-      left = POP(vm);
-      PUSH(vm, TYPEOF_VAL_STR(left));
-      gc_decref(left);
-      break;
-    case OP_NOT:
-    case OP_NEG:
-    case OP_BNOT:
-      left = POP(vm);
-      UNRY_OP(vm, left, op);
-      gc_decref(left);
-      break;
-    case OP_JUMP:
-      addr = FETCH(lf) << 8;
-      addr |= FETCH(lf);
-      JUMP(lf, addr);
-      break;
-    case OP_JFALSE:
-      addr = FETCH(lf) << 8;
-      addr |= FETCH(lf);
-      left = POP(vm);
-      if (!TO_BOOL(left))
-        JUMP(lf, addr);
-      gc_decref(left);
-      break;
-    case OP_JTRUE:
-      addr = FETCH(lf) << 8;
-      addr |= FETCH(lf);
-      left = POP(vm);
-      if (TO_BOOL(left))
-        JUMP(lf, addr);
-      gc_decref(left);
-      break;
-    case OP_GET_GLOBAL:
-      addr = FETCH(lf) << 8;
-      addr |= FETCH(lf);
-      sym = AS_STRING(GET_CONST(lf, addr));
-      entry = hashmap_search(lf->globals, sym);
-      if (entry && entry->key) {
-        PUSH(vm, entry->val);
-      } else {
-        VM_ERROR("\'%s\' is not defined", sym);
-      }
-      break;
-    case OP_SET_GLOBAL:
-      DUP(vm);
-      addr = FETCH(lf) << 8;
-      addr |= FETCH(lf);
-      hashmap_insert(lf->globals, AS_STRING(GET_CONST(lf, addr)), POP(vm));
-      break;
-    case OP_GET_LOCAL:
-      addr = FETCH(lf);
-      PUSH(vm, GET_LOCAL(lf, addr));
-      break;
-    case OP_SET_LOCAL:
-      DUP(vm);
-      addr = FETCH(lf);
-      left = POP(vm);
-      gc_decref(GET_LOCAL(lf, addr));
-      SET_LOCAL(lf, addr, left);
-      break;
-    case OP_CALL: {
-      seal_byte argc = FETCH(lf);
-      svalue_t *argv = vm->sp - argc;
-      vm->sp -= argc;
-
-      svalue_t func = POP(vm);
-      if (!IS_FUNC(func))
-        VM_ERROR("calling non-function: \'%s\'", seal_type_name(func.type));
-
-      if (!IS_FUNC_VARARG(func) && argc != FUNC_ARGC(func) || IS_FUNC_VARARG(func) && argc < FUNC_ARGC(func))
-        VM_ERROR("\'%s\' function expected%s %d argument%s, got %d",
-              FUNC_NAME(func),
-              IS_FUNC_VARARG(func) ? " at least" : "",
-              FUNC_ARGC(func),
-              FUNC_ARGC(func) != 1 ? "s" : "",
-              argc);
-
-      if (IS_BUILTIN_FUNC(func)) {
-        PUSH(vm, CALL_BUILTIN_FUNC(func)(argc, argv)); /* push function result to stack */
-        for (int i = 0; i < argc; i++) {
-          gc_decref(argv[i]);
-        }
-      } else {
-        svalue_t locals[func.as.func.as.userdef.local_size];
-        memset(locals, 0, sizeof(locals));
-        struct local_frame func_lf = {
-          .locals = locals,
-          .ip = AS_USERDEF_FUNC(func).bytecode,
-          .bytecodes = AS_USERDEF_FUNC(func).bytecode,
-          .const_pool = AS_USERDEF_FUNC(func).const_pool,
-          .label_pool = AS_USERDEF_FUNC(func).label_pool,
-          .globals = AS_USERDEF_FUNC(func).globals ? AS_USERDEF_FUNC(func).globals : &vm->globals,
-          .linfo = AS_USERDEF_FUNC(func).linfo,
-          .linfo_size = AS_USERDEF_FUNC(func).linfo_size,
-          .file_name = AS_USERDEF_FUNC(func).file_name,
-        };
-        if (IS_FUNC_VARARG(func)) {
-          int i;
-          for (i = 0; i < FUNC_ARGC(func); i++) {
-            SET_LOCAL((&func_lf), i, argv[i]);
-          }
-          svalue_t vargs = SEAL_VALUE_LIST();
-          for (int j = i; j < argc; j++) {
-            LIST_PUSH(vargs, argv[j]);
-          }
-          gc_incref(vargs);
-          SET_LOCAL((&func_lf), i, vargs);
-        } else {
-          for (int i = 0; i < argc; i++) {
-            SET_LOCAL((&func_lf), i, argv[i]);
-          }
-        }
-        eval_vm(vm, &func_lf);
-        for (int i = 0; i < AS_USERDEF_FUNC(func).local_size; i++) {
-          gc_decref(locals[i]);
-        }
-      }
-      break;
     }
-    case OP_GEN_LIST: {
-      seal_byte size = FETCH(lf);
-      left = SEAL_VALUE_LIST();
-      svalue_t sorted[size];
-      for (int i = 0; i < size; i++) {
-        sorted[i] = POP(vm);
-      }
-      for (int i = size - 1; i >= 0; i--) {
-        LIST_PUSH(left, sorted[i]);
-      }
-      PUSH(vm, left);
-      break;
+    /* return to caller, locals and temporaries of callee are dropped */
+    left = POP(vm);
+    release_range(lf->base, vm->sp);
+    vm->sp = lf->base;
+    *vm->sp++ = left;
+    lf--;
+    VM_NEXT();
+  VM_CASE(OP_PUSH_CONST):
+    idx = FETCH(lf) << 8;
+    idx |= FETCH(lf);
+    left = GET_CONST(lf, idx);
+    if (IS_FUNC(left) && IS_USERDEF_FUNC(left)) {
+      AS_USERDEF_FUNC(left).globals = lf->globals;
     }
-    case OP_GET_FIELD:
-      right = POP(vm);
-      left  = POP(vm);
-
-      switch (VAL_TYPE(left)) {
-      case SEAL_MAP: {
-        if (!IS_STRING(right))
-          VM_ERROR("map indices must be strings, not \'%s\'", seal_type_name(VAL_TYPE(right)));
-
-        struct sh_entry *e = shashmap_search(AS_MAP(left)->map, AS_STRING(right));
-        if (e == NULL || e->key == NULL) {
-          /* VM_ERROR("\'%s\' key is not found", AS_STRING(right)); */
-          PUSH(vm, SEAL_VALUE_NULL);
-        } else {
-          PUSH(vm, e->val);
-        }
-
-        break;
+    PUSH(vm, left);
+    VM_NEXT();
+  VM_CASE(OP_PUSH_INT):
+    idx = FETCH(lf) << 8;
+    idx |= FETCH(lf);
+    PUSH_INT(vm, idx);
+    VM_NEXT();
+  VM_CASE(OP_PUSH_NULL):
+    PUSH_NULL(vm);
+    VM_NEXT();
+  VM_CASE(OP_PUSH_TRUE):
+    PUSH_BOOL(vm, true);
+    VM_NEXT();
+  VM_CASE(OP_PUSH_FALSE):
+    PUSH_BOOL(vm, false);
+    VM_NEXT();
+  VM_CASE(OP_POP):
+    left = POP(vm);
+    gc_release(left);
+    VM_NEXT();
+  VM_CASE(OP_DUP):
+    DUP(vm);
+    VM_NEXT();
+  VM_CASE(OP_COPY):
+    idx = FETCH(lf);
+    PUSH(vm, *(vm->sp - idx));
+    VM_NEXT();
+  VM_CASE(OP_SWAP):
+    idx = FETCH(lf);
+    left = *(vm->sp - 1);
+    *(vm->sp - 1) = *(vm->sp - idx);
+    *(vm->sp - idx) = left;
+    VM_NEXT();
+  VM_CASE(OP_ADD_POLY):
+  poly_add:
+    right = POP(vm);
+    left  = POP(vm);
+    goto generic_add;
+  VM_CASE(OP_ADD):
+    right = POP(vm);
+    left  = POP(vm);
+    if (IS_INT(left) && IS_INT(right))
+      QUICKEN(lf, OP_ADD_II);
+    else if (IS_FLOAT(left) && IS_FLOAT(right))
+      QUICKEN(lf, OP_ADD_FF);
+  generic_add:
+    BIN_OP(vm, left, right, +);
+    gc_release(left);
+    gc_release(right);
+    VM_NEXT();
+  VM_CASE(OP_SUB):
+    right = POP(vm);
+    left  = POP(vm);
+    BIN_OP(vm, left, right, -);
+    VM_NEXT();
+  VM_CASE(OP_MUL):
+    right = POP(vm);
+    left  = POP(vm);
+    BIN_OP(vm, left, right, *);
+    VM_NEXT();
+  VM_CASE(OP_DIV):
+    right = POP(vm);
+    left  = POP(vm);
+    if (IS_NUM(right) && AS_NUM(right) == 0.0) {
+      VM_ERROR("division by zero");
+    }
+    BIN_OP(vm, left, right, /);
+    VM_NEXT();
+  VM_CASE(OP_MOD):
+    right = POP(vm);
+    left  = POP(vm);
+    MOD_OP(vm, left, right);
+    VM_NEXT();
+  VM_CASE(OP_AND):
+    right = POP(vm);
+    left  = POP(vm);
+    BITWISE_OP(vm, left, right, &);
+    gc_release(left);
+    gc_release(right);
+    VM_NEXT();
+  VM_CASE(OP_OR):
+    right = POP(vm);
+    left  = POP(vm);
+    BITWISE_OP(vm, left, right, |);
+    gc_release(left);
+    gc_release(right);
+    VM_NEXT();
+  VM_CASE(OP_XOR):
+    right = POP(vm);
+    left  = POP(vm);
+    BITWISE_OP(vm, left, right, ^);
+    VM_NEXT();
+  VM_CASE(OP_SHL):
+    right = POP(vm);
+    left  = POP(vm);
+    BITWISE_OP(vm, left, right, <<);
+    VM_NEXT();
+  VM_CASE(OP_SHR):
+    right = POP(vm);
+    left  = POP(vm);
+    BITWISE_OP(vm, left, right, >>);
+    VM_NEXT();
+  VM_CASE(OP_EQ_POLY):
+  poly_eq:
+    right = POP(vm);
+    left  = POP(vm);
+    goto generic_eq;
+  VM_CASE(OP_EQ):
+    right = POP(vm);
+    left  = POP(vm);
+    if (IS_STRING(left) && IS_STRING(right))
+      QUICKEN(lf, OP_EQ_STR);
+  generic_eq:
+    EQUAL_OP(vm, left, right, ==);
+    gc_release(left);
+    gc_release(right);
+    VM_NEXT();
+  VM_CASE(OP_NE):
+    right = POP(vm);
+    left  = POP(vm);
+    EQUAL_OP(vm, left, right, !=);
+    gc_release(left);
+    gc_release(right);
+    VM_NEXT();
+  VM_CASE(OP_GT):
+    right = POP(vm);
+    left  = POP(vm);
+    CMP_OP(vm, left, right, >);
+    VM_NEXT();
+  VM_CASE(OP_GE):
+    right = POP(vm);
+    left  = POP(vm);
+    CMP_OP(vm, left, right, >=);
+    VM_NEXT();
+  VM_CASE(OP_LT_POLY):
+  poly_lt:
+    right = POP(vm);
+    left  = POP(vm);
+    goto generic_lt;
+  VM_CASE(OP_LT):
+    right = POP(vm);
+    left  = POP(vm);
+    if (IS_INT(left) && IS_INT(right))
+      QUICKEN(lf, OP_LT_II);
+  generic_lt:
+    CMP_OP(vm, left, right, <);
+    VM_NEXT();
+  VM_CASE(OP_LE):
+    right = POP(vm);
+    left  = POP(vm);
+    CMP_OP(vm, left, right, <=);
+    VM_NEXT();
+  VM_CASE(OP_TYPOF):
+    left = POP(vm);
+    PUSH(vm, TYPEOF_VAL_STR(left));
+    gc_release(left);
+    VM_NEXT();
+  VM_CASE(OP_NOT):
+  VM_CASE(OP_NEG):
+  VM_CASE(OP_BNOT):
+    left = POP(vm);
+    UNRY_OP(vm, left, op);
+    gc_release(left);
+    VM_NEXT();
+  VM_CASE(OP_JUMP):
+    GC_SAFE_POINT();
+    jmp = FETCH_JUMP_L(lf);
+    JUMP(lf, jmp);
+    VM_NEXT();
+  VM_CASE(OP_JUMP_S):
+    GC_SAFE_POINT();
+    jmp = FETCH_JUMP_S(lf);
+    JUMP(lf, jmp);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE):
+    GC_SAFE_POINT();
+    jmp = FETCH_JUMP_L(lf);
+    left = POP(vm);
+    if (!TO_BOOL(left))
+      JUMP(lf, jmp);
+    gc_release(left);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_S):
+    GC_SAFE_POINT();
+    jmp = FETCH_JUMP_S(lf);
+    left = POP(vm);
+    if (!TO_BOOL(left))
+      JUMP(lf, jmp);
+    gc_release(left);
+    VM_NEXT();
+  VM_CASE(OP_JTRUE):
+    GC_SAFE_POINT();
+    jmp = FETCH_JUMP_L(lf);
+    left = POP(vm);
+    if (TO_BOOL(left))
+      JUMP(lf, jmp);
+    gc_release(left);
+    VM_NEXT();
+  VM_CASE(OP_JTRUE_S):
+    GC_SAFE_POINT();
+    jmp = FETCH_JUMP_S(lf);
+    left = POP(vm);
+    if (TO_BOOL(left))
+      JUMP(lf, jmp);
+    gc_release(left);
+    VM_NEXT();
+  VM_CASE(OP_GET_GLOBAL):
+    addr = FETCH(lf) << 8;
+    addr |= FETCH(lf);
+    left = lf->globals[addr];
+    if (IS_UNDEF(left))
+      VM_ERROR("\'%s\' is not defined", left.as.name);
+    PUSH(vm, left);
+    VM_NEXT();
+  VM_CASE(OP_SET_GLOBAL):
+    addr = FETCH(lf) << 8;
+    addr |= FETCH(lf);
+    left = *(vm->sp - 1);
+    gc_incref(left);
+    gc_decref(lf->globals[addr]);
+    lf->globals[addr] = left;
+    VM_NEXT();
+  VM_CASE(OP_GET_LOCAL):
+    addr = FETCH(lf);
+    PUSH(vm, GET_LOCAL(lf, addr));
+    VM_NEXT();
+  VM_CASE(OP_SET_LOCAL):
+    addr = FETCH(lf);
+    gc_release(GET_LOCAL(lf, addr));
+    SET_LOCAL(lf, addr, *(vm->sp - 1));
+    VM_NEXT();
+  VM_CASE(OP_CALL):
+  VM_CASE(OP_TAIL_CALL): {
+    GC_SAFE_POINT();
+    seal_byte argc = FETCH(lf);
+    svalue_t *argv = vm->sp - argc;
+    vm->sp -= argc;
+
+    svalue_t func = POP(vm);
+    if (!IS_FUNC(func))
+      VM_ERROR("calling non-function: \'%s\'", seal_type_name(func.type));
+
+    if ((!IS_FUNC_VARARG(func) && argc != FUNC_ARGC(func)) || (IS_FUNC_VARARG(func) && argc < FUNC_ARGC(func)))
+      VM_ERROR("\'%s\' function expected%s %d argument%s, got %d",
+            FUNC_NAME(func),
+            IS_FUNC_VARARG(func) ? " at least" : "",
+            FUNC_ARGC(func),
+            FUNC_ARGC(func) != 1 ? "s" : "",
+            argc);
+
+    if (IS_BUILTIN_FUNC(func)) {
+      PUSH(vm, CALL_BUILTIN_FUNC(func)(argc, argv)); /* push function result to stack */
+      release_range(argv, argv + argc);
+    } else {
+      if (op == OP_TAIL_CALL && lf != vm->frames) {
+        /* drop locals of caller and move function with arguments to its base, frame is reused */
+        release_range(lf->base, argv - 1);
+        memmove(lf->base, argv - 1, (argc + 1) * sizeof(svalue_t));
+        argv = lf->base + 1;
+        lf--;
+      } else if (lf + 1 == vm->frames + vm->frame_max) {
+        VM_ERROR("maximum call depth of %d exceeded", vm->frame_max);
       }
-      case SEAL_MOD: {
-        if (!IS_STRING(right))
-          VM_ERROR("module indices must be strings, not \'%s\'", seal_type_name(VAL_TYPE(right)));
 
-        struct h_entry *e = hashmap_search(AS_MOD(left)->globals, AS_STRING(right));
-        if (e == NULL || e->key == NULL)
-          VM_ERROR("\'%s\' module has no field named \'%s\'", AS_MOD(left)->name, AS_STRING(right));
+      if (AS_USERDEF_FUNC(func).lazy)
+        compile_on_call(func.as.func, AS_USERDEF_FUNC(func).globals ? AS_USERDEF_FUNC(func).globals : vm->globals);
 
-        PUSH(vm, e->val);
-
-        break;
+      /* arguments on stack become first locals of callee */
+      int local_size = AS_USERDEF_FUNC(func).local_size;
+      if (IS_FUNC_VARARG(func)) {
+        svalue_t vargs = gc_track(SEAL_VALUE_LIST());
+        for (int i = FUNC_ARGC(func); i < argc; i++) {
+          LIST_PUSH(vargs, argv[i]);
+          gc_incref(argv[i]);
+        }
+        argc = FUNC_ARGC(func);
+        argv[argc++] = vargs;
       }
-      case SEAL_STRING: {
-        if (!IS_INT(right))
-          VM_ERROR("string indices must be integers, not \'%s\'", seal_type_name(VAL_TYPE(right)));
-
-        if (AS_INT(right) >= left.as.string->size || AS_INT(right) < 0)
-          VM_ERROR("string index out of range");
-
-        char *c = SEAL_CALLOC(2, sizeof(char));
-        c[0] = AS_STRING(left)[AS_INT(right)];
-        c[1] = '\0';
-        PUSH(vm, SEAL_VALUE_STRING(c));
+      if (argv + local_size > vm->stack + STACK_SIZE)
+        VM_ERROR("stack overflow");
+      memset(argv + argc, 0, (local_size - argc) * sizeof(svalue_t));
+      vm->sp = argv + local_size;
+
+      *++lf = (struct local_frame) {
+        .locals = argv,
+        .ip = AS_USERDEF_FUNC(func).bytecode,
+        .bytecodes = AS_USERDEF_FUNC(func).bytecode,
+        .const_pool = AS_USERDEF_FUNC(func).const_pool,
+        .globals = AS_USERDEF_FUNC(func).globals ? AS_USERDEF_FUNC(func).globals : vm->globals,
+        .caches = AS_USERDEF_FUNC(func).caches,
+        .linfo = AS_USERDEF_FUNC(func).linfo,
+        .linfo_size = AS_USERDEF_FUNC(func).linfo_size,
+        .file_name = AS_USERDEF_FUNC(func).file_name,
+        .base = argv - 1, /* drop function object too */
+        .local_size = local_size,
+      };
+    }
+    VM_NEXT();
+  }
+  VM_CASE(OP_GEN_LIST): {
+    seal_byte size = FETCH(lf);
+    left = gc_track(SEAL_VALUE_LIST());
+    /* members are in order on stack, no VLA as computed goto would not release it */
+    vm->sp -= size;
+    for (int i = 0; i < size; i++) {
+      LIST_PUSH(left, vm->sp[i]);
+      gc_incref(vm->sp[i]);
+    }
+    PUSH(vm, left);
+    VM_NEXT();
+  }
+  VM_CASE(OP_GET_FIELD_POLY):
+  poly_get_field:
+    right = POP(vm);
+    left  = POP(vm);
+    goto generic_get_field;
+  VM_CASE(OP_GET_FIELD):
+    right = POP(vm);
+    left  = POP(vm);
+    if (IS_LIST(left) && IS_INT(right))
+      QUICKEN(lf, OP_GET_FIELD_LIST_INT); /* before operand is fetched, opcode is at ip[-1] */
+  generic_get_field:
+    idx = FETCH(lf) << 8;
+    idx |= FETCH(lf);
+
+    switch (VAL_TYPE(left)) {
+    case SEAL_MAP: {
+      if (!IS_STRING(right))
+        VM_ERROR("map indices must be strings, not \'%s\'", seal_type_name(VAL_TYPE(right)));
 
-        break;
+      svalue_t *field = cached_map_field(&lf->caches[idx], AS_MAP(left), right.as.string);
+      if (field == NULL) {
+        /* VM_ERROR("\'%s\' key is not found", AS_STRING(right)); */
+        PUSH(vm, SEAL_VALUE_NULL);
+      } else {
+        PUSH(vm, *field);
       }
-      case SEAL_LIST: {
-        if (!IS_INT(right))
-          VM_ERROR("list indices must be integers, not \'%s\'", seal_type_name(VAL_TYPE(right)));
 
-        if (AS_INT(right) >= AS_LIST(left)->size || AS_INT(right) < 0)
-          VM_ERROR("list index out of range");
+      break;
+    }
+    case SEAL_MOD: {
+      if (!IS_STRING(right))
+        VM_ERROR("module indices must be strings, not \'%s\'", seal_type_name(VAL_TYPE(right)));
 
-        PUSH(vm, AS_LIST(left)->mems[AS_INT(right)]);
+      svalue_t *field = cached_mod_field(&lf->caches[idx], AS_MOD(left), right.as.string);
+      if (field == NULL)
+        VM_ERROR("\'%s\' module has no field named \'%s\'", AS_MOD(left)->name, AS_STRING(right));
 
-        break;
-      }
-      default:
-        VM_ERROR("cannot index \'%s\'", seal_type_name(VAL_TYPE(left)));
-        break;
-      }
-
-      gc_decref(left);
-      gc_decref(right);
+      PUSH(vm, *field);
 
       break;
-    case OP_SET_FIELD:
-      right = POP(vm);
-      left  = POP(vm);
+    }
+    case SEAL_STRING: {
+      if (!IS_INT(right))
+        VM_ERROR("string indices must be integers, not \'%s\'", seal_type_name(VAL_TYPE(right)));
 
-      switch (VAL_TYPE(left)) {
-      case SEAL_MAP: {
-        if (!IS_STRING(right))
-          VM_ERROR("map indices must be strings, not \'%s\'", seal_type_name(VAL_TYPE(right)));
+      if (AS_INT(right) >= left.as.string->size || AS_INT(right) < 0)
+        VM_ERROR("string index out of range");
 
-        struct sh_entry *e = shashmap_search(AS_MAP(left)->map, AS_STRING(right));
-        if (e == NULL)
-          VM_ERROR("cannot insert, map is full");
+      /* characters are shared interned strings, nothing is allocated */
+      PUSH(vm, sval(SEAL_STRING, string, str_char(AS_STRING(left)[AS_INT(right)])));
 
-        if (e->key != NULL)
-          gc_decref(e->val);
-        else
-          AS_MAP(left)->map->filled++;
+      break;
+    }
+    case SEAL_LIST: {
+      if (!IS_INT(right))
+        VM_ERROR("list indices must be integers, not \'%s\'", seal_type_name(VAL_TYPE(right)));
 
-        e->val = POP(vm);
+      if (AS_INT(right) >= AS_LIST(left)->size || AS_INT(right) < 0)
+        VM_ERROR("list index out of range");
 
-        e->key = AS_STRING(right);
-        e->hash = shash_str(AS_STRING(right));
-        e->is_tombstone = true;
+      PUSH(vm, AS_LIST(left)->mems[AS_INT(right)]);
 
-        PUSH(vm, e->val);
+      break;
+    }
+    default:
+      VM_ERROR("cannot index \'%s\'", seal_type_name(VAL_TYPE(left)));
+      break;
+    }
 
-        break;
-      }
-      case SEAL_LIST: {
-        if (!IS_INT(right))
-          VM_ERROR("list indices must be integers, not \'%s\'", seal_type_name(VAL_TYPE(right)));
+    gc_release(left);
+    gc_release(right);
 
-        if (AS_INT(right) >= AS_LIST(left)->size || AS_INT(right) < 0)
-          VM_ERROR("list index out of range");
+    VM_NEXT();
+  VM_CASE(OP_SET_FIELD):
+    idx = FETCH(lf) << 8;
+    idx |= FETCH(lf);
+    right = POP(vm);
+    left  = POP(vm);
 
-        gc_decref(AS_LIST(left)->mems[AS_INT(right)]);
-        PUSH(vm, AS_LIST(left)->mems[AS_INT(right)] = POP(vm));
+    switch (VAL_TYPE(left)) {
+    case SEAL_MAP: {
+      if (!IS_STRING(right))
+        VM_ERROR("map indices must be strings, not \'%s\'", seal_type_name(VAL_TYPE(right)));
 
-        break;
-      }
-      case SEAL_STRING: case SEAL_MOD:
-        VM_ERROR("%ss are immutable", seal_type_name(VAL_TYPE(left)));
-        break;
-      default:
-        VM_ERROR("cannot index \'%s\'", seal_type_name(VAL_TYPE(left)));
-        break;
-      }
+      svalue_t *field = cached_map_field(&lf->caches[idx], AS_MAP(left), right.as.string);
+      if (field != NULL)
+        gc_decref(*field);
+      else /* constant keys are interned already, computed ones are copied and die with map */
+        field = map_add_field(AS_MAP(left), right.as.string);
 
-      gc_decref(left);
-      gc_decref(right);
+      *field = POP(vm);
+      gc_incref(*field);
 
-      break;
-    case OP_IN:
-      right = POP(vm);
-      left  = POP(vm);
-      if (!IS_STRING(right))
-        VM_ERROR("in operator requires string");
-      if (!IS_STRING(left))
-        VM_ERROR("leftside must be string when rightside is string");
+      PUSH(vm, *field);
 
-      PUSH_BOOL(vm, strstr(AS_STRING(right), AS_STRING(left)) != NULL);
-      gc_decref(left);
-      gc_decref(right);
       break;
-    case OP_GEN_MAP: {
-      seal_byte size = FETCH(lf);
-      left = SEAL_VALUE_MAP();
-      for (int i = 0; i < size; i++) {
-        const char *key = AS_STRING(POP(vm));
-        right = POP(vm);
+    }
+    case SEAL_LIST: {
+      if (!IS_INT(right))
+        VM_ERROR("list indices must be integers, not \'%s\'", seal_type_name(VAL_TYPE(right)));
 
+      if (AS_INT(right) >= AS_LIST(left)->size || AS_INT(right) < 0)
+        VM_ERROR("list index out of range");
+
+      gc_decref(AS_LIST(left)->mems[AS_INT(right)]);
+      gc_incref(*(vm->sp - 1));
+      PUSH(vm, AS_LIST(left)->mems[AS_INT(right)] = POP(vm));
 
-        MAP_INSERT(left, key, right); 
-      }
-      PUSH(vm, left);
       break;
     }
-    case OP_INCLUDE:
-      left = POP(vm);
-      PUSH(vm, insert_mod_cache(lf, AS_STRING(left)));
+    case SEAL_STRING: case SEAL_MOD:
+      VM_ERROR("%ss are immutable", seal_type_name(VAL_TYPE(left)));
       break;
-    case OP_INCLUDE_SYM: {
-      seal_byte size = FETCH(lf);
-      const char *names[size];
-      for (int i = size - 1; i >= 0; i--) {
-        names[i] = AS_STRING(POP(vm));
-      }
-      left = POP(vm); /* module */
-      for (int i = 0; i < size; i++) {
-        struct h_entry *e = hashmap_search(AS_MOD(left)->globals, names[i]);
-        if (e == NULL || e->key == NULL)
-          VM_ERROR("failed to load \'%s\' symbol from \'%s\'", names[i], AS_MOD(left)->name);
+    default:
+      VM_ERROR("cannot index \'%s\'", seal_type_name(VAL_TYPE(left)));
+      break;
+    }
 
-        hashmap_insert(lf->globals, names[i], e->val);
+    gc_release(left);
+    gc_release(right);
+
+    VM_NEXT();
+  VM_CASE(OP_IN):
+    right = POP(vm);
+    left  = POP(vm);
+    if (!IS_STRING(right))
+      VM_ERROR("in operator requires string");
+    if (!IS_STRING(left))
+      VM_ERROR("leftside must be string when rightside is string");
+
+    PUSH_BOOL(vm, strstr(AS_STRING(right), AS_STRING(left)) != NULL);
+    gc_release(left);
+    gc_release(right);
+    VM_NEXT();
+  VM_CASE(OP_GEN_MAP): {
+    seal_byte size = FETCH(lf);
+    left = gc_track(SEAL_VALUE_MAP(size));
+    /* (value, key) pairs on stack, inserted in source order */
+    svalue_t *fields = vm->sp - 2 * size;
+    for (int i = 0; i < size; i++) {
+      struct seal_string *key = fields[2 * i + 1].as.string; /* interned constant */
+      gc_incref(fields[2 * i]);
+      MAP_INSERT(left, key, fields[2 * i]);
+    }
+    vm->sp = fields;
+    PUSH(vm, left);
+    VM_NEXT();
+  }
+  VM_CASE(OP_INCLUDE):
+    left = POP(vm);
+    PUSH(vm, insert_mod_cache(lf, AS_STRING(left)));
+    VM_NEXT();
+  VM_CASE(OP_INCLUDE_SYM): {
+    seal_byte size = FETCH(lf);
+    /* module is followed by (name, slot) pairs on stack */
+    svalue_t *syms = vm->sp - 2 * size;
+    vm->sp = syms - 1;
+    left = *vm->sp; /* module */
+    for (int i = 0; i < size; i++) {
+      struct seal_string *name = syms[2 * i].as.string;
+      svalue_t *field = mod_field(AS_MOD(left), name);
+      if (field == NULL)
+        VM_ERROR("failed to load \'%s\' symbol from \'%s\'", name->val, AS_MOD(left)->name);
+
+      gc_incref(*field);
+      gc_decref(lf->globals[AS_INT(syms[2 * i + 1])]);
+      lf->globals[AS_INT(syms[2 * i + 1])] = *field;
+    }
+    VM_NEXT();
+   }
+  VM_CASE(OP_FOR_PREP):
+    /*
+     * *(sp - 1) -> iterator (in integer)
+     * *(sp - 2) -> step (in integer)
+     * *(sp - 3) -> iterated (generic)
+     *
+     * subtract step from iterator before loop
+     * then jump to FOR_NEXT instruction
+     */
+    AS_INT(*(vm->sp - 1)) -= AS_INT(*(vm->sp - 2));
+    jmp = FETCH_JUMP_L(lf);
+    JUMP(lf, jmp);
+    VM_NEXT();
+  VM_CASE(OP_FOR_PREP_S):
+    AS_INT(*(vm->sp - 1)) -= AS_INT(*(vm->sp - 2));
+    jmp = FETCH_JUMP_S(lf);
+    JUMP(lf, jmp);
+    VM_NEXT();
+  VM_CASE(OP_FOR_NEXT_S):
+    GC_SAFE_POINT();
+    idx = FETCH(lf);
+    jmp = FETCH_JUMP_S(lf);
+    goto for_next;
+  VM_CASE(OP_FOR_NEXT):
+    GC_SAFE_POINT();
+    idx = FETCH(lf);
+    jmp = FETCH_JUMP_L(lf);
+for_next:
+    left = *(vm->sp - 3);
+    AS_INT(*(vm->sp - 1)) += AS_INT(*(vm->sp - 2));
+    switch (VAL_TYPE(left)) {
+    case SEAL_INT:
+      if (AS_INT(*(vm->sp - 1)) >= AS_INT(left)) {
+        goto finish_loop;
+      } else {
+        SET_LOCAL(lf, idx, *(vm->sp - 1));
+        JUMP(lf, jmp);
       }
       break;
-   }
-    case OP_FOR_PREP:
-      /*
-       * *(sp - 1) -> iterator (in integer)
-       * *(sp - 2) -> step (in integer)
-       * *(sp - 3) -> iterated (generic)
-       *
-       * subtract step from iterator before loop
-       * then jump to FOR_NEXT instruction
-       */
-      AS_INT(*(vm->sp - 1)) -= AS_INT(*(vm->sp - 2));
-      addr = FETCH(lf) << 8;
-      addr |= FETCH(lf);
-      JUMP(lf, addr);
+    case SEAL_STRING:
+      if (AS_INT(*(vm->sp - 1)) >= left.as.string->size) {
+        goto finish_loop;
+      } else {
+        right = sval(SEAL_STRING, string, str_char(AS_STRING(left)[AS_INT(*(vm->sp - 1))]));
+        gc_release(GET_LOCAL(lf, idx));
+        SET_LOCAL(lf, idx, right);
+        JUMP(lf, jmp);
+      }
       break;
-    case OP_FOR_NEXT:
-      left = *(vm->sp - 3);
-      AS_INT(*(vm->sp - 1)) += AS_INT(*(vm->sp - 2));
-      switch (VAL_TYPE(left)) {
-      case SEAL_INT:
-        if (AS_INT(*(vm->sp - 1)) >= AS_INT(left)) {
-          goto finish_loop;
-        } else {
-          SET_LOCAL(lf, FETCH(lf), *(vm->sp - 1));
-          addr = FETCH(lf) << 8;
-          addr |= FETCH(lf);
-          JUMP(lf, addr);
-        }
-        break;
-      case SEAL_STRING:
-        if (AS_INT(*(vm->sp - 1)) >= left.as.string->size) {
-          goto finish_loop;
-        } else {
-          char *c = SEAL_CALLOC(2, sizeof(char));
-          c[0] = AS_STRING(left)[AS_INT(*(vm->sp - 1))];
-          c[1] = '\0';
-          right = SEAL_VALUE_STRING(c);
-          gc_incref(right);
-          idx = FETCH(lf);
-          gc_decref(GET_LOCAL(lf, idx));
-          SET_LOCAL(lf, idx, right);
-          addr = FETCH(lf) << 8;
-          addr |= FETCH(lf);
-          JUMP(lf, addr);
-        }
-        break;
-      case SEAL_LIST:
-        if (AS_INT(*(vm->sp - 1)) >= AS_LIST(left)->size) {
-          goto finish_loop;
-        } else {
-          right = AS_LIST(left)->mems[AS_INT(*(vm->sp - 1))];
-          gc_incref(right);
-          idx = FETCH(lf);
-          gc_decref(GET_LOCAL(lf, idx));
-          SET_LOCAL(lf, idx, right);
-          addr = FETCH(lf) << 8;
-          addr |= FETCH(lf);
-          JUMP(lf, addr);
-        }
-        break;
+    case SEAL_LIST:
+      if (AS_INT(*(vm->sp - 1)) >= AS_LIST(left)->size) {
+        goto finish_loop;
+      } else {
+        right = AS_LIST(left)->mems[AS_INT(*(vm->sp - 1))];
+        gc_release(GET_LOCAL(lf, idx));
+        SET_LOCAL(lf, idx, right);
+        JUMP(lf, jmp);
       }
       break;
+    }
+    VM_NEXT();
 finish_loop:
-      gc_decref(*(vm->sp - 3));
-      vm->sp -= 3;
-      lf->ip += 3;
-      break;
-    case OP_FOR_STOP:
-      gc_decref(*(vm->sp - 3));
-      vm->sp -= 3;
-      break;
-    default:
-      fprintf(stderr, "unrecognized op type: %d\n", op);
-      return;
+    gc_release(*(vm->sp - 3));
+    vm->sp -= 3;
+    VM_NEXT();
+  VM_CASE(OP_FOR_STOP):
+    gc_release(*(vm->sp - 3));
+    vm->sp -= 3;
+    VM_NEXT();
+  /* superinstructions */
+  VM_CASE(OP_ADD_LL):
+    left  = GET_LOCAL(lf, FETCH(lf));
+    right = GET_LOCAL(lf, FETCH(lf));
+    BIN_OP(vm, left, right, +);
+    VM_NEXT();
+  VM_CASE(OP_INC_LOCAL):
+  VM_CASE(OP_DEC_LOCAL):
+    idx = FETCH(lf);
+    left = GET_LOCAL(lf, idx);
+    right = SEAL_VALUE_INT(FETCH(lf) << 8);
+    AS_INT(right) |= FETCH(lf);
+    if (IS_INT(left)) {
+      AS_INT(GET_LOCAL(lf, idx)) += op == OP_INC_LOCAL ? AS_INT(right) : -AS_INT(right);
+    } else {
+      if (op == OP_INC_LOCAL)
+        BIN_OP(vm, left, right, +);
+      else
+        BIN_OP(vm, left, right, -);
+      gc_release(left);
+      SET_LOCAL(lf, idx, POP(vm));
+    }
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_LT_LI):
+    CMP_LOCAL_INT_JFALSE(vm, lf, left, right, jmp, <, CMP_OP, FETCH_JUMP_L);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_LT_LI_S):
+    CMP_LOCAL_INT_JFALSE(vm, lf, left, right, jmp, <, CMP_OP, FETCH_JUMP_S);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_LE_LI):
+    CMP_LOCAL_INT_JFALSE(vm, lf, left, right, jmp, <=, CMP_OP, FETCH_JUMP_L);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_LE_LI_S):
+    CMP_LOCAL_INT_JFALSE(vm, lf, left, right, jmp, <=, CMP_OP, FETCH_JUMP_S);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_GT_LI):
+    CMP_LOCAL_INT_JFALSE(vm, lf, left, right, jmp, >, CMP_OP, FETCH_JUMP_L);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_GT_LI_S):
+    CMP_LOCAL_INT_JFALSE(vm, lf, left, right, jmp, >, CMP_OP, FETCH_JUMP_S);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_GE_LI):
+    CMP_LOCAL_INT_JFALSE(vm, lf, left, right, jmp, >=, CMP_OP, FETCH_JUMP_L);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_GE_LI_S):
+    CMP_LOCAL_INT_JFALSE(vm, lf, left, right, jmp, >=, CMP_OP, FETCH_JUMP_S);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_EQ_LI):
+    CMP_LOCAL_INT_JFALSE(vm, lf, left, right, jmp, ==, EQUAL_OP, FETCH_JUMP_L);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_EQ_LI_S):
+    CMP_LOCAL_INT_JFALSE(vm, lf, left, right, jmp, ==, EQUAL_OP, FETCH_JUMP_S);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_NE_LI):
+    CMP_LOCAL_INT_JFALSE(vm, lf, left, right, jmp, !=, EQUAL_OP, FETCH_JUMP_L);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_NE_LI_S):
+    CMP_LOCAL_INT_JFALSE(vm, lf, left, right, jmp, !=, EQUAL_OP, FETCH_JUMP_S);
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_OR_POP):
+    GC_SAFE_POINT();
+    jmp = FETCH_JUMP_L(lf);
+    left = *(vm->sp - 1);
+    if (!TO_BOOL(left)) {
+      JUMP(lf, jmp);
+    } else {
+      vm->sp--;
+      gc_release(left);
+    }
+    VM_NEXT();
+  VM_CASE(OP_JFALSE_OR_POP_S):
+    GC_SAFE_POINT();
+    jmp = FETCH_JUMP_S(lf);
+    left = *(vm->sp - 1);
+    if (!TO_BOOL(left)) {
+      JUMP(lf, jmp);
+    } else {
+      vm->sp--;
+      gc_release(left);
+    }
+    VM_NEXT();
+  VM_CASE(OP_JTRUE_OR_POP):
+    GC_SAFE_POINT();
+    jmp = FETCH_JUMP_L(lf);
+    left = *(vm->sp - 1);
+    if (TO_BOOL(left)) {
+      JUMP(lf, jmp);
+    } else {
+      vm->sp--;
+      gc_release(left);
+    }
+    VM_NEXT();
+  VM_CASE(OP_JTRUE_OR_POP_S):
+    GC_SAFE_POINT();
+    jmp = FETCH_JUMP_S(lf);
+    left = *(vm->sp - 1);
+    if (TO_BOOL(left)) {
+      JUMP(lf, jmp);
+    } else {
+      vm->sp--;
+      gc_release(left);
+    }
+    VM_NEXT();
+  /* register machine */
+  VM_CASE(OP_R_MOVE):
+    idx = FETCH(lf);
+    SET_REG(lf, idx, REG(lf, FETCH(lf)));
+    VM_NEXT();
+  VM_CASE(OP_R_LOADI):
+    idx = FETCH(lf);
+    addr = FETCH(lf) << 8;
+    addr |= FETCH(lf);
+    gc_release(REG(lf, idx));
+    REG(lf, idx) = SEAL_VALUE_INT(addr);
+    VM_NEXT();
+  VM_CASE(OP_R_LOADK):
+    idx = FETCH(lf);
+    addr = FETCH(lf) << 8;
+    addr |= FETCH(lf);
+    SET_REG(lf, idx, GET_CONST(lf, addr));
+    VM_NEXT();
+  VM_CASE(OP_R_PUSH):
+    PUSH(vm, REG(lf, FETCH(lf)));
+    VM_NEXT();
+  VM_CASE(OP_R_POP):
+    idx = FETCH(lf);
+    POP_REG(vm, lf, idx);
+    VM_NEXT();
+  VM_CASE(OP_R_CLEAR):
+    idx = FETCH(lf);
+    for (int n = FETCH(lf); n > 0; n--, idx++)
+      SET_REG(lf, idx, SEAL_VALUE_NULL);
+    VM_NEXT();
+  VM_CASE(OP_R_ADD):
+    REG_BIN_OP(vm, lf, left, right, idx, +, BIN_OP, SEAL_VALUE_INT);
+    VM_NEXT();
+  VM_CASE(OP_R_SUB):
+    REG_BIN_OP(vm, lf, left, right, idx, -, BIN_OP, SEAL_VALUE_INT);
+    VM_NEXT();
+  VM_CASE(OP_R_MUL):
+    REG_BIN_OP(vm, lf, left, right, idx, *, BIN_OP, SEAL_VALUE_INT);
+    VM_NEXT();
+  VM_CASE(OP_R_DIV):
+    right = REG(lf, lf->ip[2]);
+    if (IS_NUM(right) && AS_NUM(right) == 0.0) {
+      VM_ERROR("division by zero");
+    }
+    REG_BIN_OP(vm, lf, left, right, idx, /, BIN_OP, SEAL_VALUE_INT);
+    VM_NEXT();
+  VM_CASE(OP_R_MOD):
+    idx = FETCH(lf);
+    left  = REG(lf, FETCH(lf));
+    right = REG(lf, FETCH(lf));
+    MOD_OP(vm, left, right);
+    POP_REG(vm, lf, idx);
+    VM_NEXT();
+  VM_CASE(OP_R_AND):
+    REG_BIN_OP(vm, lf, left, right, idx, &, BITWISE_OP, SEAL_VALUE_INT);
+    VM_NEXT();
+  VM_CASE(OP_R_OR):
+    REG_BIN_OP(vm, lf, left, right, idx, |, BITWISE_OP, SEAL_VALUE_INT);
+    VM_NEXT();
+  VM_CASE(OP_R_XOR):
+    REG_BIN_OP(vm, lf, left, right, idx, ^, BITWISE_OP, SEAL_VALUE_INT);
+    VM_NEXT();
+  VM_CASE(OP_R_SHL):
+    REG_BIN_OP(vm, lf, left, right, idx, <<, BITWISE_OP, SEAL_VALUE_INT);
+    VM_NEXT();
+  VM_CASE(OP_R_SHR):
+    REG_BIN_OP(vm, lf, left, right, idx, >>, BITWISE_OP, SEAL_VALUE_INT);
+    VM_NEXT();
+  VM_CASE(OP_R_GT):
+    REG_BIN_OP(vm, lf, left, right, idx, >, CMP_OP, SEAL_VALUE_BOOL);
+    VM_NEXT();
+  VM_CASE(OP_R_GE):
+    REG_BIN_OP(vm, lf, left, right, idx, >=, CMP_OP, SEAL_VALUE_BOOL);
+    VM_NEXT();
+  VM_CASE(OP_R_LT):
+    REG_BIN_OP(vm, lf, left, right, idx, <, CMP_OP, SEAL_VALUE_BOOL);
+    VM_NEXT();
+  VM_CASE(OP_R_LE):
+    REG_BIN_OP(vm, lf, left, right, idx, <=, CMP_OP, SEAL_VALUE_BOOL);
+    VM_NEXT();
+  VM_CASE(OP_R_EQ):
+    REG_BIN_OP(vm, lf, left, right, idx, ==, EQUAL_OP, SEAL_VALUE_BOOL);
+    VM_NEXT();
+  VM_CASE(OP_R_NE):
+    REG_BIN_OP(vm, lf, left, right, idx, !=, EQUAL_OP, SEAL_VALUE_BOOL);
+    VM_NEXT();
+  VM_CASE(OP_R_IN):
+    idx = FETCH(lf);
+    left  = REG(lf, FETCH(lf));
+    right = REG(lf, FETCH(lf));
+    if (!IS_STRING(right))
+      VM_ERROR("in operator requires string");
+    if (!IS_STRING(left))
+      VM_ERROR("leftside must be string when rightside is string");
+    PUSH_BOOL(vm, strstr(AS_STRING(right), AS_STRING(left)) != NULL);
+    POP_REG(vm, lf, idx);
+    VM_NEXT();
+  VM_CASE(OP_R_TYPOF):
+    idx = FETCH(lf);
+    left = REG(lf, FETCH(lf));
+    SET_REG(lf, idx, TYPEOF_VAL_STR(left));
+    VM_NEXT();
+  VM_CASE(OP_R_NOT):
+  VM_CASE(OP_R_NEG):
+  VM_CASE(OP_R_BNOT):
+    idx = FETCH(lf);
+    left = REG(lf, FETCH(lf));
+    UNRY_OP(vm, left, op == OP_R_NOT ? OP_NOT : op == OP_R_NEG ? OP_NEG : OP_BNOT);
+    POP_REG(vm, lf, idx);
+    VM_NEXT();
+  VM_CASE(OP_R_JFALSE):
+    GC_SAFE_POINT();
+    left = REG(lf, FETCH(lf));
+    jmp = FETCH_JUMP_L(lf);
+    if (!TO_BOOL(left))
+      JUMP(lf, jmp);
+    VM_NEXT();
+  VM_CASE(OP_R_JFALSE_S):
+    GC_SAFE_POINT();
+    left = REG(lf, FETCH(lf));
+    jmp = FETCH_JUMP_S(lf);
+    if (!TO_BOOL(left))
+      JUMP(lf, jmp);
+    VM_NEXT();
+  VM_CASE(OP_R_JTRUE):
+    GC_SAFE_POINT();
+    left = REG(lf, FETCH(lf));
+    jmp = FETCH_JUMP_L(lf);
+    if (TO_BOOL(left))
+      JUMP(lf, jmp);
+    VM_NEXT();
+  VM_CASE(OP_R_JTRUE_S):
+    GC_SAFE_POINT();
+    left = REG(lf, FETCH(lf));
+    jmp = FETCH_JUMP_S(lf);
+    if (TO_BOOL(left))
+      JUMP(lf, jmp);
+    VM_NEXT();
+  VM_CASE(OP_R_JF_GT):
+    REG_CMP_JFALSE(vm, lf, left, right, jmp, >, CMP_OP, FETCH_JUMP_L);
+    VM_NEXT();
+  VM_CASE(OP_R_JF_GT_S):
+    REG_CMP_JFALSE(vm, lf, left, right, jmp, >, CMP_OP, FETCH_JUMP_S);
+    VM_NEXT();
+  VM_CASE(OP_R_JF_GE):
+    REG_CMP_JFALSE(vm, lf, left, right, jmp, >=, CMP_OP, FETCH_JUMP_L);
+    VM_NEXT();
+  VM_CASE(OP_R_JF_GE_S):
+    REG_CMP_JFALSE(vm, lf, left, right, jmp, >=, CMP_OP, FETCH_JUMP_S);
+    VM_NEXT();
+  VM_CASE(OP_R_JF_LT):
+    REG_CMP_JFALSE(vm, lf, left, right, jmp, <, CMP_OP, FETCH_JUMP_L);
+    VM_NEXT();
+  VM_CASE(OP_R_JF_LT_S):
+    REG_CMP_JFALSE(vm, lf, left, right, jmp, <, CMP_OP, FETCH_JUMP_S);
+    VM_NEXT();
+  VM_CASE(OP_R_JF_LE):
+    REG_CMP_JFALSE(vm, lf, left, right, jmp, <=, CMP_OP, FETCH_JUMP_L);
+    VM_NEXT();
+  VM_CASE(OP_R_JF_LE_S):
+    REG_CMP_JFALSE(vm, lf, left, right, jmp, <=, CMP_OP, FETCH_JUMP_S);
+    VM_NEXT();
+  VM_CASE(OP_R_JF_EQ):
+    REG_CMP_JFALSE(vm, lf, left, right, jmp, ==, EQUAL_OP, FETCH_JUMP_L);
+    VM_NEXT();
+  VM_CASE(OP_R_JF_EQ_S):
+    REG_CMP_JFALSE(vm, lf, left, right, jmp, ==, EQUAL_OP, FETCH_JUMP_S);
+    VM_NEXT();
+  VM_CASE(OP_R_JF_NE):
+    REG_CMP_JFALSE(vm, lf, left, right, jmp, !=, EQUAL_OP, FETCH_JUMP_L);
+    VM_NEXT();
+  VM_CASE(OP_R_JF_NE_S):
+    REG_CMP_JFALSE(vm, lf, left, right, jmp, !=, EQUAL_OP, FETCH_JUMP_S);
+    VM_NEXT();
+  /* quickened, operands are checked on stack before popping */
+  VM_CASE(OP_ADD_II):
+    right = vm->sp[-1];
+    left  = vm->sp[-2];
+    if (!IS_INT(left) || !IS_INT(right)) {
+      DEQUICKEN(lf, OP_ADD_POLY);
+      goto poly_add;
+    }
+    vm->sp--;
+    AS_INT(vm->sp[-1]) = AS_INT(left) + AS_INT(right);
+    VM_NEXT();
+  VM_CASE(OP_ADD_FF):
+    right = vm->sp[-1];
+    left  = vm->sp[-2];
+    if (!IS_FLOAT(left) || !IS_FLOAT(right)) {
+      DEQUICKEN(lf, OP_ADD_POLY);
+      goto poly_add;
+    }
+    vm->sp--;
+    AS_FLOAT(vm->sp[-1]) = AS_FLOAT(left) + AS_FLOAT(right);
+    VM_NEXT();
+  VM_CASE(OP_LT_II):
+    right = vm->sp[-1];
+    left  = vm->sp[-2];
+    if (!IS_INT(left) || !IS_INT(right)) {
+      DEQUICKEN(lf, OP_LT_POLY);
+      goto poly_lt;
+    }
+    vm->sp--;
+    vm->sp[-1] = SEAL_VALUE_BOOL(AS_INT(left) < AS_INT(right));
+    VM_NEXT();
+  VM_CASE(OP_EQ_STR):
+    right = vm->sp[-1];
+    left  = vm->sp[-2];
+    if (!IS_STRING(left) || !IS_STRING(right)) {
+      DEQUICKEN(lf, OP_EQ_POLY);
+      goto poly_eq;
+    }
+    vm->sp -= 2;
+    PUSH_BOOL(vm, str_equal(left.as.string, right.as.string));
+    gc_release(left);
+    gc_release(right);
+    VM_NEXT();
+  VM_CASE(OP_GET_FIELD_LIST_INT):
+    right = vm->sp[-1];
+    left  = vm->sp[-2];
+    if (!IS_LIST(left) || !IS_INT(right)) {
+      DEQUICKEN(lf, OP_GET_FIELD_POLY);
+      goto poly_get_field;
     }
+    if (AS_INT(right) >= AS_LIST(left)->size || AS_INT(right) < 0)
+      VM_ERROR("list index out of range");
+    lf->ip += 2; /* cache index, lists do not use it */
+    vm->sp -= 2;
+    PUSH(vm, AS_LIST(left)->mems[AS_INT(right)]);
+    gc_release(left);
+    VM_NEXT();
+  VM_DEFAULT:
+    fprintf(stderr, "unrecognized op type: %d\n", op);
+    return;
   }
 }
@@ -8,7 +8,7 @@
 
 #define STACK_SIZE (0xFFFF + 1)
 #define GLOBAL_SIZE (0xFF + 1)
-#define FRAME_MAX (0xFF + 1)
+#define FRAME_MAX (0x3FFF + 1) /* default maximum call depth */
 
 typedef struct vm vm_t;
 
@@ -19,27 +19,38 @@ struct local_frame {
   struct line_info *linfo;
   int linfo_size;
   svalue_t *const_pool;
-  seal_word *label_pool;
-  hashmap_t *globals;
+  svalue_t *globals; /* global slots of module */
+  struct field_cache *caches; /* inline caches of field access sites */
   const char *file_name;
+  svalue_t *base;    /* stack pointer to restore on return */
+  int local_size;
 };
 
 struct vm {
  svalue_t* const_pool_ptr; /* pointer to pool for constant values */
- seal_word* label_ptr; /* pointer to array of labels */
  seal_byte*  bytecodes;  /* bytecode array (do not increment this) */ 
  //uint8_t*  ip;    /* instruction pointer */
  svalue_t* stack; /* stack */
  svalue_t* sp;    /* stack pointer */
- hashmap_t globals; /* hashmap for globals */
- //struct local_frame* lf; /* local frame for function calls */
+ svalue_t* globals; /* global slots, indexed by compile-time slot */
+ hashmap_t* symtab; /* global name -> slot index */
+ size_t global_cap; /* number of global slots */
+ struct local_frame* frames; /* call frames, first one is entry frame of eval_vm */
+ int frame_max; /* maximum call depth */
+ struct vm* prev; /* vm waiting for this one to run included module */
 };
 
 void init_mod_cache();
 svalue_t insert_mod_cache(struct local_frame*, const char*);
 
 void init_vm(vm_t* vm, cout_t* cout);
+void vm_set_global(vm_t* vm, const char* name, svalue_t val); /* no-op if name is never used as global and cannot be */
+void vm_set_max_depth(int depth); /* set maximum call depth for following vms */
+void vm_trace_quickening(bool enable); /* record quickened sites for print_quickened */
+void print_quickened();
+void print_field_caches(); /* hit and miss counts of inline caches of field access sites */
 void eval_vm(vm_t* vm, struct local_frame* lf);
+size_t vm_collect(); /* collects garbage of running vms including cycles, returns bytes freed */
 
 static void print_stack(vm_t* vm)
 {
@@ -63,7 +74,7 @@ static void print_stack(vm_t* vm)
         printf("%s\n", val.as._bool ? "true" : "false");
         break;
       case SEAL_FUNC:
-        printf("function: %p\n", val.as.func.type == FUNC_BUILTIN ? (void*)val.as.func.as.builtin.cfunc : (void*)val.as.func.as.userdef.bytecode);
+        printf("function: %p\n", AS_FUNC(val).type == FUNC_BUILTIN ? (void*)AS_FUNC(val).as.builtin.cfunc : (void*)AS_FUNC(val).as.userdef.bytecode);
         break;
       default:
         printf("STACK TYPE UNRECOGNIZED: %d\n", val.type);
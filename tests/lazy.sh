@@ -0,0 +1,43 @@
+#!/bin/bash
+# Checks that lazily compiled functions (-lc) see the same globals as eagerly
+# compiled ones, including 'args' set by the interpreter before running.
+# Builds the interpreter, runs a script with and without -lc and compares
+# outputs.
+#
+# usage: tests/lazy.sh
+
+CC="gcc"
+DIR="src"
+FLAGS="-std=c99 -O2"
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+$CC $ROOT/$DIR/*.c -I$ROOT/$DIR -o "$TMP/seal" $FLAGS -ldl -lm || exit 1
+
+cat > "$TMP/lazy.seal" <<'EOF'
+define f()
+    print(args[1])
+define g()
+    return f
+define h()
+    return len(args[0]) + 1
+g()()
+print(h())
+EOF
+
+status=0
+expected="a
+10"
+for mode in "" -lc; do
+  out=$(cd "$TMP" && ./seal lazy.seal a -nc $mode 2>&1)
+  if [ "$out" == "$expected" ]; then
+    echo "ok     lazy.seal $mode"
+  else
+    echo "FAIL   lazy.seal $mode"
+    echo "$out"
+    status=1
+  fi
+done
+exit $status
@@ -0,0 +1,59 @@
+#!/bin/bash
+# Checks that loops dropping objects run in bounded memory with every
+# optimization level and backend. Peephole threads the conditional jump at the
+# end of each loop body onto the loop's backward jump, so objects are only
+# reclaimed if conditional jumps are safe points too. Builds the interpreter
+# and runs the script with virtual memory limited to LIMIT kilobytes.
+#
+# usage: tests/memory.sh [LIMIT]
+
+CC="gcc"
+DIR="src"
+FLAGS="-std=c99 -O2"
+LIMIT=${1:-65536}
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+$CC $ROOT/$DIR/*.c -I$ROOT/$DIR -o "$TMP/seal" $FLAGS -ldl -lm || exit 1
+
+cat > "$TMP/memory.seal" <<'EOF'
+n = 2000000
+i = 0
+s = null
+while i < n
+    i += 1
+    s = [i, i, i]
+    if i < 0
+        s = null
+k = 0
+while k < n
+    k += 1
+    s = [k]
+    if s == null
+        s = null
+define f(n)
+    j = 0
+    t = null
+    while j < n
+        j += 1
+        t = [j, j]
+        if j < 0 and t != null
+            t = null
+    return j
+print(i, k, f(n))
+EOF
+
+status=0
+for flags in "-O0" "-O1" "-O0 -rb" "-O1 -rb"; do
+  out=$(cd "$TMP" && ulimit -v $LIMIT && ./seal memory.seal -nc $flags 2>&1)
+  if [ "$out" == "2000000 2000000 2000000" ]; then
+    echo "ok     memory.seal $flags"
+  else
+    echo "FAIL   memory.seal $flags"
+    echo "$out"
+    status=1
+  fi
+done
+exit $status
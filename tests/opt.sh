@@ -0,0 +1,50 @@
+#!/bin/bash
+# Checks that compiler optimizations (constant folding and peephole pass) and
+# the register backend do not change what programs print.
+# Builds the interpreter and the native modules, runs every example with -O0
+# and -O1 on each backend in a fresh copy of examples/ and modules/, feeding
+# the same input, and fails if any output differs from the one of -O0 on the
+# stack backend. Bytecode cache is disabled so that every run compiles.
+#
+# usage: tests/opt.sh
+
+CC="gcc"
+DIR="src"
+FLAGS="-std=c99 -O2"
+INPUT=$'C\n100\nF\nhello world\n'
+
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+TMP="$(mktemp -d)"
+trap 'rm -rf "$TMP"' EXIT
+
+$CC $ROOT/$DIR/*.c -I$ROOT/$DIR -o "$TMP/seal" $FLAGS -ldl -lm || exit 1
+# modules are found in current directory first
+mkdir "$TMP/base"
+for m in sealio sealmath sealstring sealtime; do
+  $CC -O2 -fPIC -shared -o "$TMP/base/$m.so" $ROOT/modules/$m.c $ROOT/$DIR/moddef.c \
+    -I$ROOT/modules -I$ROOT/$DIR -lm || exit 1
+done
+cp $ROOT/modules/*.seal $ROOT/examples/*.seal "$TMP/base/"
+
+# output of example $1 with flags $2, in a fresh directory as examples write files
+run() {
+  rm -rf "$TMP/run"
+  cp -r "$TMP/base" "$TMP/run"
+  (cd "$TMP/run" && printf '%s' "$INPUT" | HOME="$TMP" timeout 60 "$TMP/seal" "$1" -nc $2 2>&1)
+  echo "exit $?"
+}
+
+status=0
+for f in $ROOT/examples/*.seal; do
+  name=$(basename "$f")
+  expected=$(run "$name" "-O0")
+  for flags in "-O1" "-O0 -rb" "-O1 -rb"; do
+    if [ "$(run "$name" "$flags")" == "$expected" ]; then
+      echo "ok     $name $flags"
+    else
+      echo "FAIL   $name $flags: output differs from -O0"
+      status=1
+    fi
+  done
+done
+exit $status